@@ -1,28 +1,78 @@
 _text segment
 
-DCMD_OPS macro opCode:req
- 	int 3 ; debug break
-	jmp short @F ; jump to the next @@ label
- 	db 'D','C','M','D' ; debug command identifier
-    db &opCode&
-    @@:
-    ret
-endm
+; The debug commands themselves are generated in DummyProgram.cpp from DBG_CMD_LIST in DbgCmds.h in the WinDebug solution.
 
-; void __cdecl debuggerCmdNop(void)
-?debuggerCmdNop@@YAXXZ proc
-DCMD_OPS 0
-?debuggerCmdNop@@YAXXZ endp
-
-; void __cdecl debuggerCmdSetCallbacks(void* address, unsigned count)
-?debuggerCmdSetCallbacks@@YAXPEAXI@Z proc
-DCMD_OPS 1
-?debuggerCmdSetCallbacks@@YAXPEAXI@Z endp
-
-; void __cdecl debuggerCmdRegisterAltStack(void* address)
-?debuggerCmdRegisterAltStack@@YAXPEAX@Z proc
-DCMD_OPS 2
-?debuggerCmdRegisterAltStack@@YAXPEAX@Z endp
+; The debugger fires callbacks by sending the debuggee here, with rsp pointing at a block of calls laid out as CallBlockHeader in DbgCmds.h describes:
+; the rip and rsp to return to, the number of calls, a slot for each return value, then each call's address and three arguments.
+; The volatile registers, xmm0-xmm5 and the flags are saved below the block, so the debugger does not have to save and restore them itself.
+; Once every call has been made it breaks, with rsp CALL_TRAMPOLINE_FRAME_SIZE below the block, for the debugger to read the return values.
+; Resuming it puts everything back and returns to where the debuggee was when the debugger sent it here.
+; void __cdecl debuggerCallTrampoline(void)
+?debuggerCallTrampoline@@YAXXZ proc
+	pushfq
+	cld ; the callbacks expect the direction flag to be clear
+	push rax
+	push rcx
+	push rdx
+	push r8
+	push r9
+	push r10
+	push r11
+	push rbx
+	push rsi
+	push rdi
+	sub rsp, 68h ; xmm0-xmm5, and 8 more to realign the stack to 16
+	movdqa xmmword ptr [rsp], xmm0
+	movdqa xmmword ptr [rsp+10h], xmm1
+	movdqa xmmword ptr [rsp+20h], xmm2
+	movdqa xmmword ptr [rsp+30h], xmm3
+	movdqa xmmword ptr [rsp+40h], xmm4
+	movdqa xmmword ptr [rsp+50h], xmm5
+	sub rsp, 20h ; home space for the callbacks, leaving rsp 0e0h below the block
+	mov rsi, [rsp+0f0h] ; the number of calls
+	lea rdi, [rsp+0f8h] ; the first return value slot
+	lea rbx, [rdi+rsi*8] ; the first call
+@@:
+	test rsi, rsi
+	jz @F
+	mov rcx, [rbx+8]
+	mov rdx, [rbx+10h]
+	mov r8, [rbx+18h]
+	call qword ptr [rbx]
+	mov [rdi], rax
+	add rdi, 8
+	add rbx, 20h
+	dec rsi
+	jmp @B
+@@:
+	int 3 ; debug break, for the debugger to read the return values
+	add rsp, 20h
+	movdqa xmm0, xmmword ptr [rsp]
+	movdqa xmm1, xmmword ptr [rsp+10h]
+	movdqa xmm2, xmmword ptr [rsp+20h]
+	movdqa xmm3, xmmword ptr [rsp+30h]
+	movdqa xmm4, xmmword ptr [rsp+40h]
+	movdqa xmm5, xmmword ptr [rsp+50h]
+	add rsp, 68h
+	mov rax, [rsp+60h] ; the rsp to return to
+	mov rcx, [rsp+58h] ; the rip to return to
+	mov [rax-8], rcx ; pushed onto the stack being returned to, so ret can take it
+	sub rax, 8
+	mov [rsp+60h], rax
+	pop rdi
+	pop rsi
+	pop rbx
+	pop r11
+	pop r10
+	pop r9
+	pop r8
+	pop rdx
+	pop rcx
+	pop rax
+	popfq
+	mov rsp, [rsp+8]
+	ret
+?debuggerCallTrampoline@@YAXXZ endp
 
 _text ends
 
@@ -1,5 +1,21 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
-#include <windows.h>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "DbgCmds.h"
+
+#ifndef _WIN32
+// On Linux the call trampoline comes from DebuggerCmds.S instead, and the debug commands take their arguments the System V way, in rdi and rsi.
+#define __cdecl
+#endif
 
 #define STACK_FILL_PATTERN_0x00008   'D', 'E', 'B', 'U', 'G', 'S', 'T', 'K',
 #define STACK_FILL_PATTERN_0x00020   STACK_FILL_PATTERN_0x00008 STACK_FILL_PATTERN_0x00008 STACK_FILL_PATTERN_0x00008 STACK_FILL_PATTERN_0x00008
@@ -9,10 +25,31 @@
 #define STACK_FILL_PATTERN_0x02000	 STACK_FILL_PATTERN_0x00800 STACK_FILL_PATTERN_0x00800 STACK_FILL_PATTERN_0x00800 STACK_FILL_PATTERN_0x00800
 #define STACK_FILL_PATTERN_0x08000	 STACK_FILL_PATTERN_0x02000 STACK_FILL_PATTERN_0x02000 STACK_FILL_PATTERN_0x02000 STACK_FILL_PATTERN_0x02000
 
-// Keep these declarations in sync with the DbgCmd enum in DebugHnadler.cpp in the WinDebug solution.
-extern void __cdecl debuggerCmdNop(void);
-extern void __cdecl debuggerCmdSetCallbacks(void* address, unsigned count);
-extern void __cdecl debuggerCmdRegisterAltStack(void* address);
+/*
+* The debug commands, generated from DBG_CMD_LIST in DbgCmds.h in the WinDebug solution, so they always match what the debugger expects.
+* Each one's stub is put in with the program's code, and called through a pointer taking the command's parameters.
+*/
+#ifdef _WIN32
+#pragma section(".text$dcmd", read, execute)
+#define DBG_CMD_CODE __declspec(allocate(".text$dcmd"))
+#else
+#define DBG_CMD_CODE __attribute__((section(".text.dcmd")))
+#endif
+
+#define DBG_CMD_STUB(name, opCode, parameters) DBG_CMD_CODE static const DbgCmdStub s_debuggerCmd##name##Stub = MakeDbgCmdStub(opCode);
+DBG_CMD_LIST(DBG_CMD_STUB)
+#undef DBG_CMD_STUB
+
+struct DebuggerCmds
+{
+#define DBG_CMD_POINTER(name, opCode, parameters) \
+	static inline void(__cdecl* const name) parameters = reinterpret_cast<void(__cdecl*) parameters>((const void*)s_debuggerCmd##name##Stub.data());
+	DBG_CMD_LIST(DBG_CMD_POINTER)
+#undef DBG_CMD_POINTER
+};
+
+// Never called by the program itself. The debugger sends it here to fire callbacks, saving and restoring registers around them itself.
+extern void __cdecl debuggerCallTrampoline(void);
 
 static void PrintAAA()
 {
@@ -24,28 +61,267 @@ static int ReturnDoubleTheInput(int a)
 	return a * 2;
 }
 
-// Ensure this struct matces up with the Callbacks struct in DebugHnadler.cpp in the WinDebug solution.
-struct DebugCmdCallbacks
+// Each callback in DBG_CALLBACK_LIST is checked against the signature the debugger fires it with, so one that changes fails to build rather than being misfired.
+#define DBG_CALLBACK_CHECK(name, argCount, returnsValue) \
+	static_assert(GetCallbackSignature(&name) == DbgCallbacks::name.Signature, #name " does not match its signature in DBG_CALLBACK_LIST.");
+DBG_CALLBACK_LIST(DBG_CALLBACK_CHECK)
+#undef DBG_CALLBACK_CHECK
+
+#define DBG_CALLBACK_ONE(name, argCount, returnsValue) + 1
+static constexpr uint32_t CALLBACK_COUNT = 0 DBG_CALLBACK_LIST(DBG_CALLBACK_ONE);
+#undef DBG_CALLBACK_ONE
+
+// The callback registry the debugger reads, laid out as DbgCmds.h describes. It finds each callback by the hash of its name.
+struct DebugCmdCallbackRegistry
+{
+	CallbackRegistryHeader Header;
+	CallbackRegistryEntry Entries[CALLBACK_COUNT];
+};
+#define DBG_CALLBACK_ENTRY(name, argCount, returnsValue) { DbgCallbacks::name.NameHash, DbgCallbacks::name.Signature, (uint64_t)(uintptr_t)&name },
+static const DebugCmdCallbackRegistry s_callbackRegistry =
+{
+	{ CALLBACK_REGISTRY_VERSION, CALLBACK_COUNT },
+	{ DBG_CALLBACK_LIST(DBG_CALLBACK_ENTRY) },
+};
+#undef DBG_CALLBACK_ENTRY
+
+alignas(16) static char s_altStack[] = { STACK_FILL_PATTERN_0x08000 };
+
+// Telemetry is batched up here and only flushed to the debugger once the buffer is full, so the program is not stopped for every record.
+static TelemetryBuffer<64 * 1024> s_telemetry;
+
+// The one kind of telemetry record the program writes.
+static const uint32_t TELEMETRY_SAMPLE = 1;
+struct TelemetrySample
+{
+	uint64_t Index = 0;
+	uint64_t Timestamp = 0; // Nanoseconds on the steady clock.
+	uint64_t Value = 0;
+};
+
+static void FlushTelemetry()
+{
+	if (!s_telemetry.IsEmpty())
+	{
+		DebuggerCmds::FlushTelemetry(s_telemetry.GetData(), s_telemetry.GetSize());
+		s_telemetry.Clear();
+	}
+}
+
+// How often each kind of debug command is fired under load, relative to each other.
+struct LoadMix
 {
-	void(*PRINT_AAA_CALLBACK)();
-	int(*RETURN_DOUBLE_THE_INPUT_CALLBACK)(int);
+	double Nop = 1.0;
+	double SetCallbacks = 1.0; // Each of these makes the debugger fire both callbacks as well.
+	double RegisterAltStack = 1.0;
 };
-static DebugCmdCallbacks s_callbacks;
 
-int main()
+// Parses a mix like "nop=4,callbacks=1,altstack=0". Kinds that are left out keep their weight.
+static bool ParseLoadMix(std::string_view text, LoadMix& mix)
 {
-	Sleep(1000);
+	while (!text.empty())
+	{
+		const size_t end = std::min(text.find(','), text.size());
+		const std::string_view entry = text.substr(0, end);
+		text.remove_prefix(std::min(end + 1, text.size()));
+
+		const size_t equals = entry.find('=');
+		if (equals == std::string_view::npos)
+		{
+			return false;
+		}
+		const std::string_view name = entry.substr(0, equals);
+		const double weight = std::atof(std::string(entry.substr(equals + 1)).c_str());
+		if (weight < 0.0)
+		{
+			return false;
+		}
+
+		if (name == "nop")
+		{
+			mix.Nop = weight;
+		}
+		else if (name == "callbacks")
+		{
+			mix.SetCallbacks = weight;
+		}
+		else if (name == "altstack")
+		{
+			mix.RegisterAltStack = weight;
+		}
+		else
+		{
+			return false;
+		}
+	}
+	return mix.Nop + mix.SetCallbacks + mix.RegisterAltStack > 0.0;
+}
+
+/*
+* Fires debug commands picked at random by mix, at rate commands per second, for the given number of seconds, to load up the debugger.
+* A rate of 0 fires them back to back. The schedule is fixed, so a slow debugger makes the commands that are late go out back to back to catch up.
+* Runs forever if seconds is 0.
+*/
+static void RunLoad(const double rate, const LoadMix& mix, const double seconds)
+{
+	using Clock = std::chrono::steady_clock;
+
+	// Seeded the same way every run, so runs with the same mix fire the same commands.
+	std::mt19937 random(0);
+	std::discrete_distribution<int> pick({ mix.Nop, mix.SetCallbacks, mix.RegisterAltStack });
+
+	const Clock::time_point start = Clock::now();
+	const Clock::time_point end = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+	const Clock::duration interval = rate > 0.0 ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / rate)) : Clock::duration::zero();
+	Clock::time_point next = start;
+
+	uint64_t fired = 0;
+	while (seconds <= 0.0 || Clock::now() < end)
+	{
+		switch (pick(random))
+		{
+		case 0:
+			DebuggerCmds::Nop();
+			break;
+		case 1:
+			DebuggerCmds::SetCallbacks((void*)&s_callbackRegistry, s_callbackRegistry.Header.Count);
+			break;
+		case 2:
+			DebuggerCmds::RegisterAltStack((void*)((uintptr_t)s_altStack + sizeof(s_altStack) - 16));
+			break;
+		}
+		++fired;
+
+		if (interval != Clock::duration::zero())
+		{
+			next += interval;
+			std::this_thread::sleep_until(next);
+		}
+	}
+
+	const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+	std::cout << "\nLOAD DONE! " << fired << " debug commands in " << elapsed << " s\n";
+}
+
+/*
+* Writes telemetry samples back to back until megabytes of them have been flushed to the debugger, and reports how fast they went,
+* counting the stops to flush them.
+*/
+static void RunTelemetry(const double megabytes)
+{
+	using Clock = std::chrono::steady_clock;
+
+	const uint64_t bytes = (uint64_t)(megabytes * 1024 * 1024);
+	const Clock::time_point start = Clock::now();
+	uint64_t written = 0;
+	uint64_t records = 0;
+	while (written < bytes)
+	{
+		const TelemetrySample sample = { records, (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count(), records * 2 };
+		if (!s_telemetry.Append(TELEMETRY_SAMPLE, &sample, sizeof(sample)))
+		{
+			FlushTelemetry();
+			continue;
+		}
+		written += GetTelemetryRecordSize(sizeof(sample));
+		++records;
+	}
+	FlushTelemetry();
+
+	const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+	std::cout << "\nTELEMETRY DONE! " << records << " records, " << written / (1024.0 * 1024.0) << " MB in " << elapsed << " s\n";
+}
+
+/*
+* Throws and catches count C++ exceptions back to back, which a debugger sees as a storm of first chance exceptions,
+* and reports how long they took, to compare with how long they take without one.
+*/
+static void ThrowExceptions(const uint64_t count)
+{
+	using Clock = std::chrono::steady_clock;
+
+	const Clock::time_point start = Clock::now();
+	uint64_t caught = 0;
+	for (uint64_t i = 0; i < count; ++i)
+	{
+		try
+		{
+			throw std::runtime_error("DummyProgram");
+		}
+		catch (const std::runtime_error&)
+		{
+			++caught;
+		}
+	}
+
+	const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+	std::cout << "\nEXCEPTIONS DONE! " << caught << " exceptions in " << elapsed << " s\n";
+}
+
+// DummyProgram [--exceptions <count>] [--telemetry <megabytes>] [--load <commands per second> [--mix nop=<weight>,callbacks=<weight>,altstack=<weight>] [--seconds <seconds>]]
+int main(int argc, char* argv[])
+{
+	bool load = false;
+	double rate = 0.0;
+	double seconds = 0.0;
+	uint64_t exceptions = 0;
+	double telemetry = 0.0;
+	LoadMix mix;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (std::strcmp(argv[i], "--load") == 0)
+		{
+			load = true;
+			rate = std::atof(argv[i + 1]);
+		}
+		else if (std::strcmp(argv[i], "--mix") == 0)
+		{
+			if (!ParseLoadMix(argv[i + 1], mix))
+			{
+				std::cerr << "Bad --mix " << argv[i + 1] << "\n";
+				return 1;
+			}
+		}
+		else if (std::strcmp(argv[i], "--seconds") == 0)
+		{
+			seconds = std::atof(argv[i + 1]);
+		}
+		else if (std::strcmp(argv[i], "--exceptions") == 0)
+		{
+			exceptions = std::strtoull(argv[i + 1], nullptr, 10);
+		}
+		else if (std::strcmp(argv[i], "--telemetry") == 0)
+		{
+			telemetry = std::atof(argv[i + 1]);
+		}
+	}
+
+	std::this_thread::sleep_for(std::chrono::seconds(1));
 	std::cout << "\nINITIALIZING DUMMY PROGRAM!\n";
 
-	static __declspec(align(16)) char altStack[] = { STACK_FILL_PATTERN_0x08000 };
-	debuggerCmdRegisterAltStack((void*)((unsigned __int64)altStack + sizeof(altStack) - 16));
+	DebuggerCmds::RegisterAltStack((void*)((uintptr_t)s_altStack + sizeof(s_altStack) - 16));
+	DebuggerCmds::RegisterCallTrampoline((void*)debuggerCallTrampoline);
 
-	s_callbacks.PRINT_AAA_CALLBACK = PrintAAA;
-	s_callbacks.RETURN_DOUBLE_THE_INPUT_CALLBACK = ReturnDoubleTheInput;
-	debuggerCmdSetCallbacks(&s_callbacks, sizeof(s_callbacks) / sizeof(void*));
+	DebuggerCmds::SetCallbacks((void*)&s_callbackRegistry, s_callbackRegistry.Header.Count);
 	std::cout << "\nCALLBACKS SET!\n";
 
-	debuggerCmdNop();
+	DebuggerCmds::Nop();
+
+	if (exceptions)
+	{
+		ThrowExceptions(exceptions);
+	}
+
+	if (telemetry > 0.0)
+	{
+		RunTelemetry(telemetry);
+	}
+
+	if (load)
+	{
+		RunLoad(rate, mix, seconds);
+		return 0;
+	}
 
 	while (true)
 	{
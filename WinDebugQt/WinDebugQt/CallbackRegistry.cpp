@@ -0,0 +1,73 @@
+#include "CallbackRegistry.h"
+
+#include <bit>
+
+bool CallbackRegistry::Load(const std::span<const uint64_t> qwords)
+{
+	Clear();
+	if (qwords.size() < HEADER_QWORDS)
+	{
+		return false;
+	}
+
+	// The header's Version is the low half of its qword, and Count the high half.
+	const uint32_t version = (uint32_t)qwords[0];
+	const size_t count = (size_t)(qwords[0] >> 32);
+	if (version != CALLBACK_REGISTRY_VERSION || count > MAX_CALLBACKS || (qwords.size() - HEADER_QWORDS) / ENTRY_QWORDS < count)
+	{
+		return false;
+	}
+
+	m_Slots.assign(std::bit_ceil(count * 2 < 8 ? 8 : count * 2), CallbackRegistryEntry{});
+	const size_t mask = m_Slots.size() - 1;
+	for (size_t i = 0; i < count; ++i)
+	{
+		const uint64_t* const entry = qwords.data() + HEADER_QWORDS + i * ENTRY_QWORDS;
+		const CallbackRegistryEntry loaded = { entry[0], entry[1], entry[2] };
+		if (loaded.NameHash == 0)
+		{
+			continue;
+		}
+
+		// The name hashes are FNV-1a, so their low bits are spread well enough to index with directly.
+		size_t slot = (size_t)loaded.NameHash & mask;
+		while (m_Slots[slot].NameHash != 0 && m_Slots[slot].NameHash != loaded.NameHash)
+		{
+			slot = (slot + 1) & mask;
+		}
+		m_Count += m_Slots[slot].NameHash == 0;
+		m_Slots[slot] = loaded;
+	}
+
+	return true;
+}
+
+const CallbackRegistryEntry* CallbackRegistry::Find(const uint64_t nameHash) const
+{
+	if (m_Count == 0 || nameHash == 0)
+	{
+		return nullptr;
+	}
+
+	const size_t mask = m_Slots.size() - 1;
+	for (size_t slot = (size_t)nameHash & mask; m_Slots[slot].NameHash != 0; slot = (slot + 1) & mask)
+	{
+		if (m_Slots[slot].NameHash == nameHash)
+		{
+			return &m_Slots[slot];
+		}
+	}
+	return nullptr;
+}
+
+const CallbackRegistryEntry* CallbackRegistry::Find(const CallbackId& id) const
+{
+	const CallbackRegistryEntry* const callback = Find(id.NameHash);
+	return callback && callback->Signature == id.Signature ? callback : nullptr;
+}
+
+void CallbackRegistry::Clear()
+{
+	m_Slots.clear();
+	m_Count = 0;
+}
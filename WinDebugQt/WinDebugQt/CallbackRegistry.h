@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "DbgCmds.h"
+
+/*
+* The callbacks the debuggee has registered, loaded from the registry it passes to debuggerCmdSetCallbacks.
+* Entries are kept in an open addressed table keyed by the hash of their name, so finding a callback by name is a probe or two,
+* however many the debuggee registers. Loading again reuses the table, so re-registering does not allocate once it has grown.
+*/
+class CallbackRegistry
+	final
+{
+public:
+	// The number of qwords the header and each entry take up in the debuggee.
+	static constexpr size_t HEADER_QWORDS = sizeof(CallbackRegistryHeader) / sizeof(uint64_t);
+	static constexpr size_t ENTRY_QWORDS = sizeof(CallbackRegistryEntry) / sizeof(uint64_t);
+
+	/*
+	* Replaces the callbacks with those in a registry read from the debuggee as qwords, header first.
+	* Returns false, leaving no callbacks, if the registry is not of CALLBACK_REGISTRY_VERSION, holds more than MAX_CALLBACKS, or is cut short.
+	* Entries with a name hash of 0 are skipped, and a name registered twice keeps its last entry.
+	*/
+	bool Load(const std::span<const uint64_t> qwords);
+
+	// The callback registered under nameHash, or null if there is none.
+	const CallbackRegistryEntry* Find(const uint64_t nameHash) const;
+
+	const CallbackRegistryEntry* Find(const std::string_view name) const { return Find(HashCallbackName(name)); }
+
+	// One of the callbacks in DBG_CALLBACK_LIST, or null if the debuggee has not registered it with the signature in id. Both debug handlers check callbacks with this.
+	const CallbackRegistryEntry* Find(const CallbackId& id) const;
+
+	size_t GetCount() const { return m_Count; }
+
+	void Clear();
+
+private:
+	// A power of two at least twice the number of entries, so probes stay short. Empty slots have a name hash of 0.
+	std::vector<CallbackRegistryEntry> m_Slots;
+	size_t m_Count = 0;
+};
@@ -0,0 +1,19 @@
+#include "CdbCommandBuilder.h"
+
+#include <charconv>
+
+CdbCommandBuilder& CdbCommandBuilder::AppendHex(const uint64_t value)
+{
+	char digits[2 + 16] = { '0', 'x' };
+	const std::to_chars_result end = std::to_chars(digits + 2, digits + sizeof(digits), value, 16);
+	m_Text.append(digits, end.ptr);
+	return *this;
+}
+
+CdbCommandBuilder& CdbCommandBuilder::AppendDecimal(const uint64_t value)
+{
+	char digits[20];
+	const std::to_chars_result end = std::to_chars(digits, digits + sizeof(digits), value);
+	m_Text.append(digits, end.ptr);
+	return *this;
+}
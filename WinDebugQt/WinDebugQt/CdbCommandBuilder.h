@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/*
+* Builds the text of a CDB command into a buffer that is kept from one command to the next, so once it has grown to fit the longest command,
+* building another does not allocate. Numbers are written straight into it with std::to_chars.
+* A command constructed from a builder borrows its text rather than copying it, so the builder must not be rebuilt until that command completes.
+*/
+class CdbCommandBuilder
+	final
+{
+public:
+	// Starts a new command, keeping the buffer.
+	CdbCommandBuilder& Clear()
+	{
+		m_Text.clear();
+		return *this;
+	}
+
+	CdbCommandBuilder& Append(const std::string_view text)
+	{
+		m_Text += text;
+		return *this;
+	}
+
+	// Appends value in hex with a 0x prefix, so CDB reads it as hex whatever its radix is.
+	CdbCommandBuilder& AppendHex(const uint64_t value);
+
+	// Appends value in decimal.
+	CdbCommandBuilder& AppendDecimal(const uint64_t value);
+
+	std::string_view GetText() const { return m_Text; }
+
+private:
+	std::string m_Text;
+};
@@ -0,0 +1,202 @@
+#include "CdbCommandQueue.h"
+
+#include <charconv>
+
+CdbCommand::~CdbCommand()
+{
+	if (m_Queue)
+	{
+		m_Queue->Cancel(*this);
+	}
+}
+
+CdbCommandQueue::CdbCommandQueue(WriteFunction write, FailFunction onFailed)
+	: m_Write(std::move(write)),
+	m_OnFailed(std::move(onFailed))
+{
+}
+
+void CdbCommandQueue::Submit(CdbCommand& command)
+{
+	const uint32_t id = m_NextCommandId++;
+
+	m_PendingText += command.GetText();
+	m_PendingText += ";.echo ";
+	m_PendingText += SENTINEL_PREFIX;
+	char idText[10];
+	m_PendingText.append(idText, std::to_chars(idText, idText + sizeof(idText), id).ptr);
+	m_PendingText += ';';
+	m_HasPendingCommands = true;
+
+	command.m_Queue = this;
+	m_InFlightCommands.push_back({ id, m_NextWriteId, &command });
+}
+
+void CdbCommandQueue::Cancel(CdbCommand& command)
+{
+	// Its text may already be on its way to CDB, so the entry stays to swallow the output.
+	for (InFlightCommand& inFlight : m_InFlightCommands)
+	{
+		if (inFlight.Command == &command)
+		{
+			inFlight.Command = nullptr;
+			break;
+		}
+	}
+	command.m_Queue = nullptr;
+}
+
+void CdbCommandQueue::Flush()
+{
+	if (m_HasPendingCommands)
+	{
+		// Drop the trailing separator.
+		m_PendingText.back() = '\n';
+		Send(false);
+	}
+}
+
+void CdbCommandQueue::Resume(const std::string_view resumeCommand, CdbBreakWaiter* const breakWaiter)
+{
+	m_PendingText += resumeCommand;
+	m_PendingText += '\n';
+	m_BreakWaiter = breakWaiter;
+	++m_ResumeCount;
+	Send(true);
+}
+
+void CdbCommandQueue::CancelBreakWaiter(CdbBreakWaiter& breakWaiter)
+{
+	if (m_BreakWaiter == &breakWaiter)
+	{
+		m_BreakWaiter = nullptr;
+	}
+}
+
+void CdbCommandQueue::Send(const bool resumes)
+{
+	if (m_HasPendingCommands)
+	{
+		m_InFlightWrites.push_back({ m_NextWriteId, resumes });
+	}
+	++m_NextWriteId;
+
+	// Clear the pending state before writing, in case the write ends up submitting more.
+	m_SendText.swap(m_PendingText);
+	m_PendingText.clear();
+	m_HasPendingCommands = false;
+
+	m_Write(m_SendText);
+}
+
+bool CdbCommandQueue::OnLine(const std::string_view line)
+{
+	if (m_InFlightCommands.empty())
+	{
+		return false;
+	}
+
+	if (IsSentinel(line))
+	{
+		uint32_t id = 0;
+		const std::string_view idText = line.substr(SENTINEL_PREFIX.size());
+		std::from_chars(idText.data(), idText.data() + idText.size(), id);
+
+		// Anything in flight ahead of this sentinel was aborted without its own sentinel being echoed.
+		while (!m_InFlightCommands.empty() && m_InFlightCommands.front().Id != id)
+		{
+			CompleteFront(false);
+		}
+		if (!m_InFlightCommands.empty())
+		{
+			CompleteFront(true);
+		}
+	}
+	else if (CdbCommand* const command = m_InFlightCommands.front().Command)
+	{
+		command->OnLine(line);
+	}
+
+	return true;
+}
+
+bool CdbCommandQueue::OnPrompt()
+{
+	if (m_InFlightWrites.empty())
+	{
+		if (m_BreakWaiter)
+		{
+			// The waiter might resume again and set m_BreakWaiter, so null it out prior to calling it.
+			CdbBreakWaiter* const breakWaiter = m_BreakWaiter;
+			m_BreakWaiter = nullptr;
+			breakWaiter->OnBreak();
+			return true;
+		}
+
+		return false;
+	}
+
+	// This prompt ends the oldest write, so any of its commands still in flight were aborted.
+	const InFlightWrite write = m_InFlightWrites.front();
+	m_InFlightWrites.pop_front();
+	while (!m_InFlightCommands.empty() && m_InFlightCommands.front().WriteId == write.Id)
+	{
+		CompleteFront(false);
+	}
+
+	// If a write meant to resume the debuggee was aborted, whatever was waiting for the next break will never get it.
+	if (write.Resumes)
+	{
+		m_BreakWaiter = nullptr;
+	}
+
+	return true;
+}
+
+void CdbCommandQueue::CompleteFront(const bool succeeded)
+{
+	const InFlightCommand completed = m_InFlightCommands.front();
+	m_InFlightCommands.pop_front();
+
+	// A write that resumed the debuggee is finished once its last command is, as there will be no prompt for it.
+	if (succeeded && !m_InFlightWrites.empty() && m_InFlightWrites.front().Id == completed.WriteId && m_InFlightWrites.front().Resumes &&
+		(m_InFlightCommands.empty() || m_InFlightCommands.front().WriteId != completed.WriteId))
+	{
+		m_InFlightWrites.pop_front();
+	}
+
+	CdbCommand* const command = completed.Command;
+	if (!command)
+	{
+		return;
+	}
+
+	if (m_Timed)
+	{
+		command->m_CompletedAt = std::chrono::steady_clock::now();
+	}
+
+	// Completing may submit more commands, or end the command's lifetime if it succeeded, so this is done last.
+	command->m_Queue = nullptr;
+	command->OnComplete(succeeded);
+	if (!succeeded && m_OnFailed)
+	{
+		m_OnFailed(*command);
+	}
+}
+
+void CdbCommandQueue::Clear()
+{
+	m_PendingText.clear();
+	m_HasPendingCommands = false;
+	for (const InFlightCommand& inFlight : m_InFlightCommands)
+	{
+		if (inFlight.Command)
+		{
+			inFlight.Command->m_Queue = nullptr;
+		}
+	}
+	m_InFlightCommands.clear();
+	m_InFlightWrites.clear();
+	m_BreakWaiter = nullptr;
+}
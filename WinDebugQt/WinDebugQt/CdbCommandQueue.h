@@ -0,0 +1,211 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "CdbCommandBuilder.h"
+
+class CdbCommandQueue;
+
+/*
+* A command sent to CDB through a CdbCommandQueue. Receives the output that belongs to it.
+* The queue does not own its commands. One that is destroyed while still in flight is cancelled, and its output is dropped.
+*/
+class CdbCommand
+{
+public:
+	explicit CdbCommand(std::string text) : m_Text(std::move(text)) {}
+
+	// Borrows the text built in builder rather than copying it, so the builder must not be rebuilt until the command completes.
+	explicit CdbCommand(const CdbCommandBuilder& builder) : m_BorrowedText(builder.GetText()) {}
+
+	CdbCommand(const CdbCommand&) = delete;
+	CdbCommand& operator=(const CdbCommand&) = delete;
+	virtual ~CdbCommand();
+
+	// The CDB command to run. May be several commands separated by semicolons, but must not end with one or a newline.
+	std::string_view GetText() const { return m_BorrowedText.empty() ? std::string_view(m_Text) : m_BorrowedText; }
+
+	// Called with each line of output the command produces.
+	virtual void OnLine(const std::string_view line) = 0;
+
+	/*
+	* Called once all of the command's output has been routed to OnLine.
+	* succeeded is false if CDB never got to the end of the command, which happens when it aborts the rest of a line on an error.
+	*/
+	virtual void OnComplete(const bool succeeded) = 0;
+
+	// When the command completed, if its queue was timing commands. The epoch otherwise.
+	std::chrono::steady_clock::time_point GetCompletedAt() const { return m_CompletedAt; }
+
+protected:
+	// Lets a command be reused for different text. Only while it is not in flight.
+	void SetText(const std::string_view text)
+	{
+		m_Text.assign(text);
+		m_BorrowedText = {};
+	}
+
+private:
+	friend class CdbCommandQueue;
+
+	std::string m_Text;
+	std::string_view m_BorrowedText; // Empty unless the text is borrowed from a CdbCommandBuilder.
+	std::chrono::steady_clock::time_point m_CompletedAt;
+
+	// The queue the command is in flight on, if any.
+	CdbCommandQueue* m_Queue = nullptr;
+};
+
+// Waits for the break that ends a CdbCommandQueue::Resume.
+class CdbBreakWaiter
+{
+public:
+	virtual ~CdbBreakWaiter() = default;
+
+	// Called with the debuggee stopped at the next break.
+	virtual void OnBreak() = 0;
+};
+
+/*
+* Pipelines commands to CDB and routes each one's output back to it.
+* Every submitted command is followed by an .echo of a sentinel carrying the command's id, so any number of independent commands
+* can go out in one write and the output between two sentinels is known to belong to the command in between.
+* Each write that does not resume the debuggee ends in exactly one prompt, which the queue consumes; any other prompt is a new break.
+*/
+class CdbCommandQueue
+	final
+{
+public:
+	using WriteFunction = std::function<void(const std::string_view text)>;
+	using FailFunction = std::function<void(const CdbCommand& command)>;
+
+	// write sends text to CDB's stdin. onFailed is called for every command CDB aborted, after its OnComplete.
+	CdbCommandQueue(WriteFunction write, FailFunction onFailed);
+
+	// Queues a command to go out with the next Flush or Resume. The command must stay alive until it completes or is cancelled.
+	void Submit(CdbCommand& command);
+
+	// Stops routing output to a command that has not completed yet. Its output is still consumed, but dropped.
+	void Cancel(CdbCommand& command);
+
+	// Writes every command submitted since the last write to CDB at once.
+	void Flush();
+
+	/*
+	* Writes every command submitted since the last write followed by resumeCommand, which lets the debuggee run (g, gh or gn, possibly after other commands).
+	* breakWaiter, if set, takes over the next break prompt instead of it being reported by OnPrompt.
+	*/
+	void Resume(const std::string_view resumeCommand, CdbBreakWaiter* const breakWaiter = nullptr);
+
+	// Stops breakWaiter from getting the next break, if it is still waiting for it.
+	void CancelBreakWaiter(CdbBreakWaiter& breakWaiter);
+
+	// Routes a line of CDB output to the command it belongs to. Returns false if it belongs to none of them.
+	bool OnLine(const std::string_view line);
+
+	// Handles a CDB prompt. Returns false if the prompt is a new break that nothing was waiting for.
+	bool OnPrompt();
+
+	// True for the lines the queue adds to CDB's output to mark the end of each command.
+	static bool IsSentinel(const std::string_view line) { return line.substr(0, SENTINEL_PREFIX.size()) == SENTINEL_PREFIX; }
+
+	// Drops everything queued or in flight without completing it. Nothing is called back.
+	void Clear();
+
+	// The number of times the debuggee has been resumed. Anything read from it while it was stopped is stale once this changes.
+	uint32_t GetResumeCount() const { return m_ResumeCount; }
+
+	// Whether to stamp each command with the time it completes, for profiling.
+	void SetTimed(const bool timed) { m_Timed = timed; }
+
+private:
+	static constexpr std::string_view SENTINEL_PREFIX = "DebugHandlerQueue:";
+
+	struct InFlightCommand
+	{
+		uint32_t Id;
+		uint32_t WriteId;
+		CdbCommand* Command; // Null once cancelled.
+	};
+
+	struct InFlightWrite
+	{
+		uint32_t Id;
+		bool Resumes;
+	};
+
+	/*
+	* A first in, first out queue kept in a vector, which is cleared rather than freed whenever it drains, so it stops allocating once it has grown.
+	* A std::deque frees and allocates blocks as entries pass through it. Everything in flight completes by the time the debuggee is stopped and
+	* CDB has caught up, so this drains at least once per break. Should it not, entries that have been popped are dropped once they are half of it.
+	*/
+	template <typename T>
+	class Fifo
+	{
+	public:
+		bool empty() const { return m_Head == m_Items.size(); }
+		T& front() { return m_Items[m_Head]; }
+		void push_back(const T& item)
+		{
+			if (m_Head >= MIN_COMPACT_COUNT && m_Head * 2 >= m_Items.size())
+			{
+				m_Items.erase(m_Items.begin(), m_Items.begin() + m_Head);
+				m_Head = 0;
+			}
+			m_Items.push_back(item);
+		}
+		void clear()
+		{
+			m_Items.clear();
+			m_Head = 0;
+		}
+		void pop_front()
+		{
+			if (++m_Head == m_Items.size())
+			{
+				clear();
+			}
+		}
+		typename std::vector<T>::iterator begin() { return m_Items.begin() + m_Head; }
+		typename std::vector<T>::iterator end() { return m_Items.end(); }
+
+	private:
+		static constexpr size_t MIN_COMPACT_COUNT = 64;
+
+		std::vector<T> m_Items;
+		size_t m_Head = 0;
+	};
+
+	// Writes the pending text, and tracks the write if any commands went out with it.
+	void Send(const bool resumes);
+
+	// Pops the command at the front of m_InFlightCommands and completes it.
+	void CompleteFront(const bool succeeded);
+
+	WriteFunction m_Write;
+	FailFunction m_OnFailed;
+
+	// Submitted commands and their sentinels that have not been written yet.
+	std::string m_PendingText;
+
+	// The text being written. Swapped with m_PendingText so neither has to grow again after the first few writes.
+	std::string m_SendText;
+	bool m_HasPendingCommands = false;
+
+	// Commands written to CDB whose sentinel has not been seen yet, in the order they were written.
+	Fifo<InFlightCommand> m_InFlightCommands;
+
+	// Writes with commands whose prompt has not been seen yet. Writes that resume are dropped once all of their commands complete, since no prompt follows them.
+	Fifo<InFlightWrite> m_InFlightWrites;
+
+	CdbBreakWaiter* m_BreakWaiter = nullptr;
+	bool m_Timed = false;
+	uint32_t m_ResumeCount = 0;
+	uint32_t m_NextCommandId = 0;
+	uint32_t m_NextWriteId = 0;
+};
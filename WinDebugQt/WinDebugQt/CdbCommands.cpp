@@ -0,0 +1,202 @@
+#include "CdbCommands.h"
+
+#include <format>
+
+namespace
+{
+	/*
+	* Parses the address at the start of a line of memory dump output, such as:
+	* 00007ff6`6ce7d170  00007ff6`6ce72200 00007ff6`6ce72260
+	* Returns the index of the first value after it, or 0 if the line is not memory dump output (such as an error message).
+	*/
+	size_t ParseDumpAddress(const std::string_view line, uint64_t& address)
+	{
+		const size_t addressLength = RegisterContextParser::ParseHex(line, address);
+		if (!addressLength || line.substr(addressLength, 2) != "  ")
+		{
+			return 0;
+		}
+
+		return addressLength + 2;
+	}
+
+	// The register dump never changes, so every RegistersQuery borrows this rather than copying it.
+	const CdbCommandBuilder& GetRegisterDumpCommand()
+	{
+		static const CdbCommandBuilder command = []()
+		{
+			CdbCommandBuilder builder;
+			builder.Append(RegisterContextParser::REGISTER_DUMP_COMMAND);
+			return builder;
+		}();
+		return command;
+	}
+
+	// Parses the qwords in a line of dq output onto the end of values, until it holds limit of them.
+	template <typename Values>
+	void ParseDumpQwords(const std::string_view line, Values& values, const size_t limit)
+	{
+		uint64_t address;
+		size_t index = ParseDumpAddress(line, address);
+		if (!index)
+		{
+			return;
+		}
+
+		// Each qword is separated by a space. Unreadable memory is printed as ?, which stops the parse.
+		while (values.size() < limit && index < line.size())
+		{
+			uint64_t value;
+			const size_t valueLength = RegisterContextParser::ParseHex(line.substr(index), value);
+			if (!valueLength)
+			{
+				break;
+			}
+
+			values.push_back(value);
+			index += valueLength + 1;
+		}
+	}
+
+	// Caps the element count of a memory dump at what its result can hold.
+	size_t CapCount(const size_t count, const size_t capacity)
+	{
+		return count < capacity ? count : capacity;
+	}
+}
+
+CdbAwaitable::CdbAwaitable(CdbCommandQueue& queue, std::string text)
+	: CdbCommand(std::move(text)),
+	m_CommandQueue(queue)
+{
+	queue.Submit(*this);
+}
+
+CdbAwaitable::CdbAwaitable(CdbCommandQueue& queue, const CdbCommandBuilder& builder)
+	: CdbCommand(builder),
+	m_CommandQueue(queue)
+{
+	queue.Submit(*this);
+}
+
+void CdbAwaitable::await_suspend(const std::coroutine_handle<> waiter)
+{
+	m_Waiter = waiter;
+	m_CommandQueue.Flush();
+}
+
+void CdbAwaitable::OnComplete(const bool succeeded)
+{
+	if (!succeeded)
+	{
+		return;
+	}
+
+	// If nothing is waiting yet, the result is picked up without suspending when it is awaited.
+	m_Completed = true;
+	if (m_Waiter)
+	{
+		m_Waiter.resume();
+	}
+}
+
+void BreakAwaiter::await_suspend(const std::coroutine_handle<> waiter)
+{
+	m_Waiter = waiter;
+	m_CommandQueue.Resume(m_ResumeCommand, this);
+}
+
+RegistersQuery::RegistersQuery(CdbCommandQueue& queue)
+	: CdbQuery(queue, GetRegisterDumpCommand())
+{
+}
+
+RegisterQuery::RegisterQuery(CdbCommandQueue& queue, const std::string_view registerName)
+	// Register names are short enough for the command to fit in the string's own buffer, so reading a register does not allocate.
+	: CdbQuery(queue, std::string("r ").append(registerName)),
+	m_RegisterName(std::string_view(GetText()).substr(2))
+{
+}
+
+void RegisterQuery::OnLine(const std::string_view line)
+{
+	RegisterContextParser::FindRegister(line, m_RegisterName, m_Result);
+}
+
+AllocQuery::AllocQuery(CdbCommandQueue& queue, const size_t size)
+	: CdbQuery(queue, std::format(".dvalloc 0x{:x}", size))
+{
+}
+
+void AllocQuery::OnLine(const std::string_view line)
+{
+	//Example .dvalloc output:
+	//Allocated 1000 bytes starting at 000001f2`3a5b0000
+	constexpr std::string_view PREFIX = "starting at ";
+	const size_t start = line.find(PREFIX);
+	if (start != std::string_view::npos)
+	{
+		RegisterContextParser::ParseHex(line.substr(start + PREFIX.size()), m_Result);
+	}
+}
+
+QwordsQuery::QwordsQuery(CdbCommandQueue& queue, const std::string_view address, const size_t count)
+	: CdbQuery(queue, std::format("dq {} L{:x}", address, CapCount(count, MemoryQwords::CAPACITY))),
+	m_Count(CapCount(count, MemoryQwords::CAPACITY))
+{
+}
+
+void QwordsQuery::OnLine(const std::string_view line)
+{
+	ParseDumpQwords(line, m_Result, m_Count);
+}
+
+QwordTableQuery::QwordTableQuery(CdbCommandQueue& queue, const CdbCommandBuilder& dumpCommand, std::vector<uint64_t>& result)
+	: CdbAwaitable(queue, dumpCommand),
+	m_Result(result)
+{
+	m_Result.clear();
+}
+
+void QwordTableQuery::OnLine(const std::string_view line)
+{
+	ParseDumpQwords(line, m_Result, SIZE_MAX);
+}
+
+BytesQuery::BytesQuery(CdbCommandQueue& queue, const std::string_view address, const size_t count)
+	: CdbQuery(queue, std::format("db {} L{:x}", address, CapCount(count, MemoryByteArray::CAPACITY))),
+	m_Count(CapCount(count, MemoryByteArray::CAPACITY))
+{
+}
+
+void BytesQuery::OnLine(const std::string_view line)
+{
+	//Example db output:
+	//00007ff6`6ce72589  cc eb 05 44 43 4d 44 01                          ...DCMD.
+	//Each line holds up to 16 bytes separated by spaces, or a dash in the middle, followed by their ascii form.
+	uint64_t address;
+	size_t index = ParseDumpAddress(line, address);
+	if (!index || m_Unreadable)
+	{
+		return;
+	}
+
+	if (m_Result.Bytes.empty())
+	{
+		m_Result.Address = address;
+	}
+
+	const size_t BYTES_PER_LINE = 16;
+	for (size_t lineCount = 0; lineCount < BYTES_PER_LINE && m_Result.Bytes.size() < m_Count && index + 2 <= line.size(); ++lineCount, index += 3)
+	{
+		uint64_t value;
+		if (RegisterContextParser::ParseHex(line.substr(index, 2), value) != 2)
+		{
+			// Unreadable memory is printed as ??, and nothing after it is usable.
+			m_Unreadable = true;
+			return;
+		}
+
+		m_Result.Bytes.push_back((uint8_t)value);
+	}
+}
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <coroutine>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "CdbCommandQueue.h"
+#include "RegisterContext.h"
+
+/*
+* A CDB command that a DbgTask can co_await. It is submitted to the queue as soon as it is constructed, and awaiting it flushes it
+* to CDB along with everything else submitted before it. So several commands can be created first and then awaited, to send them
+* all in one write. The awaiting coroutine resumes once the command succeeds; if CDB aborts it, the coroutine is never resumed,
+* and the queue's failure callback is left to cancel it.
+* Commands are neither copyable nor movable, as the queue refers to them until they complete. They live in the awaiting coroutine's frame.
+*/
+class CdbAwaitable : public CdbCommand
+{
+public:
+	CdbAwaitable(CdbCommandQueue& queue, std::string text);
+
+	// Borrows the text built in builder, which must not be rebuilt until the command completes.
+	CdbAwaitable(CdbCommandQueue& queue, const CdbCommandBuilder& builder);
+
+	bool await_ready() const { return m_Completed; }
+	void await_suspend(const std::coroutine_handle<> waiter);
+
+	virtual void OnComplete(const bool succeeded) override;
+
+private:
+	CdbCommandQueue& m_CommandQueue;
+	std::coroutine_handle<> m_Waiter;
+	bool m_Completed = false;
+};
+
+// A CDB command whose output is parsed into a Result, which is what awaiting it gives back.
+template <typename Result>
+class CdbQuery : public CdbAwaitable
+{
+public:
+	using CdbAwaitable::CdbAwaitable;
+
+	Result await_resume() { return std::move(m_Result); }
+
+protected:
+	Result m_Result{};
+};
+
+// Runs a command whose output is of no interest, such as a register assignment.
+class ExecCommand : public CdbAwaitable
+{
+public:
+	using CdbAwaitable::CdbAwaitable;
+
+	void await_resume() {}
+
+	virtual void OnLine(const std::string_view) override {}
+};
+
+/*
+* Resumes the debuggee with a Resume command and waits for it to break again. Everything submitted before it goes out in the same write.
+* resumeCommand is only referred to, so it must stay valid until the awaiter is awaited, which is when it is written.
+*/
+class BreakAwaiter : public CdbBreakWaiter
+{
+public:
+	BreakAwaiter(CdbCommandQueue& queue, const std::string_view resumeCommand) : m_CommandQueue(queue), m_ResumeCommand(resumeCommand) {}
+	BreakAwaiter(const BreakAwaiter&) = delete;
+	BreakAwaiter& operator=(const BreakAwaiter&) = delete;
+	virtual ~BreakAwaiter() override { m_CommandQueue.CancelBreakWaiter(*this); }
+
+	bool await_ready() const { return false; }
+	void await_suspend(const std::coroutine_handle<> waiter);
+	void await_resume() {}
+
+	virtual void OnBreak() override { m_Waiter.resume(); }
+
+private:
+	CdbCommandQueue& m_CommandQueue;
+	std::string_view m_ResumeCommand;
+	std::coroutine_handle<> m_Waiter;
+};
+
+// A fixed capacity array for query results, so they can be held in a coroutine frame without allocating.
+template <typename T, size_t Capacity>
+class InlineArray
+{
+public:
+	static constexpr size_t CAPACITY = Capacity;
+
+	void push_back(const T value) { m_Values[m_Size++] = value; }
+	size_t size() const { return m_Size; }
+	bool empty() const { return m_Size == 0; }
+	const T& operator[](const size_t index) const { return m_Values[index]; }
+	const T* begin() const { return m_Values; }
+	const T* end() const { return m_Values + m_Size; }
+
+private:
+	T m_Values[Capacity] = {};
+	size_t m_Size = 0;
+};
+
+// Reads a full register snapshot with RegisterContextParser::REGISTER_DUMP_COMMAND.
+class RegistersQuery : public CdbQuery<RegisterContext>
+{
+public:
+	explicit RegistersQuery(CdbCommandQueue& queue);
+
+	virtual void OnLine(const std::string_view line) override { m_Parser.ParseLine(line, m_Result); }
+
+private:
+	RegisterContextParser m_Parser;
+};
+
+// Reads the value of a single register.
+class RegisterQuery : public CdbQuery<uint64_t>
+{
+public:
+	RegisterQuery(CdbCommandQueue& queue, const std::string_view registerName);
+
+	virtual void OnLine(const std::string_view line) override;
+
+private:
+	std::string_view m_RegisterName; // Points into the command text.
+};
+
+// Allocates size bytes of memory in the debuggee that can be written and executed, with .dvalloc. Gives back where it starts, or 0 if CDB did not say.
+class AllocQuery : public CdbQuery<uint64_t>
+{
+public:
+	AllocQuery(CdbCommandQueue& queue, const size_t size);
+
+	virtual void OnLine(const std::string_view line) override;
+};
+
+// Debuggee qwords read by a QwordsQuery. Shorter than requested if some of the memory could not be read.
+using MemoryQwords = InlineArray<uint64_t, 32>;
+
+// Reads count qwords of debuggee memory starting at address, which may be any CDB expression. count is capped at MemoryQwords::CAPACITY.
+class QwordsQuery : public CdbQuery<MemoryQwords>
+{
+public:
+	QwordsQuery(CdbCommandQueue& queue, const std::string_view address, const size_t count);
+
+	virtual void OnLine(const std::string_view line) override;
+
+private:
+	size_t m_Count;
+};
+
+/*
+* Reads however many qwords dumpCommand, a dq, prints into result, which it clears first. The command's text is borrowed, like CdbAwaitable's.
+* The count of a dq may be any CDB expression, so a table can be read in the same command as whatever says how long it is.
+* result is kept by the caller, so once it has grown, reading the table again does not allocate.
+*/
+class QwordTableQuery : public CdbAwaitable
+{
+public:
+	QwordTableQuery(CdbCommandQueue& queue, const CdbCommandBuilder& dumpCommand, std::vector<uint64_t>& result);
+
+	void await_resume() {}
+
+	virtual void OnLine(const std::string_view line) override;
+
+private:
+	std::vector<uint64_t>& m_Result;
+};
+
+using MemoryByteArray = InlineArray<uint8_t, 64>;
+
+// Debuggee memory read by a BytesQuery.
+struct MemoryBytes
+{
+	uint64_t Address = 0;
+	MemoryByteArray Bytes; // Shorter than requested if some of the memory could not be read.
+};
+
+// Reads count bytes of debuggee memory starting at address, which may be any CDB expression. count is capped at MemoryByteArray::CAPACITY.
+class BytesQuery : public CdbQuery<MemoryBytes>
+{
+public:
+	BytesQuery(CdbCommandQueue& queue, const std::string_view address, const size_t count);
+
+	virtual void OnLine(const std::string_view line) override;
+
+private:
+	size_t m_Count;
+	bool m_Unreadable = false;
+};
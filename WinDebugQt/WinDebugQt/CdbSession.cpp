@@ -0,0 +1,873 @@
+#include "CdbSession.h"
+
+#include <atomic>
+#include <cstring>
+#include <format>
+#include <iterator>
+#include <optional>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace
+{
+	/*
+	* Fires a batch of callbacks back to back, a Win64 function taking where the return values go in rcx, the calls in rdx and their count in r8.
+	* Each call is its address followed by three arguments. The alt stack is not executable, so this goes in memory allocated with .dvalloc.
+	*/
+	constexpr uint8_t BATCH_TRAMPOLINE[] =
+	{
+		0x53,                   // push rbx
+		0x56,                   // push rsi
+		0x57,                   // push rdi
+		0x48, 0x83, 0xec, 0x20, // sub rsp, 20h (home space for the callbacks, which also realigns rsp to 16)
+		0x48, 0x89, 0xcf,       // mov rdi, rcx
+		0x48, 0x89, 0xd3,       // mov rbx, rdx
+		0x4c, 0x89, 0xc6,       // mov rsi, r8
+		0x48, 0x85, 0xf6,       // next: test rsi, rsi
+		0x74, 0x1e,             // jz done
+		0x48, 0x8b, 0x4b, 0x08, // mov rcx, [rbx+8]
+		0x48, 0x8b, 0x53, 0x10, // mov rdx, [rbx+10h]
+		0x4c, 0x8b, 0x43, 0x18, // mov r8, [rbx+18h]
+		0xff, 0x13,             // call qword ptr [rbx]
+		0x48, 0x89, 0x07,       // mov [rdi], rax
+		0x48, 0x83, 0xc7, 0x08, // add rdi, 8
+		0x48, 0x83, 0xc3, 0x20, // add rbx, 20h
+		0x48, 0xff, 0xce,       // dec rsi
+		0xeb, 0xdd,             // jmp next
+		0x48, 0x83, 0xc4, 0x20, // done: add rsp, 20h
+		0x5f,                   // pop rdi
+		0x5e,                   // pop rsi
+		0x5b,                   // pop rbx
+		0xc3,                   // ret
+	};
+
+	// What .dvalloc is asked for, which it rounds up to a page anyway.
+	constexpr size_t BATCH_TRAMPOLINE_ALLOC_SIZE = 0x1000;
+
+	/*
+	* Dumps the callback registry passed to debuggerCmdSetCallbacks, sized by the entry count passed along with it, so it is read in one go.
+	* The count is an unsigned, so only edx is read. A count over MAX_CALLBACKS is taken as 0, so only the header is dumped, and the registry is refused.
+	* It never changes, so every read borrows this rather than building it again.
+	*/
+	const CdbCommandBuilder& GetRegistryDumpCommand()
+	{
+		static const CdbCommandBuilder command = []()
+		{
+			CdbCommandBuilder builder;
+			builder.Append("dq @rcx L?(@edx<").AppendHex(MAX_CALLBACKS + 1).Append(")*@edx*").AppendHex(CallbackRegistry::ENTRY_QWORDS)
+				.Append("+").AppendHex(CallbackRegistry::HEADER_QWORDS);
+			return builder;
+		}();
+		return command;
+	}
+
+	// Numbers the sessions of this process, to tell their dump files apart.
+	std::atomic<uint64_t> s_NextSessionNumber = 1;
+
+	uint64_t GetProcessNumber()
+	{
+#ifdef _WIN32
+		return (uint64_t)_getpid();
+#else
+		return (uint64_t)getpid();
+#endif
+	}
+
+	/*
+	* Whether line is the disassembly CDB prints of the instruction it broke on, and if so, where the instruction is.
+	* That is the address, the instruction's bytes in hex, and then its mnemonic, each separated by spaces.
+	* Memory dumps also start with an address, but are followed by two spaces.
+	* Example:
+	* 00007ff6`6ce72580 cc              int     3
+	*/
+	bool ParseDisassemblyLine(const std::string_view line, uint64_t& address)
+	{
+		if (RegisterContextParser::ParseHex(line, address) != 17 || line[8] != '`' || line.substr(17, 1) != " ")
+		{
+			return false;
+		}
+
+		const std::string_view rest = line.substr(18);
+		const size_t bytesLength = std::min(rest.find(' '), rest.size());
+		uint64_t byte;
+		if (bytesLength == 0 || bytesLength % 2 != 0)
+		{
+			return false;
+		}
+		for (size_t i = 0; i < bytesLength; i += 2)
+		{
+			if (RegisterContextParser::ParseHex(rest.substr(i, 2), byte) != 2)
+			{
+				return false;
+			}
+		}
+
+		const size_t mnemonic = rest.find_first_not_of(' ', bytesLength);
+		return mnemonic != std::string_view::npos && mnemonic > bytesLength;
+	}
+
+	// Where offset bytes below stackTop is, once stackTop is aligned down to 16. 0 if stackTop is, as then only CDB knows where rsp is.
+	uint64_t GetStackBelow(const uint64_t stackTop, const uint64_t offset)
+	{
+		return stackTop ? (stackTop & ~15ull) - offset : 0;
+	}
+
+	// Appends where offset bytes below stackTop is, as GetStackBelow does. If stackTop is 0, rsp is used, which CDB works out.
+	void AppendStackBelow(CdbCommandBuilder& command, const uint64_t stackTop, const uint64_t offset)
+	{
+		if (stackTop)
+		{
+			command.AppendHex(GetStackBelow(stackTop, offset));
+		}
+		else
+		{
+			command.Append("(@rsp&0xfffffffffffffff0)-").AppendHex(offset);
+		}
+	}
+
+	// How far below the stack top a single call's return address is written.
+	constexpr uint64_t CALL_FRAME_OFFSET = 0x28;
+
+	// The size of the return values and calls FormatBatchCallCommand lays out, which take 40 bytes each.
+	// Rounded up to 16 so the return address below them sits where a call would leave it, at 8 past a multiple of 16.
+	size_t GetBatchTableSize(const size_t callCount)
+	{
+		return (callCount * 40 + 15) & ~(size_t)15;
+	}
+
+	// The size of the call block FormatTrampolineCallCommand lays out, aligned to 16 as the trampoline saves xmm registers below it with movdqa.
+	size_t GetCallBlockSize(const size_t callCount)
+	{
+		return (sizeof(CallBlockHeader) + callCount * (sizeof(uint64_t) + sizeof(CallBlockCall)) + 15) & ~(size_t)15;
+	}
+}
+
+bool CdbSession::StartTrace(const std::filesystem::path& path)
+{
+	m_Trace = std::make_unique<TraceRecorder>();
+	if (!m_Trace->Open(path))
+	{
+		m_Trace.reset();
+		return false;
+	}
+
+	// Replays are given the same prefix, so the dumps they ask for match those in the trace.
+	m_Trace->Record(TraceDirection::DumpPrefix, GetDumpFilePrefix().string());
+	return true;
+}
+
+void CdbSession::SetProfiling(const bool enabled)
+{
+	m_Profile.SetEnabled(enabled);
+	m_CommandQueue.SetTimed(enabled);
+	m_LastWriteAt = {};
+}
+
+CdbSession::~CdbSession()
+{
+	RemoveTelemetryFile();
+}
+
+void CdbSession::Reset()
+{
+	m_Running = false;
+	m_CdbTokenizer.Reset();
+	m_FrameQueue.Clear();
+
+	m_ActiveHandler = {};
+	m_CommandQueue.Clear();
+	m_MemoryCache.Reset();
+	m_EventFilters.Reset();
+	m_FirstPrompt = true;
+	m_DbgCmdSites.Reset();
+	m_BreakAddress = 0;
+	m_AltStackLocation = 0;
+	m_Callbacks.Clear();
+	m_BatchTrampoline = 0;
+	m_CallTrampoline = 0;
+	m_CallTrampolineBreak.reset();
+
+	RemoveTelemetryFile();
+}
+
+bool CdbSession::QueueFrames(const std::string_view received)
+{
+	if (m_Trace)
+	{
+		m_Trace->Record(TraceDirection::Read, received);
+	}
+
+	// Frame everything that has arrived. Only the first frame queued since the last drain needs to wake up the thread that drains them.
+	bool wasEmpty = false;
+	std::string_view frame;
+	int frameType;
+	while (m_Transport.NextFrame(frame, m_CdbTokenizer, frameType))
+	{
+		wasEmpty |= m_FrameQueue.Push(frame, frameType);
+	}
+
+	return wasEmpty;
+}
+
+void CdbSession::DrainFrames()
+{
+	m_FrameQueue.TakeAll(m_DrainBatch);
+	if (!m_DrainBatch.Frames.empty())
+	{
+		m_Profile.RecordSince(SessionProfile::Phase::Dispatch, m_DrainBatch.QueuedAt);
+	}
+
+	// A frame handler may stop the session, in which case the rest of the batch is stale.
+	for (size_t i = 0; i < m_DrainBatch.Frames.size() && m_Running; ++i)
+	{
+		const FrameQueue::Batch::Frame& frame = m_DrainBatch.Frames[i];
+		HandleFrame(m_DrainBatch.GetText(frame), frame.Type);
+	}
+}
+
+void CdbSession::HandleFrame(const std::string_view out, const int frameType)
+{
+	// Echo everything we read to the log, apart from the queue's bookkeeping.
+	if (!CdbCommandQueue::IsSentinel(out))
+	{
+		m_Log.Write(out);
+	}
+
+	// Handling the frame may write to CDB again, so what it answers is measured from the write before.
+	const SessionProfile::Clock::time_point lastWriteAt = m_LastWriteAt;
+
+	if (frameType == OutputTokenizer::FRAME_TYPE_PROMPT)
+	{
+		if (m_FirstPrompt)
+		{
+			// Scan and continue if it's the first prompt that is sent on connection.
+			m_FirstPrompt = false;
+			m_ActiveHandler = HandleAttach();
+			m_ActiveHandler.Start();
+		}
+		else if (m_CommandQueue.OnPrompt())
+		{
+			m_Profile.RecordSince(SessionProfile::Phase::Prompt, lastWriteAt);
+		}
+		else
+		{
+			m_ActiveHandler = HandlePrompt(m_BreakAddress);
+			m_ActiveHandler.Start();
+		}
+		m_BreakAddress = 0;
+	}
+	else if (m_CommandQueue.OnLine(out))
+	{
+		m_Profile.RecordSince(SessionProfile::Phase::Line, lastWriteAt);
+	}
+	else if (m_DbgCmdSites.AddModule(out))
+	{
+		// Scanned once the debuggee stops.
+	}
+	else if (uint64_t address; ParseDisassemblyLine(out, address))
+	{
+		// CDB prints the instruction it broke on as the last line before the prompt, starting with its address.
+		m_BreakAddress = address;
+	}
+	else if (out.find("No runnable debuggees") != std::string_view::npos)
+	{
+		LogMessage("The application has exited!\n");
+		const DebuggeeMemoryCache::Stats& cacheStats = m_MemoryCache.GetStats();
+		LogFormatted<160>("Memory cache: {} hits, {} misses, {} fetches of {} bytes, {} invalidations.\n",
+			cacheStats.Hits, cacheStats.Misses, cacheStats.Fetches, cacheStats.FetchedBytes, cacheStats.Invalidations);
+		if (const std::string counts = m_EventFilters.FormatCounts(); !counts.empty())
+		{
+			LogFormatted<160>("Events counted by CDB, as of the last break: {}.\n", counts);
+		}
+		Stop();
+	}
+}
+
+DbgTask<> CdbSession::HandleAttach()
+{
+	// The event filters go out in a write of their own, as CDB drops the rest of a line after a failed command, and a module dump can fail.
+	// If CDB rejects the filters, the failure handler resumes the debuggee without them, and the modules are scanned at the next break instead.
+	if (!m_EventFilters.IsEmpty())
+	{
+		ExecCommand filters(m_CommandQueue, m_EventFilters.FormatSetupCommand());
+		co_await filters;
+	}
+
+	co_await ScanModules();
+	LogFormatted<64>("Found {} debug commands in the loaded modules!\n", m_DbgCmdSites.GetSiteCount());
+	m_CommandQueue.Resume("g");
+}
+
+DbgTask<> CdbSession::HandlePrompt(const uint64_t breakAddress)
+{
+	// The break came in with the batch being drained now.
+	const std::chrono::steady_clock::time_point breakTime = m_DrainBatch.QueuedAt;
+
+	// Events counted inside CDB are picked up whenever the debuggee stops anyway, in the first write of the break.
+	m_EventFilters.ReadCounters(m_CommandQueue);
+
+	// Modules loaded since the last break are scanned before anything else, as the break may be in one of them.
+	// CDB only announces them as they load, so the debuggee does not have to stop for each one.
+	if (m_DbgCmdSites.HasPendingModules())
+	{
+		co_await ScanModules();
+	}
+
+	// We need to check whether rip is on a debug command, and if so, which one it is (since the opcode for them is stored inline in the assembly functions).
+	uint8_t opCode = 0;
+	bool isDbgCmd = false;
+	if (m_DbgCmdSites.IsComplete())
+	{
+		// Every debug command is known, so rip is all that is needed, and CDB has usually printed it already.
+		uint64_t rip = breakAddress;
+		if (!rip)
+		{
+			rip = co_await ReadRegister("rip");
+		}
+		isDbgCmd = m_DbgCmdSites.Find(rip, opCode);
+	}
+	else
+	{
+		// Otherwise the code at rip has to be read and checked. If CDB printed where it broke, it is read through the cache,
+		// which keeps the rest of its page for any handler that reads near it. Otherwise rip is read along with the code there.
+		//Example db output:
+		//00007ff6`6ce72589  cc eb 05 44 43 4d 44 01                          ...DCMD. 
+		MemoryBytes memory;
+		if (breakAddress)
+		{
+			memory = co_await ReadMemory(breakAddress, DBG_CMD_SIGNATURE_SIZE);
+		}
+		else
+		{
+			memory = co_await ReadBytes("@rip", DBG_CMD_SIGNATURE_SIZE);
+			m_MemoryCache.Insert(memory.Address, memory.Bytes.begin(), memory.Bytes.size());
+		}
+		isDbgCmd = memory.Bytes.size() == DBG_CMD_SIGNATURE_SIZE && ParseDbgCmdSignature(memory.Bytes.begin(), opCode);
+	}
+
+	if (isDbgCmd)
+	{
+		m_Profile.RecordSince(SessionProfile::Phase::Decode, breakTime);
+
+		co_await HandleDbgCmd(opCode);
+		if (m_DbgCmdObserver || m_Profile.IsEnabled())
+		{
+			const std::chrono::nanoseconds latency = std::chrono::steady_clock::now() - breakTime;
+			m_Profile.RecordDbgCmd(opCode, latency);
+			if (m_DbgCmdObserver)
+			{
+				m_DbgCmdObserver(opCode, latency);
+			}
+		}
+	}
+	else
+	{
+		// Unidentified break, since it was not a DbgCmd. Print the stack and go unhandled.
+		m_CommandQueue.Resume("kn; gn");
+	}
+}
+
+DbgTask<> CdbSession::ScanModules()
+{
+	std::vector<DbgCmdSites::Module> modules;
+	m_DbgCmdSites.TakePendingModules(modules);
+
+	// A dump that fails, such as when its file cannot be written, cancels the handler, and the failure handler abandons the modules.
+	// The sites are then incomplete, and every break is checked by reading the code at rip instead, as it was before modules were scanned.
+	std::vector<std::filesystem::path> files;
+	std::vector<std::unique_ptr<ExecCommand>> dumps;
+	for (const DbgCmdSites::Module& module : modules)
+	{
+		files.push_back(GetDumpFilePrefix().string() + std::format("{}.bin", files.size()));
+		dumps.push_back(std::make_unique<ExecCommand>(m_CommandQueue, std::format(".writemem \"{}\" 0x{:x} L?0x{:x}", files.back().string(), module.Base, module.End - module.Base)));
+	}
+	for (const std::unique_ptr<ExecCommand>& dump : dumps)
+	{
+		ExecCommand& written = *dump;
+		co_await written;
+	}
+
+	for (size_t i = 0; i < modules.size(); ++i)
+	{
+		if (ReadDump(files[i], m_ScanImage))
+		{
+			const size_t moduleSize = (size_t)(modules[i].End - modules[i].Base);
+			m_DbgCmdSites.AddScan(modules[i], m_ScanImage.data(), m_ScanImage.size() < moduleSize ? m_ScanImage.size() : moduleSize);
+		}
+		else
+		{
+			LogFormatted<128>("Could not read the dump of the module at 0x{:x}. Debug commands will be found by reading the code at each break.\n", modules[i].Base);
+		}
+
+		std::error_code error;
+		std::filesystem::remove(files[i], error);
+	}
+	m_DbgCmdSites.AbandonScans();
+}
+
+const std::filesystem::path& CdbSession::GetDumpFilePrefix()
+{
+	if (m_DumpFilePrefix.empty())
+	{
+		std::error_code error;
+		m_DumpFilePrefix = std::filesystem::temp_directory_path(error) / std::format("WinDebugQt-{}-{}-", GetProcessNumber(), s_NextSessionNumber++);
+	}
+	return m_DumpFilePrefix;
+}
+
+bool CdbSession::ReadDump(const std::filesystem::path& path, std::vector<uint8_t>& image)
+{
+	const bool read = m_Transport.ReadDump(path, image);
+	if (m_Trace)
+	{
+		m_Trace->Record(TraceDirection::Dump, std::string_view((const char*)image.data(), image.size()));
+	}
+	return read;
+}
+
+void CdbSession::RemoveTelemetryFile()
+{
+	if (!m_TelemetryFile.empty())
+	{
+		std::error_code error;
+		std::filesystem::remove(m_TelemetryFile, error);
+	}
+}
+
+void CdbSession::WriteToCdbProc(const std::string_view string)
+{
+	// Recorded before it is written, so CDB's reply can never come before it in the trace.
+	if (m_Trace)
+	{
+		m_Trace->Record(TraceDirection::Write, string);
+	}
+
+	const SessionProfile::Clock::time_point writeStart = m_Profile.Now();
+	if (m_Transport.Write(string))
+	{
+		// Echo everything we write to the log.
+		m_Log.Write(string);
+	}
+	m_Profile.RecordSince(SessionProfile::Phase::Write, writeStart);
+	m_LastWriteAt = writeStart;
+}
+
+void CdbSession::HandleCommandFailure(const CdbCommand& command)
+{
+	// The command lives in the handler's frame, so it has to be logged before the handler is destroyed.
+	LogFormatted<256>("CDB did not complete the command: {}\n", command.GetText());
+
+	// CDB drops the rest of the line after a failed command, including any command that would have resumed the debuggee, so it is still stopped.
+	// Several commands of the same write can fail at once, but only the first finds the handler still running.
+	if (m_ActiveHandler)
+	{
+		m_ActiveHandler = {};
+
+		// If the handler was scanning modules, the rest of their dumps were dropped along with the failed one.
+		if (const size_t abandoned = m_DbgCmdSites.AbandonScans())
+		{
+			LogFormatted<128>("Could not dump {} modules. Debug commands will be found by reading the code at each break.\n", abandoned);
+		}
+		m_CommandQueue.Resume("gh");
+	}
+}
+
+DbgTask<> CdbSession::HandleDbgCmd(const uint8_t opCode)
+{
+	// Generated from DBG_CMD_LIST, so a command added there fails to build until it has a handler here.
+	// The handler's task is handed straight back rather than awaited, so dispatching takes no coroutine frame of its own.
+	using Handler = DbgTask<> (CdbSession::*)();
+#define DBG_CMD_HANDLER(name, opCode, parameters) &CdbSession::HandleDbgCmd##name,
+	static constexpr Handler HANDLERS[] = { DBG_CMD_LIST(DBG_CMD_HANDLER) };
+#undef DBG_CMD_HANDLER
+
+	return opCode < DBG_CMD_COUNT ? (this->*HANDLERS[opCode])() : HandleUnknownDbgCmd(opCode);
+}
+
+DbgTask<> CdbSession::HandleUnknownDbgCmd(const uint8_t opCode)
+{
+	LogFormatted<48>("Unknown debugger command {}!\n", opCode);
+	m_CommandQueue.Resume("gh");
+	co_return;
+}
+
+DbgTask<> CdbSession::HandleDbgCmdNop()
+{
+	m_CommandQueue.Resume("gh");
+	LogMessage("Processed a nop!\n");
+	co_return;
+}
+
+DbgTask<> CdbSession::HandleDbgCmdSetCallbacks()
+{
+	// Rcx stores the first param passed in, which is the location of the callback registry in the debuggee application.
+	// Rdx stores the second, the number of entries in it, which the dump is sized by, so the whole registry is read in one command however long it is, up to MAX_CALLBACKS.
+	QwordTableQuery registryQuery(m_CommandQueue, GetRegistryDumpCommand(), m_RegistryQwords);
+	co_await registryQuery;
+	if (!m_Callbacks.Load(m_RegistryQwords))
+	{
+		LogMessage("Error setting callbacks! The registry could not be read, or is not of a version this debugger supports!\n");
+		m_CommandQueue.Resume("gh");
+		co_return;
+	}
+	LogMessage("Callbacks have been set!\n");
+
+	const CallbackRegistryEntry* const printAAA = FindCallback(DbgCallbacks::PrintAAA);
+	const CallbackRegistryEntry* const returnDoubleTheInput = FindCallback(DbgCallbacks::ReturnDoubleTheInput);
+	if (!printAAA || !returnDoubleTheInput)
+	{
+		m_CommandQueue.Resume("gh");
+		co_return;
+	}
+
+	// Both callbacks are fired in the same batch, so the registers are only saved and restored once.
+	LogMessage("Firing callbacks PrintAAA and ReturnDoubleTheInput!\n");
+	const int valueToDouble = 7;
+	const CallbackCall calls[] = { { printAAA->Address }, { returnDoubleTheInput->Address, { valueToDouble } } };
+	const MemoryQwords retValues = co_await CallBatch(calls);
+	if (retValues.size() == std::size(calls))
+	{
+		LogFormatted<64>("Double the value of {} is {}!\n", valueToDouble, retValues[1]);
+	}
+	else
+	{
+		LogMessage("Error firing callbacks! Their return values could not be read!\n");
+	}
+
+	m_CommandQueue.Resume("gh");
+}
+
+const CallbackRegistryEntry* CdbSession::FindCallback(const CallbackId& id)
+{
+	const CallbackRegistryEntry* const callback = m_Callbacks.Find(id);
+	if (!callback)
+	{
+		LogFormatted<112>("Error firing callback {:x}! The debuggee has not registered it as this debugger calls it!\n", id.NameHash);
+	}
+	return callback;
+}
+
+DbgTask<> CdbSession::HandleDbgCmdRegisterAltStack()
+{
+	// Rcx stores the first param passed in, which is the location of the static char array used for the new stack location in the debuggee application.
+	// Nothing else needs to happen in this stop, so the debuggee is resumed in the same write.
+	RegisterQuery addressQuery = ReadRegister("rcx");
+	m_CommandQueue.Resume("gh");
+
+	m_AltStackLocation = co_await addressQuery;
+	LogMessage("The alternate stack location has been set!\n");
+}
+
+DbgTask<> CdbSession::HandleDbgCmdRegisterCallTrampoline()
+{
+	// Rcx stores the first param passed in, which is the location of debuggerCallTrampoline in the debuggee application.
+	RegisterQuery addressQuery = ReadRegister("rcx");
+	m_CommandQueue.Resume("gh");
+
+	m_CallTrampoline = co_await addressQuery;
+	LogMessage("The call trampoline location has been set!\n");
+}
+
+DbgTask<> CdbSession::HandleDbgCmdFlushTelemetry()
+{
+	// Rcx stores the first param passed in, which is the location of the records the debuggee has batched up, and rdx the second, their size.
+	// They are fetched with a binary dump, which is far less for CDB to print and for us to parse than a db of the same memory.
+	// The debuggee is resumed in the same write, as it is free to reuse its buffer once the dump has been written.
+	// A dump that fails drops the resume along with it, which HandleCommandFailure makes up for.
+	// A size over MAX_TELEMETRY_FLUSH_SIZE is taken as 0 in the dump's own expression, so a bad size is never dumped, and the flush is dropped.
+	if (m_TelemetryFile.empty())
+	{
+		m_TelemetryFile = GetDumpFilePrefix().string() + "telemetry.bin";
+		m_TelemetryDumpCommand.Clear().Append(".writemem \"").Append(m_TelemetryFile.string()).Append("\" @rcx L?(@rdx<")
+			.AppendHex(MAX_TELEMETRY_FLUSH_SIZE + 1).Append(")*@rdx");
+	}
+	ExecCommand dump = Exec(m_TelemetryDumpCommand);
+	m_CommandQueue.Resume("gh");
+	co_await dump;
+
+	if (!ReadDump(m_TelemetryFile, m_TelemetryImage))
+	{
+		LogMessage("Error reading telemetry! Its dump could not be read, or it was larger than this debugger supports!\n");
+		co_return;
+	}
+
+	const uint64_t recordsBefore = m_Telemetry.GetStats().Records;
+	if (!m_Telemetry.Deliver(m_TelemetryImage))
+	{
+		LogMessage("Error reading telemetry! The flush was cut short, or is not of a version this debugger supports!\n");
+		co_return;
+	}
+
+	LogFormatted<64>("Received {} telemetry records!\n", m_Telemetry.GetStats().Records - recordsBefore);
+}
+
+DbgTask<uint64_t> CdbSession::CallWithArgs(const uint64_t callbackAddress, const std::array<uint64_t, CALLBACK_ARG_COUNT> args)
+{
+	if (m_CallTrampoline)
+	{
+		const CallbackCall call[] = { { callbackAddress, args } };
+		const MemoryQwords retValues = co_await CallThroughTrampoline(call);
+		co_return retValues.empty() ? 0 : retValues[0];
+	}
+
+	// Get the register values so we can restore them later. Each call keeps its own copy, so callbacks could be fired from within callback handling.
+	RegistersQuery savedQuery = Regs();
+
+	// The new register values are computed by CDB from the current ones, so the call can be set up in the same write as the register dump.
+	// Win64 ABI requires rsp%16=0, except within a function prologue. Since it is possible we are in the prologue, first align the stack pointer then decrement by 8 to simulate a near call.
+	// Subtract another 32-bytes for the parameter home space. If an alternate stack location has been set, use that instead of the current stack location.
+	// The call writes the return address onto the new stack, so whatever is cached of it is dropped.
+	InvalidateWritten(GetStackBelow(m_AltStackLocation, CALL_FRAME_OFFSET), sizeof(uint64_t));
+
+	const SessionProfile::Clock::time_point callStart = m_Profile.Now();
+	co_await ResumeUntilBreak(FormatCallCommand(m_CallCommand, callbackAddress, m_AltStackLocation, args));
+
+	// The callback returned to address 0. The register dump went out with the call setup, so it is already here.
+	m_Profile.RecordBetween(SessionProfile::Phase::SaveContext, callStart, savedQuery.GetCompletedAt());
+	m_Profile.RecordSince(SessionProfile::Phase::Call, savedQuery.GetCompletedAt());
+	const RegisterContext context = co_await savedQuery;
+
+	// Read the callback's return value and restore the volatile registers in a single write.
+	RegisterQuery returnValueQuery = ReadRegister("rax");
+
+	const SessionProfile::Clock::time_point restoreStart = m_Profile.Now();
+	FormatRestoreCommand(m_RestoreCommand, context);
+	co_await Exec(m_RestoreCommand);
+	m_Profile.RecordBetween(SessionProfile::Phase::ReturnRead, restoreStart, returnValueQuery.GetCompletedAt());
+	m_Profile.RecordSince(SessionProfile::Phase::Restore, returnValueQuery.GetCompletedAt());
+
+	co_return co_await returnValueQuery;
+}
+
+DbgTask<MemoryQwords> CdbSession::ReadMemoryQwords(const uint64_t address, const size_t count)
+{
+	// Every page is wanted up front, so the first read fetches them all in one write, and the rest are served from the cache.
+	const size_t byteCount = (count < MemoryQwords::CAPACITY ? count : MemoryQwords::CAPACITY) * sizeof(uint64_t);
+	m_MemoryCache.Prefetch(address, byteCount);
+
+	MemoryQwords qwords;
+	for (size_t offset = 0; offset < byteCount; offset += MemoryByteArray::CAPACITY)
+	{
+		const size_t readSize = byteCount - offset < MemoryByteArray::CAPACITY ? byteCount - offset : MemoryByteArray::CAPACITY;
+		const MemoryBytes memory = co_await ReadMemory(address + offset, readSize);
+		for (size_t i = 0; i + sizeof(uint64_t) <= memory.Bytes.size(); i += sizeof(uint64_t))
+		{
+			uint64_t qword;
+			std::memcpy(&qword, memory.Bytes.begin() + i, sizeof(qword));
+			qwords.push_back(qword);
+		}
+
+		// Stop at the first byte that could not be read, as a QwordsQuery does.
+		if (memory.Bytes.size() < readSize)
+		{
+			break;
+		}
+	}
+	co_return qwords;
+}
+
+void CdbSession::InvalidateWritten(const uint64_t address, const size_t count)
+{
+	if (address)
+	{
+		m_MemoryCache.Invalidate(address, count);
+	}
+	else
+	{
+		m_MemoryCache.InvalidateAll();
+	}
+}
+
+DbgTask<MemoryQwords> CdbSession::CallBatch(const std::span<const CallbackCall> calls)
+{
+	const std::span<const CallbackCall> batch = calls.first(calls.size() < MAX_BATCH_CALLS ? calls.size() : MAX_BATCH_CALLS);
+	if (m_CallTrampoline)
+	{
+		co_return co_await CallThroughTrampoline(batch);
+	}
+
+	// The trampoline is put in the debuggee the first time it is needed. Writing it goes out along with the first batch.
+	std::optional<ExecCommand> trampolineWrite;
+	if (!m_BatchTrampoline)
+	{
+		AllocQuery allocQuery(m_CommandQueue, BATCH_TRAMPOLINE_ALLOC_SIZE);
+		m_BatchTrampoline = co_await allocQuery;
+		if (!m_BatchTrampoline)
+		{
+			LogMessage("Could not allocate memory in the debuggee for the batch trampoline!\n");
+			co_return MemoryQwords{};
+		}
+		trampolineWrite.emplace(m_CommandQueue, FormatBatchTrampolineWrite(m_BatchTrampoline));
+	}
+
+	// As with a single call, the registers are dumped in the same write as the calls are set up, and the stack is realigned to 16 first.
+	RegistersQuery savedQuery = Regs();
+
+	// The calls and their return values are written to the stack below a return address, so whatever is cached of them is dropped.
+	const size_t tableSize = GetBatchTableSize(batch.size()) + sizeof(uint64_t);
+	const uint64_t tableAddress = GetStackBelow(m_AltStackLocation, tableSize);
+	InvalidateWritten(tableAddress, tableSize);
+
+	const SessionProfile::Clock::time_point callStart = m_Profile.Now();
+	co_await ResumeUntilBreak(FormatBatchCallCommand(m_CallCommand, m_BatchTrampoline, m_AltStackLocation, batch));
+
+	// The trampoline returned to address 0, with rsp pointing at the return values.
+	m_Profile.RecordBetween(SessionProfile::Phase::SaveContext, callStart, savedQuery.GetCompletedAt());
+	m_Profile.RecordSince(SessionProfile::Phase::Call, savedQuery.GetCompletedAt());
+	const RegisterContext context = co_await savedQuery;
+
+	// Read every return value and restore the volatile registers in a single write.
+	// Where they are is known if the alt stack was used, so they are read through the cache, after the restore, which leaves memory alone.
+	if (tableAddress)
+	{
+		const SessionProfile::Clock::time_point restoreStart = m_Profile.Now();
+		FormatRestoreCommand(m_RestoreCommand, context);
+		ExecCommand restore = Exec(m_RestoreCommand);
+		const MemoryQwords retValues = co_await ReadMemoryQwords(tableAddress + sizeof(uint64_t), batch.size());
+		co_await restore;
+		m_Profile.RecordBetween(SessionProfile::Phase::Restore, restoreStart, restore.GetCompletedAt());
+		m_Profile.RecordSince(SessionProfile::Phase::ReturnRead, restore.GetCompletedAt());
+		co_return retValues;
+	}
+
+	QwordsQuery retValuesQuery = ReadQwords("@rsp", batch.size());
+
+	const SessionProfile::Clock::time_point restoreStart = m_Profile.Now();
+	FormatRestoreCommand(m_RestoreCommand, context);
+	co_await Exec(m_RestoreCommand);
+	m_Profile.RecordBetween(SessionProfile::Phase::ReturnRead, restoreStart, retValuesQuery.GetCompletedAt());
+	m_Profile.RecordSince(SessionProfile::Phase::Restore, retValuesQuery.GetCompletedAt());
+
+	co_return co_await retValuesQuery;
+}
+
+DbgTask<MemoryQwords> CdbSession::CallThroughTrampoline(const std::span<const CallbackCall> calls)
+{
+	// While the debuggee is still stopped in the trampoline from an earlier call, the new block goes below that one, so resuming unwinds them both in turn.
+	// Otherwise it goes on the alt stack, if one has been set.
+	const bool inTrampoline = m_CallTrampolineBreak == m_CommandQueue.GetResumeCount();
+	const uint64_t stackTop = inTrampoline ? 0 : m_AltStackLocation;
+
+	// The call block is written to the stack, so whatever is cached of it is dropped.
+	const size_t blockSize = GetCallBlockSize(calls.size());
+	const uint64_t blockAddress = GetStackBelow(stackTop, blockSize + 16);
+	InvalidateWritten(blockAddress, blockSize);
+
+	const SessionProfile::Clock::time_point callStart = m_Profile.Now();
+	co_await ResumeUntilBreak(FormatTrampolineCallCommand(m_CallCommand, m_CallTrampoline, stackTop, calls));
+	m_CallTrampolineBreak = m_CommandQueue.GetResumeCount();
+	m_Profile.RecordSince(SessionProfile::Phase::Call, callStart);
+
+	// The return values follow the block's header. Where the block is, is known if the alt stack was used, so they are read through the cache.
+	const SessionProfile::Clock::time_point readStart = m_Profile.Now();
+	if (blockAddress)
+	{
+		const MemoryQwords retValues = co_await ReadMemoryQwords(blockAddress + sizeof(CallBlockHeader), calls.size());
+		m_Profile.RecordSince(SessionProfile::Phase::ReturnRead, readStart);
+		co_return retValues;
+	}
+
+	// Otherwise the trampoline broke with rsp a fixed distance below the block, so the return values are read relative to it.
+	QwordsQuery retValuesQuery = ReadQwords(std::format("@rsp+0x{:x}", CALL_TRAMPOLINE_FRAME_SIZE + sizeof(CallBlockHeader)), calls.size());
+
+	const MemoryQwords retValues = co_await retValuesQuery;
+	m_Profile.RecordSince(SessionProfile::Phase::ReturnRead, readStart);
+	co_return retValues;
+}
+
+std::string_view CdbSession::FormatCallCommand(CdbCommandBuilder& command, const uint64_t callbackAddress, const uint64_t stackTop, const std::array<uint64_t, CALLBACK_ARG_COUNT>& args)
+{
+	// Set rip to the callback address, new rsp and efl values (clearing RFLAGS.DF, the direction flag), parameter arguments, and go handled to fire the callback in the debuggee code.
+	// Also write 0 to the return address so that returning from the callback breaks back into the debugger.
+	command.Clear().Append("r rip=").AppendHex(callbackAddress).Append(";r rsp=");
+	AppendStackBelow(command, stackTop, CALL_FRAME_OFFSET);
+	command.Append(";r efl=@efl&0xfffffbff;r rcx=").AppendHex(args[0]).Append(";r rdx=").AppendHex(args[1]).Append(";r r8=").AppendHex(args[2]).Append(";eq @rsp 0;gh");
+	return command.GetText();
+}
+
+std::string_view CdbSession::FormatBatchCallCommand(CdbCommandBuilder& command, const uint64_t trampolineAddress, const uint64_t stackTop, const std::span<const CallbackCall> calls)
+{
+	const size_t tableSize = GetBatchTableSize(calls.size());
+
+	command.Clear().Append("r rsp=");
+	AppendStackBelow(command, stackTop, tableSize + 8);
+	command.Append(";eq @rsp 0");
+	for (size_t i = 0; i < calls.size(); ++i)
+	{
+		command.Append(" 0");
+	}
+	for (const CallbackCall& call : calls)
+	{
+		command.Append(" ").AppendHex(call.Address).Append(" ").AppendHex(call.Args[0]).Append(" ").AppendHex(call.Args[1]).Append(" ").AppendHex(call.Args[2]);
+	}
+
+	// Clear RFLAGS.DF, the direction flag, as each callback expects, and go handled to run the trampoline.
+	command.Append(";r rcx=@rsp+8;r rdx=@rsp+").AppendHex(8 + calls.size() * 8).Append(";r r8=").AppendHex(calls.size())
+		.Append(";r rip=").AppendHex(trampolineAddress).Append(";r efl=@efl&0xfffffbff;gh");
+	return command.GetText();
+}
+
+std::string CdbSession::FormatBatchTrampolineWrite(const uint64_t address)
+{
+	std::string command = std::format("eb 0x{:x}", address);
+	for (const uint8_t byte : BATCH_TRAMPOLINE)
+	{
+		std::format_to(std::back_inserter(command), " 0x{:x}", byte);
+	}
+	return command;
+}
+
+std::string_view CdbSession::FormatTrampolineCallCommand(CdbCommandBuilder& command, const uint64_t trampolineAddress, const uint64_t stackTop, const std::span<const CallbackCall> calls)
+{
+	// The block is kept 16 bytes clear of stackTop, as the trampoline returns by pushing the return address onto the stack it returns to.
+	const size_t blockSize = GetCallBlockSize(calls.size());
+
+	// A break on an int 3 leaves rip on it, and CDB only steps over it when resuming from the break itself, so the trampoline has to return past it.
+	// Both return registers are written by CDB as they are now, before rsp is changed.
+	command.Clear().Append("eq ");
+	AppendStackBelow(command, stackTop, blockSize + 16);
+	command.Append(" @rip+(by(@rip)==0xcc) @rsp ").AppendHex(calls.size());
+	for (size_t i = 0; i < calls.size(); ++i)
+	{
+		command.Append(" 0");
+	}
+	for (const CallbackCall& call : calls)
+	{
+		command.Append(" ").AppendHex(call.Address).Append(" ").AppendHex(call.Args[0]).Append(" ").AppendHex(call.Args[1]).Append(" ").AppendHex(call.Args[2]);
+	}
+
+	command.Append(";r rsp=");
+	AppendStackBelow(command, stackTop, blockSize + 16);
+	command.Append(";r rip=").AppendHex(trampolineAddress).Append(";gh");
+	return command.GetText();
+}
+
+std::string_view CdbSession::FormatRestoreCommand(CdbCommandBuilder& command, const RegisterContext& context)
+{
+	// We need to restore the volatile registers. This may seem counterintuitive, but our callback function will naturally restore the nonvolatile registers
+	// and since we only simulated a function call, we have to restore the volatile ones manually to keep expected behavior where we were previously, in mid-function.
+	command.Clear().Append("r rsp=").AppendHex(context.Rsp).Append(";r rip=").AppendHex(context.Rip).Append(";r efl=").AppendHex(context.ContextFlags)
+		.Append(";r rcx=").AppendHex(context.Rcx).Append(";r rdx=").AppendHex(context.Rdx).Append(";r r8=").AppendHex(context.R8).Append(";r r9=").AppendHex(context.R9)
+		.Append(";r r10=").AppendHex(context.R10).Append(";r r11=").AppendHex(context.R11);
+
+	// XMM values must be specified when assigning with the r command in __int64 form. They are written low to high, despite being retrieved high to low.
+	// Only xmm0-xmm5 are volatile.
+	static constexpr std::string_view XMM_ASSIGNMENTS[] = { ";r xmm0=", ";r xmm1=", ";r xmm2=", ";r xmm3=", ";r xmm4=", ";r xmm5=" };
+	for (size_t i = 0; i < std::size(XMM_ASSIGNMENTS); ++i)
+	{
+		command.Append(XMM_ASSIGNMENTS[i]).AppendDecimal(context.Xmms[i].Low).Append(" ").AppendDecimal(context.Xmms[i].High);
+	}
+
+	command.Append(";r rax=").AppendHex(context.Rax);
+	return command.GetText();
+}
+
+void CdbSession::LogMessage(const char* const message)
+{
+	m_Log.Write("DebugHandler: ");
+	m_Log.Write(message);
+}
\ No newline at end of file
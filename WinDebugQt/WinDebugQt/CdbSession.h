@@ -0,0 +1,372 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "CallbackRegistry.h"
+#include "CdbCommandQueue.h"
+#include "CdbCommands.h"
+#include "DbgCmdSites.h"
+#include "DbgCmds.h"
+#include "DbgTask.h"
+#include "DebuggeeMemoryCache.h"
+#include "EventFilters.h"
+#include "FramePool.h"
+#include "FrameQueue.h"
+#include "ICdbTransport.h"
+#include "LogRing.h"
+#include "OutputTokenizer.h"
+#include "RegisterContext.h"
+#include "SessionProfile.h"
+#include "SessionTrace.h"
+#include "TelemetryChannel.h"
+
+/*
+* Everything a session does with CDB once it is talking to it: framing CDB's output, handling each frame, and the handlers that drive the debuggee.
+* Nothing here depends on how CDB is reached, so a session can be run against CDB itself by DebugSession, or against a recorded trace by TraceReplay.
+* Frames are queued through QueueFrames by whichever thread receives CDB's output, and handled through DrainFrames on the thread that owns the session.
+*/
+class CdbSession
+{
+public:
+	// The session's log is capped at logMemoryCap, past which logPolicy decides what is dropped.
+	CdbSession(ICdbTransport& transport, const size_t logMemoryCap, const LogRing::OverflowPolicy logPolicy)
+		: m_Transport(transport),
+		m_Log(logMemoryCap, logPolicy)
+	{
+	}
+
+	CdbSession(const CdbSession&) = delete;
+	CdbSession& operator=(const CdbSession&) = delete;
+	virtual ~CdbSession();
+
+	// Starts handling frames, once the transport is connected to CDB.
+	void Begin() { m_Running = true; }
+
+	// Stops handling frames. Called by the session itself once the debuggee exits.
+	virtual void Stop() { Reset(); }
+
+	bool IsRunning() const { return m_Running; }
+
+	// Records everything read from and written to CDB to a trace at path, so the session can be replayed later. Has to be called before the session starts.
+	// The dumps the session reads and where it has them written are recorded along with it.
+	bool StartTrace(const std::filesystem::path& path);
+
+	/*
+	* Has memory dumped to files starting with prefix, rather than to the temp directory under a name made from the process and session numbers.
+	* A replay is given the prefix its trace was recorded with. Has to be called before StartTrace, and before the session starts.
+	*/
+	void SetDumpFilePrefix(std::filesystem::path prefix) { m_DumpFilePrefix = std::move(prefix); }
+
+	// Everything read from and written to CDB, along with the session's own messages. Written on the thread that drains frames, and read by the presenter.
+	LogRing& GetLog() { return m_Log; }
+
+	/*
+	* Called by the thread receiving CDB's output once received has arrived through the transport, to record it and queue up each frame of it.
+	* Returns true if frames were queued where there were none before, in which case DrainFrames must be called to handle them.
+	*/
+	bool QueueFrames(const std::string_view received);
+
+	// Handles all of the frames queued by QueueFrames.
+	void DrainFrames();
+
+	// The pool the frames of the handler coroutines are allocated from.
+	FramePool& GetFramePool() { return m_FramePool; }
+
+	// How long the session spends handling each debug command and each phase of it. Measuring is off until SetProfiling turns it on.
+	SessionProfile& GetProfile() { return m_Profile; }
+
+	// Turns measuring into GetProfile on or off. Only to be called on the thread that drains frames.
+	void SetProfiling(const bool enabled);
+
+	// Called on the draining thread once each debug command has been handled, with its opcode and the time from its break being queued to its handler finishing.
+	using DbgCmdObserver = std::function<void(const uint8_t opCode, const std::chrono::nanoseconds latency)>;
+	void SetDbgCmdObserver(DbgCmdObserver observer) { m_DbgCmdObserver = std::move(observer); }
+
+	// Has CDB deal with the debuggee's exceptions itself, rather than stopping it for the session to handle each one.
+	// Has to be called before the session starts. Returns false if the policies cannot all be applied.
+	bool SetEventPolicies(std::vector<EventPolicy> policies) { return m_EventFilters.SetPolicies(std::move(policies)); }
+
+	// The event policies, and what they have counted as of the last break. Only to be read on the thread that drains frames.
+	const EventFilters& GetEventFilters() const { return m_EventFilters; }
+
+	// How well the debuggee memory read by handlers has been served from the cache. Only to be read on the thread that drains frames.
+	const DebuggeeMemoryCache::Stats& GetMemoryCacheStats() const { return m_MemoryCache.GetStats(); }
+
+	// Registers consumer to be handed every telemetry record the debuggee flushes, on the thread that drains frames. Has to be called before the session starts.
+	void AddTelemetryConsumer(TelemetryChannel::Consumer consumer) { m_Telemetry.AddConsumer(std::move(consumer)); }
+
+	// How much telemetry the debuggee has flushed. Only to be read on the thread that drains frames.
+	const TelemetryChannel::Stats& GetTelemetryStats() const { return m_Telemetry.GetStats(); }
+
+	static constexpr size_t CALLBACK_ARG_COUNT = 3;
+
+	/*
+	* The commands below are built into command, replacing whatever was built there before, and their text is returned.
+	* Each lays out the stack below stackTop, or below where rsp is now if stackTop is 0.
+	*/
+
+	// The command that sends the debuggee into the callback at callbackAddress with args, and lets it run.
+	static std::string_view FormatCallCommand(CdbCommandBuilder& command, const uint64_t callbackAddress, const uint64_t stackTop, const std::array<uint64_t, CALLBACK_ARG_COUNT>& args);
+
+	// The command that puts back the volatile registers saved in context once a callback has returned.
+	static std::string_view FormatRestoreCommand(CdbCommandBuilder& command, const RegisterContext& context);
+
+	// One callback fired as part of a batch, with up to three integer arguments.
+	struct CallbackCall
+	{
+		uint64_t Address = 0;
+		std::array<uint64_t, CALLBACK_ARG_COUNT> Args = {};
+	};
+
+	// The most callbacks one batch can fire, as their return values are read back with a single dq.
+	static constexpr size_t MAX_BATCH_CALLS = MemoryQwords::CAPACITY;
+
+	/*
+	* The command that lays out calls for the batch trampoline at trampolineAddress, and lets the debuggee run it.
+	* From the top down: a slot for each return value, each call's address and arguments, and a return address of 0 which the trampoline's rsp points at.
+	* So once the trampoline returns and faults, the return values start at rsp.
+	*/
+	static std::string_view FormatBatchCallCommand(CdbCommandBuilder& command, const uint64_t trampolineAddress, const uint64_t stackTop, const std::span<const CallbackCall> calls);
+
+	// The command that writes the batch trampoline's code to address. Only sent once, so it is not built into a reused buffer.
+	static std::string FormatBatchTrampolineWrite(const uint64_t address);
+
+	// The command that lays out calls in a call block, and sends the debuggee into its call trampoline at trampolineAddress.
+	static std::string_view FormatTrampolineCallCommand(CdbCommandBuilder& command, const uint64_t trampolineAddress, const uint64_t stackTop, const std::span<const CallbackCall> calls);
+
+protected:
+	// Resets everything known about CDB and the debuggee. Frames still queued are dropped.
+	void Reset();
+
+private:
+	// Handles one frame of CDB output, either a full line or a prompt.
+	void HandleFrame(const std::string_view out, const int frameType);
+
+	// Handles the break CDB attaches with, by setting up the event filters and scanning the modules already loaded before resuming.
+	DbgTask<> HandleAttach();
+
+	// Once the cdb debugger detects a prompt that nothing was waiting for, it is handled here. breakAddress is where CDB said it broke, or 0 if it did not say.
+	DbgTask<> HandlePrompt(const uint64_t breakAddress);
+
+	// Dumps each module CDB has announced since the last scan to a file with .writemem, all in one write, and scans them for debug commands.
+	DbgTask<> ScanModules();
+
+	// What the files memory is dumped to with .writemem start with. Unless it has been set, it is made up in the temp directory the first time it is asked for.
+	const std::filesystem::path& GetDumpFilePrefix();
+
+	// Reads a dump CDB has written through the transport, and records what was read to the trace.
+	bool ReadDump(const std::filesystem::path& path, std::vector<uint8_t>& image);
+
+	// Removes the file telemetry is dumped to, if there has been a flush.
+	void RemoveTelemetryFile();
+
+	// Writes to the stdin pipe of the process being debugged.
+	void WriteToCdbProc(const std::string_view string);
+
+	// Called when CDB aborts a command. Cancels the handler that was waiting on it.
+	void HandleCommandFailure(const CdbCommand& command);
+
+	// Handles a debugger command coming from the debuggee application, through a table of the handlers below indexed by opCode.
+	DbgTask<> HandleDbgCmd(const uint8_t opCode);
+
+	// Handles an opcode that is not in DBG_CMD_LIST, by carrying on.
+	DbgTask<> HandleUnknownDbgCmd(const uint8_t opCode);
+
+	// Handles the command that does nothing but break.
+	DbgTask<> HandleDbgCmdNop();
+
+	// Handles the command to set the callbacks in the debuggee code that can be called.
+	DbgTask<> HandleDbgCmdSetCallbacks();
+
+	// One of the callbacks in DBG_CALLBACK_LIST, if the debuggee has registered it with the signature in id. Logs an error otherwise.
+	const CallbackRegistryEntry* FindCallback(const CallbackId& id);
+
+	// Handles the command to set the alt stack location in the debuggee code that can be used as the new stack location when firing debuggee callbacks.
+	DbgTask<> HandleDbgCmdRegisterAltStack();
+
+	// Handles the command to set the location of the debuggee's call trampoline, which callbacks are fired through from then on.
+	DbgTask<> HandleDbgCmdRegisterCallTrampoline();
+
+	// Handles the command to take the telemetry records the debuggee has batched up, which are dumped in binary and handed on to the consumers.
+	DbgTask<> HandleDbgCmdFlushTelemetry();
+
+	/*
+	* These are what handlers co_await to talk to CDB. Each submits its command when it is created, and awaiting one sends it along
+	* with everything submitted before it, so a handler can create several and then await them to get them all in one write.
+	*/
+
+	// Reads all of the registers saved and restored around a callback.
+	RegistersQuery Regs() { return RegistersQuery(m_CommandQueue); }
+
+	// Reads a single register.
+	RegisterQuery ReadRegister(const std::string_view registerName) { return RegisterQuery(m_CommandQueue, registerName); }
+
+	// Reads count qwords from address, which may be any CDB expression.
+	QwordsQuery ReadQwords(const std::string_view address, const size_t count) { return QwordsQuery(m_CommandQueue, address, count); }
+
+	// Reads count bytes from address, which may be any CDB expression.
+	BytesQuery ReadBytes(const std::string_view address, const size_t count) { return BytesQuery(m_CommandQueue, address, count); }
+
+	// Reads count bytes from a known address through the memory cache, which only asks CDB for them if they have not been read since the debuggee last ran.
+	// Unlike the queries, nothing is sent until it is awaited, when every read that missed since the last one is fetched together.
+	CachedMemoryRead ReadMemory(const uint64_t address, const size_t count) { return m_MemoryCache.Read(address, count); }
+
+	// Reads count qwords from a known address through the memory cache, like ReadMemory, however many reads they take. count is capped at MemoryQwords::CAPACITY.
+	DbgTask<MemoryQwords> ReadMemoryQwords(const uint64_t address, const size_t count);
+
+	// Drops whatever the memory cache holds of count bytes about to be written at address. If address is 0, as CDB is working it out, everything is dropped.
+	void InvalidateWritten(const uint64_t address, const size_t count);
+
+	// Runs a command for its side effects.
+	ExecCommand Exec(std::string command) { return ExecCommand(m_CommandQueue, std::move(command)); }
+
+	// Runs the command built in command for its side effects. The command's text is borrowed, so it must not be rebuilt until the command completes.
+	ExecCommand Exec(const CdbCommandBuilder& command) { return ExecCommand(m_CommandQueue, command); }
+
+	// Lets the debuggee run with resumeCommand and waits for it to break again. resumeCommand must stay valid until this is awaited.
+	BreakAwaiter ResumeUntilBreak(const std::string_view resumeCommand) { return BreakAwaiter(m_CommandQueue, resumeCommand); }
+
+	// Fires one of the callbacks the debuggee application has registered to be callable, with up to three integer arguments, and gives back its return value.
+	template <typename... Args>
+	DbgTask<uint64_t> Call(const uint64_t callbackAddress, const Args... args)
+	{
+		static_assert(sizeof...(Args) <= CALLBACK_ARG_COUNT, "Callbacks take at most three arguments.");
+		return CallWithArgs(callbackAddress, { (uint64_t)args... });
+	}
+
+	// Implements Call.
+	DbgTask<uint64_t> CallWithArgs(const uint64_t callbackAddress, const std::array<uint64_t, CALLBACK_ARG_COUNT> args);
+
+	/*
+	* Fires each of calls in turn within a single stop, and gives back their return values in order. The registers are saved and restored once
+	* for the whole batch, while the debuggee runs the calls back to back through a trampoline, so the cost of a call is mostly paid once per batch.
+	* Fires at most MAX_BATCH_CALLS calls. Gives back nothing if the trampoline could not be put in the debuggee.
+	*/
+	DbgTask<MemoryQwords> CallBatch(const std::span<const CallbackCall> calls);
+
+	/*
+	* Implements Call and CallBatch once the debuggee has registered its call trampoline, which saves and restores the registers itself.
+	* Only rsp and rip are set to send the debuggee in, and the return values are read from the call block once it breaks.
+	* The debuggee is left stopped in the trampoline until the handler resumes it, which is when the trampoline returns to where it was.
+	*/
+	DbgTask<MemoryQwords> CallThroughTrampoline(const std::span<const CallbackCall> calls);
+
+	// Preps a DebugHandler message to be stored in m_Log for later log retrieval.
+	void LogMessage(const char* const message);
+
+	// Formats a message into N chars on the stack and logs it, so logging as the debuggee runs does not allocate. A longer message is formatted on the heap instead.
+	template <size_t N, typename... Args>
+	void LogFormatted(const std::format_string<Args...> format, Args&&... args)
+	{
+		char message[N];
+		const std::format_to_n_result<char*> formatted = std::format_to_n(message, N - 1, format, std::forward<Args>(args)...);
+		if ((size_t)formatted.size < N)
+		{
+			*formatted.out = '\0';
+			LogMessage(message);
+		}
+		else
+		{
+			LogMessage(std::vformat(format.get(), std::make_format_args(args...)).c_str());
+		}
+	}
+
+	// What the session talks to CDB through.
+	ICdbTransport& m_Transport;
+
+	// Frames the output from m_Transport into lines and prompts. Keeps its scan state between reads. Only used by the thread queueing frames.
+	OutputTokenizer m_CdbTokenizer;
+
+	// Frames read by the worker threads waiting to be handled on the Qt thread.
+	FrameQueue m_FrameQueue;
+
+	// The frames currently being handled by DrainFrames. Kept around so its buffers are reused.
+	FrameQueue::Batch m_DrainBatch;
+
+	// Stores the output data that has not yet been retrieved through GetLog. The Qt thread is its only producer, so writing to it never blocks.
+	// With the Backpressure policy, whatever does not fit is dropped, as nothing here can hold CDB's output back.
+	LogRing m_Log;
+
+	// Coroutine frames of the handlers. Once each handler has run, they are reused rather than allocated.
+	FramePool m_FramePool;
+
+	// Sends commands to CDB and routes their output back to whatever is waiting on them.
+	CdbCommandQueue m_CommandQueue{ [this](const std::string_view text) { WriteToCdbProc(text); },
+		[this](const CdbCommand& command) { HandleCommandFailure(command); } };
+
+	// Debuggee memory read while it is stopped. Declared after m_CommandQueue, which its fetches are submitted to.
+	DebuggeeMemoryCache m_MemoryCache{ m_CommandQueue };
+
+	// The event policies, set up in CDB when the session attaches. Declared after m_CommandQueue, which their counters are read through.
+	EventFilters m_EventFilters;
+
+	// The handler for the current break. Replacing it destroys the previous one's frames, and cancels anything it was still waiting on.
+	DbgTask<> m_ActiveHandler;
+
+	// Whether the session is running. Frames that arrive after it stops are dropped.
+	bool m_Running = false;
+
+	DbgCmdObserver m_DbgCmdObserver;
+
+	SessionProfile m_Profile;
+
+	// When the last write to CDB went out, if it was being measured.
+	SessionProfile::Clock::time_point m_LastWriteAt;
+
+	// Records the session's traffic with CDB, if StartTrace was called.
+	std::unique_ptr<TraceRecorder> m_Trace;
+
+	// Used to scan the debuggee's modules on the first CDB prompt that comes through on connection, before resuming the program.
+	bool m_FirstPrompt = true;
+
+	// Where each debug command in the debuggee's modules is, so breaks on them are dispatched from rip without reading the code there.
+	DbgCmdSites m_DbgCmdSites;
+
+	// The address of the instruction CDB printed since the last prompt, which is where the next break is, or 0.
+	uint64_t m_BreakAddress = 0;
+
+	// Memory is dumped to files starting with this. Unique to the session, so several can dump at once.
+	std::filesystem::path m_DumpFilePrefix;
+
+	// The image of the module being scanned. Kept around so its capacity is reused.
+	std::vector<uint8_t> m_ScanImage;
+
+	// Hands on the telemetry the debuggee flushes. Each flush is dumped to m_TelemetryFile with m_TelemetryDumpCommand, which is only built once,
+	// and read back into m_TelemetryImage, which is kept around so its capacity is reused.
+	TelemetryChannel m_Telemetry;
+	std::filesystem::path m_TelemetryFile;
+	CdbCommandBuilder m_TelemetryDumpCommand;
+	std::vector<uint8_t> m_TelemetryImage;
+
+	// Used as the new stack location when firing debuggee callbacks. Prevents callback failures when processing stack overflow exceptions.
+	uint64_t m_AltStackLocation = 0;
+
+	// The debuggee's callbacks, once it has registered them, and the registry they were loaded from. Kept around so their capacity is reused.
+	CallbackRegistry m_Callbacks;
+	std::vector<uint64_t> m_RegistryQwords;
+
+	// Where CallBatch put its trampoline in the debuggee, once it has.
+	uint64_t m_BatchTrampoline = 0;
+
+	// Where the debuggee's own call trampoline is, once it has registered it.
+	uint64_t m_CallTrampoline = 0;
+
+	// The resume count when the debuggee last broke in its call trampoline. While it is still the same, the debuggee is stopped in there.
+	std::optional<uint32_t> m_CallTrampolineBreak;
+
+	// Callbacks are fired and the registers restored with commands built into these every time, so once they have grown, firing callbacks does not allocate.
+	// A call is copied into the queue as it resumes the debuggee, so m_CallCommand can be rebuilt straight away. Only one restore is ever in flight.
+	CdbCommandBuilder m_CallCommand;
+	CdbCommandBuilder m_RestoreCommand;
+};
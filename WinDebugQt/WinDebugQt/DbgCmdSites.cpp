@@ -0,0 +1,176 @@
+#include "DbgCmdSites.h"
+
+#include <algorithm>
+#include <bit>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define DBG_CMD_SCAN_SSE2
+#endif
+
+#include "DbgCmds.h"
+#include "RegisterContext.h"
+
+bool DbgCmdSites::AddModule(const std::string_view line)
+{
+	static constexpr std::string_view MOD_LOAD = "ModLoad: ";
+	if (line.substr(0, MOD_LOAD.size()) != MOD_LOAD)
+	{
+		return false;
+	}
+
+	Module module;
+	const std::string_view range = line.substr(MOD_LOAD.size());
+	const size_t baseLength = RegisterContextParser::ParseHex(range, module.Base);
+	if (!baseLength || range.substr(baseLength, 1) != " " || !RegisterContextParser::ParseHex(range.substr(baseLength + 1), module.End) || module.End <= module.Base)
+	{
+		return false;
+	}
+
+	// A module loaded where another used to be replaces it.
+	for (size_t i = 0; i < m_Modules.size();)
+	{
+		const ModuleEntry& entry = m_Modules[i];
+		if (entry.Range.Base < module.End && module.Base < entry.Range.End)
+		{
+			m_PendingCount -= entry.State == ModuleState::Pending;
+			m_ScannedCount -= entry.State == ModuleState::Scanned;
+			RemoveSites(entry.Range.Base, entry.Range.End);
+			m_Modules.erase(m_Modules.begin() + i);
+		}
+		else
+		{
+			++i;
+		}
+	}
+
+	m_Modules.push_back({ module, ModuleState::Pending });
+	++m_PendingCount;
+	return true;
+}
+
+void DbgCmdSites::TakePendingModules(std::vector<Module>& outModules)
+{
+	for (ModuleEntry& entry : m_Modules)
+	{
+		if (entry.State == ModuleState::Pending)
+		{
+			entry.State = ModuleState::Scanning;
+			outModules.push_back(entry.Range);
+		}
+	}
+	m_PendingCount = 0;
+}
+
+void DbgCmdSites::AddScan(const Module& module, const uint8_t* const image, const size_t size)
+{
+	const auto entry = std::find_if(m_Modules.begin(), m_Modules.end(), [&](const ModuleEntry& candidate)
+	{
+		return candidate.Range.Base == module.Base && candidate.State == ModuleState::Scanning;
+	});
+	if (entry == m_Modules.end())
+	{
+		return;
+	}
+
+	const size_t firstNew = m_Sites.size();
+	Scan(image, size < module.End - module.Base ? size : (size_t)(module.End - module.Base), module.Base, m_Sites);
+	std::inplace_merge(m_Sites.begin(), m_Sites.begin() + firstNew, m_Sites.end(), [](const Site& a, const Site& b) { return a.Address < b.Address; });
+
+	entry->State = ModuleState::Scanned;
+	++m_ScannedCount;
+}
+
+size_t DbgCmdSites::AbandonScans()
+{
+	size_t abandoned = 0;
+	for (ModuleEntry& entry : m_Modules)
+	{
+		if (entry.State == ModuleState::Scanning)
+		{
+			entry.State = ModuleState::Abandoned;
+			++abandoned;
+		}
+	}
+	return abandoned;
+}
+
+bool DbgCmdSites::Find(const uint64_t address, uint8_t& opCode) const
+{
+	const auto site = std::lower_bound(m_Sites.begin(), m_Sites.end(), address, [](const Site& candidate, const uint64_t value) { return candidate.Address < value; });
+	if (site == m_Sites.end() || site->Address != address)
+	{
+		return false;
+	}
+
+	opCode = site->OpCode;
+	return true;
+}
+
+void DbgCmdSites::Reset()
+{
+	m_Modules.clear();
+	m_Sites.clear();
+	m_PendingCount = 0;
+	m_ScannedCount = 0;
+}
+
+void DbgCmdSites::RemoveSites(const uint64_t base, const uint64_t end)
+{
+	const auto first = std::lower_bound(m_Sites.begin(), m_Sites.end(), base, [](const Site& candidate, const uint64_t value) { return candidate.Address < value; });
+	const auto last = std::lower_bound(first, m_Sites.end(), end, [](const Site& candidate, const uint64_t value) { return candidate.Address < value; });
+	m_Sites.erase(first, last);
+}
+
+void DbgCmdSites::Scan(const uint8_t* const code, const size_t size, const uint64_t base, std::vector<Site>& outSites)
+{
+	if (size < DBG_CMD_SIGNATURE_SIZE)
+	{
+		return;
+	}
+
+	const size_t lastStart = size - DBG_CMD_SIGNATURE_SIZE;
+	size_t start = 0;
+
+#ifdef DBG_CMD_SCAN_SSE2
+	// Each of the sixteen starts in a block is a candidate if its int 3, jmp and both Ds are where they should be.
+	// The loads reach up to six bytes past the block, which the signature needs to be there anyway.
+	const __m128i int3 = _mm_set1_epi8((char)0xcc);
+	const __m128i jmp = _mm_set1_epi8((char)0xeb);
+	const __m128i d = _mm_set1_epi8('D');
+	for (; start + 16 + 6 <= size; start += 16)
+	{
+		const uint8_t* const block = code + start;
+		uint32_t candidates = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)block), int3));
+		if (!candidates)
+		{
+			continue;
+		}
+
+		candidates &= (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(block + 1)), jmp));
+		candidates &= (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(block + 3)), d));
+		candidates &= (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(block + 6)), d));
+		while (candidates)
+		{
+			const size_t bit = (size_t)std::countr_zero(candidates);
+			candidates &= candidates - 1;
+
+			uint8_t opCode;
+			if (start + bit <= lastStart && ParseDbgCmdSignature(block + bit, opCode))
+			{
+				outSites.push_back({ base + start + bit, opCode });
+			}
+		}
+	}
+#endif
+
+	// Whatever is left over, or all of it without SSE2, is checked a byte at a time.
+	for (; start <= lastStart; ++start)
+	{
+		uint8_t opCode;
+		if (code[start] == 0xcc && ParseDbgCmdSignature(code + start, opCode))
+		{
+			outSites.push_back({ base + start, opCode });
+		}
+	}
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+/*
+* Where the debug commands are in the debuggee's code, so a break can be told apart from any other without reading the code at rip.
+* Modules are added as CDB announces them with ModLoad lines, and each one's image is scanned for debug command signatures once it has been dumped.
+* Lookups can only be trusted to find every debug command once every module has been scanned; until then, IsComplete is false.
+*/
+class DbgCmdSites
+	final
+{
+public:
+	struct Module
+	{
+		uint64_t Base = 0;
+		uint64_t End = 0;
+	};
+
+	struct Site
+	{
+		uint64_t Address = 0;
+		uint8_t OpCode = 0;
+	};
+
+	// Adds the module a CDB ModLoad line announces, to be scanned. Returns false if line is not a ModLoad line.
+	//Example ModLoad line:
+	//ModLoad: 00007ff6`6ce70000 00007ff6`6ce95000   C:\WinDebugQt\DummyProgram.exe
+	bool AddModule(const std::string_view line);
+
+	bool HasPendingModules() const { return m_PendingCount != 0; }
+
+	// Moves the modules waiting to be scanned into outModules. Until each is passed to AddScan, the sites are incomplete.
+	void TakePendingModules(std::vector<Module>& outModules);
+
+	// Adds the debug commands found in the image of module, which was dumped to image.
+	void AddScan(const Module& module, const uint8_t* const image, const size_t size);
+
+	// Gives up on the modules taken but not yet passed to AddScan, whose dumps failed. They are not retried, so the sites stay incomplete. Returns how many there were.
+	size_t AbandonScans();
+
+	// Gets the opcode of the debug command at address, if there is one there.
+	bool Find(const uint64_t address, uint8_t& opCode) const;
+
+	// Whether every module announced so far has been scanned, so an address Find does not know is not a debug command.
+	bool IsComplete() const { return !m_Modules.empty() && m_ScannedCount == m_Modules.size(); }
+
+	// The number of debug commands found so far.
+	size_t GetSiteCount() const { return m_Sites.size(); }
+
+	void Reset();
+
+	/*
+	* Finds every debug command signature in size bytes of code loaded at base, and appends each one's address and opcode to outSites.
+	* Candidates are picked out sixteen bytes at a time with SSE2 where it is available, and only those are checked in full.
+	*/
+	static void Scan(const uint8_t* const code, const size_t size, const uint64_t base, std::vector<Site>& outSites);
+
+private:
+	enum class ModuleState
+	{
+		Pending,
+		Scanning,
+		Scanned,
+		Abandoned,
+	};
+
+	struct ModuleEntry
+	{
+		Module Range;
+		ModuleState State = ModuleState::Pending;
+	};
+
+	// Drops the sites in [base, end), for a module loaded over one that was unloaded.
+	void RemoveSites(const uint64_t base, const uint64_t end);
+
+	std::vector<ModuleEntry> m_Modules;
+	size_t m_PendingCount = 0;
+	size_t m_ScannedCount = 0;
+
+	// Sorted by address.
+	std::vector<Site> m_Sites;
+};
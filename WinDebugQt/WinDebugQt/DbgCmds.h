@@ -0,0 +1,281 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <string_view>
+#include <type_traits>
+
+/*
+* The protocol between this debugger and the debuggee. DummyProgram.cpp in DummyProgram.sln includes this too, so both sides are built from the one description.
+* WinDebugQt.sln builds DummyProgram before WinDebugQt, into the same directory, so the debuggee it launches always matches this header.
+* Anything the assembly in DebuggerCmds.asm (and DebuggerCmds.S) depends on is pinned down with a static_assert, since that cannot include it.
+*/
+
+/*
+* These are debug commands that the debuggee program can send to this debugger, as X(name, opCode, parameters).
+* The DbgCmd opcodes, the debuggee's debuggerCmd stubs, the handler dispatch tables and the names in profiles are all generated from this list.
+* Opcodes index the dispatch tables, so they have to count up from 0.
+*/
+#define DBG_CMD_LIST(X) \
+	X(Nop, 0, (void)) \
+	X(SetCallbacks, 1, (void* registry, unsigned count)) \
+	X(RegisterAltStack, 2, (void* address)) \
+	X(RegisterCallTrampoline, 3, (void* address)) \
+	X(FlushTelemetry, 4, (const void* records, size_t size))
+
+#define DBG_CMD_ENUMERATOR(name, opCode, parameters) debuggerCmd##name = opCode,
+enum DbgCmd {
+	DBG_CMD_LIST(DBG_CMD_ENUMERATOR)
+};
+#undef DBG_CMD_ENUMERATOR
+
+#define DBG_CMD_NAME(name, opCode, parameters) #name,
+constexpr std::string_view DBG_CMD_NAMES[] = { DBG_CMD_LIST(DBG_CMD_NAME) };
+#undef DBG_CMD_NAME
+
+static const size_t DBG_CMD_COUNT = std::size(DBG_CMD_NAMES);
+
+constexpr bool AreDbgCmdOpCodesDense()
+{
+	size_t next = 0;
+#define DBG_CMD_CHECK_OPCODE(name, opCode, parameters) if (opCode != next++) { return false; }
+	DBG_CMD_LIST(DBG_CMD_CHECK_OPCODE)
+#undef DBG_CMD_CHECK_OPCODE
+	return true;
+}
+static_assert(AreDbgCmdOpCodesDense(), "Debug command opcodes have to count up from 0, as they index the dispatch tables.");
+
+// The layout of the callback registry below. A registry of any other version is refused rather than misread.
+static const uint32_t CALLBACK_REGISTRY_VERSION = 1;
+
+// The most callbacks a registry may hold. A registry claiming more is refused rather than read, so a bad count cannot make the debugger read gigabytes.
+static const uint32_t MAX_CALLBACKS = 1024;
+
+/*
+* The functions in the debuggee that we can call from a debug handler, which it registers with debuggerCmdSetCallbacks:
+* this header followed by Count entries, read in one go. Callbacks are found by the hash of their name rather than by where they are
+* in the table, so the debuggee can register whichever of them it has, in any order.
+* Ensure these match up with the registry in DummyProgram.cpp.
+*/
+struct CallbackRegistryHeader
+{
+	uint32_t Version = 0;
+	uint32_t Count = 0;
+};
+
+struct CallbackRegistryEntry
+{
+	uint64_t NameHash = 0; // HashCallbackName of the callback's name. Never 0.
+	uint64_t Signature = 0; // MakeCallbackSignature of how it is called.
+	uint64_t Address = 0;
+};
+
+// Both are read from the debuggee as qwords.
+static_assert(sizeof(CallbackRegistryHeader) == 8 && sizeof(CallbackRegistryEntry) == 24, "The callback registry is laid out in qwords.");
+
+// Hashes a callback's name for its registry entry, with 64 bit FNV-1a.
+constexpr uint64_t HashCallbackName(const std::string_view name)
+{
+	uint64_t hash = 0xcbf29ce484222325;
+	for (const char c : name)
+	{
+		hash = (hash ^ (uint8_t)c) * 0x100000001b3;
+	}
+	return hash;
+}
+
+// Set in a callback's signature if it returns a value. The low byte is the number of integer arguments it takes.
+static const uint64_t CALLBACK_RETURNS_VALUE = 0x100;
+
+constexpr uint64_t MakeCallbackSignature(const uint64_t argCount, const bool returnsValue)
+{
+	return argCount | (returnsValue ? CALLBACK_RETURNS_VALUE : 0);
+}
+
+// The signature of a callback function, to check it against the one it is registered under.
+template <typename Return, typename... Args>
+constexpr uint64_t GetCallbackSignature(Return (*)(Args...))
+{
+	return MakeCallbackSignature(sizeof...(Args), !std::is_void_v<Return>);
+}
+
+// What a callback is registered under.
+struct CallbackId
+{
+	uint64_t NameHash = 0;
+	uint64_t Signature = 0;
+};
+
+/*
+* The callbacks the debug handlers fire, as X(name, argCount, returnsValue). The debuggee registers a function of each name,
+* and DummyProgram.cpp checks each one against its signature here, so a callback that changes fails to build rather than being misfired.
+*/
+#define DBG_CALLBACK_LIST(X) \
+	X(PrintAAA, 0, false) \
+	X(ReturnDoubleTheInput, 1, true)
+
+struct DbgCallbacks
+{
+#define DBG_CALLBACK_ID(name, argCount, returnsValue) static constexpr CallbackId name = { HashCallbackName(#name), MakeCallbackSignature(argCount, returnsValue) };
+	DBG_CALLBACK_LIST(DBG_CALLBACK_ID)
+#undef DBG_CALLBACK_ID
+};
+
+/*
+* The block of calls the debugger lays out on the stack for debuggerCallTrampoline in DebuggerCmds.asm, which is sent into with rsp pointing at it.
+* The header is followed by Count return value slots, which the trampoline fills in, and then Count CallBlockCalls.
+* Ensure this matches up with the offsets the trampoline uses.
+*/
+struct CallBlockHeader
+{
+	uint64_t ReturnRip = 0; // Where the trampoline returns to once it is resumed after breaking.
+	uint64_t ReturnRsp = 0;
+	uint64_t Count = 0;
+};
+
+struct CallBlockCall
+{
+	uint64_t Address = 0;
+	uint64_t Args[3] = {};
+};
+
+static_assert(offsetof(CallBlockHeader, ReturnRip) == 0 && offsetof(CallBlockHeader, ReturnRsp) == 8 && offsetof(CallBlockHeader, Count) == 0x10
+	&& sizeof(CallBlockHeader) == 0x18, "The call trampolines read the call block header at these offsets.");
+static_assert(offsetof(CallBlockCall, Args) == 8 && sizeof(CallBlockCall) == 0x20, "The call trampolines read each call at these offsets.");
+
+// The layout of the telemetry flushed with debuggerCmdFlushTelemetry. A flush of any other version is dropped rather than misread.
+static const uint32_t TELEMETRY_VERSION = 1;
+
+/*
+* Telemetry the debuggee batches up in a buffer of its own, and hands over with one debuggerCmdFlushTelemetry once the buffer fills,
+* so it is only stopped once per buffer rather than once per record. The debugger fetches the whole flush in one binary dump.
+* A flush is this header followed by RecordCount records, each a TelemetryRecordHeader and then Size bytes of payload,
+* padded out to TELEMETRY_RECORD_ALIGNMENT so the next header is aligned.
+*/
+struct TelemetryFlushHeader
+{
+	uint32_t Version = 0;
+	uint32_t RecordCount = 0;
+};
+
+struct TelemetryRecordHeader
+{
+	uint32_t Type = 0; // What the payload is. Only the consumers give it a meaning.
+	uint32_t Size = 0; // The size of the payload, not counting the padding after it.
+};
+
+static const size_t TELEMETRY_RECORD_ALIGNMENT = 8;
+
+// The most the debuggee may flush at once. Anything larger is taken to be a bad size rather than read.
+static const size_t MAX_TELEMETRY_FLUSH_SIZE = 16 << 20;
+
+static_assert(sizeof(TelemetryFlushHeader) == 8 && sizeof(TelemetryRecordHeader) == 8, "Telemetry headers are read from the flush as they are laid out here.");
+
+// The space a record with a payload of size bytes takes up in a flush.
+constexpr size_t GetTelemetryRecordSize(const size_t size)
+{
+	return sizeof(TelemetryRecordHeader) + ((size + TELEMETRY_RECORD_ALIGNMENT - 1) & ~(TELEMETRY_RECORD_ALIGNMENT - 1));
+}
+
+/*
+* Lays out telemetry records in a flush of up to Capacity bytes, the way the debuggee batches them up.
+* Append returns false once a record does not fit, at which point the buffer is flushed with debuggerCmdFlushTelemetry and cleared.
+*/
+template <size_t Capacity>
+class TelemetryBuffer
+{
+public:
+	static_assert(Capacity >= sizeof(TelemetryFlushHeader) && Capacity % TELEMETRY_RECORD_ALIGNMENT == 0 && Capacity <= MAX_TELEMETRY_FLUSH_SIZE,
+		"A telemetry buffer holds whole records, and is flushed all at once.");
+
+	TelemetryBuffer() { Clear(); }
+
+	bool Append(const uint32_t type, const void* const payload, const uint32_t size)
+	{
+		const size_t recordSize = GetTelemetryRecordSize(size);
+		if (recordSize > Capacity - m_Size)
+		{
+			return false;
+		}
+
+		const TelemetryRecordHeader header = { type, size };
+		std::memcpy(m_Data + m_Size, &header, sizeof(header));
+		std::memcpy(m_Data + m_Size + sizeof(header), payload, size);
+		std::memset(m_Data + m_Size + sizeof(header) + size, 0, recordSize - sizeof(header) - size);
+		m_Size += recordSize;
+		++m_Header.RecordCount;
+		std::memcpy(m_Data, &m_Header, sizeof(m_Header));
+		return true;
+	}
+
+	// The flush, header first.
+	const uint8_t* GetData() const { return m_Data; }
+	size_t GetSize() const { return m_Size; }
+
+	bool IsEmpty() const { return m_Header.RecordCount == 0; }
+
+	void Clear()
+	{
+		m_Header = { TELEMETRY_VERSION, 0 };
+		std::memcpy(m_Data, &m_Header, sizeof(m_Header));
+		m_Size = sizeof(m_Header);
+	}
+
+private:
+	TelemetryFlushHeader m_Header;
+	alignas(TELEMETRY_RECORD_ALIGNMENT) uint8_t m_Data[Capacity];
+	size_t m_Size = 0;
+};
+
+// How far below the call block the trampoline's rsp is when it breaks after making the calls, having saved the registers and made home space.
+static const size_t CALL_TRAMPOLINE_FRAME_SIZE = 0xe0;
+
+// The size of the code at the start of each debug command: int 3, a short jmp, 'DCMD', then the opcode.
+static const size_t DBG_CMD_SIGNATURE_SIZE = 8;
+
+/*
+* The code of a debug command's stub in the debuggee, which DummyProgram.cpp generates one of for each command in DBG_CMD_LIST.
+* Its signature is an int 3 for the debugger to break on, then a jmp over 'DCMD' and the opcode, which lands on a ret.
+*/
+using DbgCmdStub = std::array<uint8_t, DBG_CMD_SIGNATURE_SIZE + 1>;
+
+constexpr DbgCmdStub MakeDbgCmdStub(const uint8_t opCode)
+{
+	return { 0xcc, 0xeb, (uint8_t)(DBG_CMD_SIGNATURE_SIZE - 3), 'D', 'C', 'M', 'D', opCode, 0xc3 };
+}
+
+/*
+* Checks whether the DBG_CMD_SIGNATURE_SIZE bytes at code, starting at an int 3, are the start of a debug command, and gets its opcode if so.
+* We will be on an int 3 (cc), followed by a jmp (eb) and its offset operand, then the DCMD (44 43 4d 44) we've planted to identify a debug command in the debuggee stub corresponding to each dbg command.
+* The final byte is the opcode, which is matched by the handler to identify which dbg command this is.
+*/
+constexpr bool ParseDbgCmdSignature(const uint8_t* const code, uint8_t& opCode)
+{
+	if (code[0] != 0xcc || code[1] != 0xeb || code[3] != 'D' || code[4] != 'C' || code[5] != 'M' || code[6] != 'D')
+	{
+		return false;
+	}
+
+	opCode = code[7];
+	return true;
+}
+
+// Whether every stub MakeDbgCmdStub generates is recognized by ParseDbgCmdSignature as its own command.
+constexpr bool AreDbgCmdStubsRecognized()
+{
+	for (size_t i = 0; i < DBG_CMD_COUNT; ++i)
+	{
+		const DbgCmdStub stub = MakeDbgCmdStub((uint8_t)i);
+		const size_t jumpTarget = 3 + (size_t)stub[2];
+		uint8_t opCode = 0;
+		if (!ParseDbgCmdSignature(stub.data(), opCode) || opCode != i || jumpTarget >= stub.size() || stub[jumpTarget] != 0xc3)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+static_assert(AreDbgCmdStubsRecognized(), "Every debug command stub has to be recognized by its signature, and jump to its ret.");
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <concepts>
+#include <coroutine>
+#include <exception>
+#include <type_traits>
+#include <utility>
+
+#include "FramePool.h"
+
+// Anything with a FramePool to allocate the frames of its DbgTask member functions from.
+template <typename Owner>
+concept FramePoolOwner = requires(Owner& owner)
+{
+	{ owner.GetFramePool() } -> std::same_as<FramePool&>;
+};
+
+// The part of a DbgTask's promise that does not depend on its result type.
+class DbgTaskPromiseBase
+{
+public:
+	// Frames of member functions of a FramePoolOwner come out of its pool. Frames of anything else come from the heap.
+	template <FramePoolOwner Owner, typename... Args>
+	static void* operator new(const size_t size, Owner& owner, Args&...) { return owner.GetFramePool().Allocate(size); }
+	static void* operator new(const size_t size) { return FramePool::AllocateUnpooled(size); }
+	static void operator delete(void* const memory) { FramePool::Free(memory); }
+
+	// Tasks do not run until they are awaited or started.
+	std::suspend_always initial_suspend() noexcept { return {}; }
+
+	// A finished task stays suspended until its DbgTask is destroyed, and hands control back to whatever awaited it.
+	auto final_suspend() noexcept
+	{
+		struct FinalAwaiter
+		{
+			bool await_ready() noexcept { return false; }
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<>) noexcept { return m_Continuation ? m_Continuation : std::noop_coroutine(); }
+			void await_resume() noexcept {}
+
+			std::coroutine_handle<> m_Continuation;
+		};
+		return FinalAwaiter{ m_Continuation };
+	}
+
+	// Nothing here throws.
+	void unhandled_exception() { std::terminate(); }
+
+	// The coroutine awaiting this task, if any.
+	std::coroutine_handle<> m_Continuation;
+};
+
+template <typename T>
+class DbgTaskPromise : public DbgTaskPromiseBase
+{
+public:
+	void return_value(T value) { m_Value = std::move(value); }
+
+	T m_Value{};
+};
+
+template <>
+class DbgTaskPromise<void> : public DbgTaskPromiseBase
+{
+public:
+	void return_void() {}
+};
+
+/*
+* A coroutine that handles a debugger event, or part of one. Handlers co_await CDB commands and other tasks, and resume when they complete.
+* The task owns its coroutine frame, and an awaited task is owned by the frame awaiting it, so destroying the outermost task destroys
+* every frame under it. Commands that those frames were waiting on are cancelled along with them.
+*/
+template <typename T = void>
+class [[nodiscard]] DbgTask
+{
+public:
+	class promise_type : public DbgTaskPromise<T>
+	{
+	public:
+		DbgTask get_return_object() { return DbgTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+	};
+
+	DbgTask() = default;
+	DbgTask(DbgTask&& other) noexcept : m_Handle(std::exchange(other.m_Handle, nullptr)) {}
+	DbgTask& operator=(DbgTask&& other) noexcept
+	{
+		if (this != &other)
+		{
+			Destroy();
+			m_Handle = std::exchange(other.m_Handle, nullptr);
+		}
+		return *this;
+	}
+	~DbgTask() { Destroy(); }
+
+	// Runs a task that nothing awaits until its first suspension.
+	void Start() { m_Handle.resume(); }
+
+	explicit operator bool() const { return (bool)m_Handle; }
+
+	auto operator co_await() noexcept
+	{
+		struct Awaiter
+		{
+			bool await_ready() noexcept { return !m_Handle || m_Handle.done(); }
+
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+			{
+				m_Handle.promise().m_Continuation = awaiting;
+				return m_Handle;
+			}
+
+			T await_resume()
+			{
+				if constexpr (!std::is_void_v<T>)
+				{
+					return std::move(m_Handle.promise().m_Value);
+				}
+			}
+
+			std::coroutine_handle<promise_type> m_Handle;
+		};
+		return Awaiter{ m_Handle };
+	}
+
+private:
+	explicit DbgTask(const std::coroutine_handle<promise_type> handle) : m_Handle(handle) {}
+
+	void Destroy()
+	{
+		if (m_Handle)
+		{
+			m_Handle.destroy();
+			m_Handle = nullptr;
+		}
+	}
+
+	std::coroutine_handle<promise_type> m_Handle;
+};
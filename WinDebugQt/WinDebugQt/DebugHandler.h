@@ -1,100 +1,81 @@
 #pragma once
 
+#include <filesystem>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
+#include <windows.h>
 
+#include "DebugSession.h"
 #include "IDebugHandler.h"
-#include "Process.h"
 
+/*
+* Runs any number of debug sessions at once. The output pipes of every session's CDB are serviced by one I/O completion port and a small pool of
+* worker threads, which frame the output and queue up the sessions that have something to handle. Those sessions are then drained on the Qt thread
+* in one go, so neither a thread nor a timer is needed per session.
+*/
 class DebugHandler : public IDebugHandler
 {
 public:
-	// Runs the dummy application and launches the CDB debugger to attach to it.
-	virtual void StartButtonPressed() override;
+	DebugHandler();
+	virtual ~DebugHandler() override;
 
-	// Stops the dummy application and the CDB debugger attached to it.
+	// Runs sessionCount dummy applications, each with its own CDB debugger attached.
+	virtual void StartButtonPressed(const size_t sessionCount) override;
+
+	// Stops every dummy application and the CDB debuggers attached to them.
 	virtual void StopButtonPressed() override;
 
-	// Gets additional output since the last time this was called from CDB.
-	virtual std::string GetLogData() override;
+	// The number of sessions started by the last StartButtonPressed.
+	virtual size_t GetSessionCount() override { return m_Sessions.size(); }
+
+	// The output of a session's CDB, or null if there is no such session.
+	virtual LogRing* GetLog(const size_t session) override;
+
+	// Caps the memory each session's log may use, and sets what to drop once it is reached. Applies from the next start.
+	virtual void SetLogLimits(const size_t memoryCap, const LogRing::OverflowPolicy policy) override;
+
+	// Turns latency measurement on or off for every session, current and future.
+	virtual void SetProfiling(const bool enabled) override;
+
+	// What a session has measured, or null if there is no such session.
+	virtual SessionProfile* GetProfile(const size_t session) override;
+
+	// Records a trace of each session to directory, as session-N.wdqtrace, so it can be replayed with TraceReplay. Empty to stop recording. Applies from the next start.
+	void SetTraceDirectory(const std::filesystem::path& directory) { m_TraceDirectory = directory; }
+
+	// Has each session's CDB deal with the debuggee's exceptions by policy. Applies from the next start. Returns false if the policies cannot all be applied.
+	bool SetEventPolicies(std::vector<EventPolicy> policies);
 
 private:
-	// The update loop that runs while a program is being debugged.
-	void DebugUpdate();
-
-	// Once the cdb debugger detects a prompt, it is handled here.
-	void HandlePrompt();
-
-	// Writes to the stdin pipe of the process being debugged.
-	void WriteToCdbProc(const char* const string);
-
-	// Handles a debugger command coming from the debuggee application.
-	void HandleDbgCmd(const std::string line);
-
-	// Handles the command to set the callbacks in the debuggee code that can be called.
-	void HandleDbgCmdSetCallbacks();
-
-	// Handles the command to set the alt stack location in the debuggee code that can be used as the new stack location when firing debuggee callbacks.
-	void HandleDbgCmdRegisterAltStack();
-
-	// Fires one of the callbacks the debuggee application has registered to be callable.
-	void FireCallback(const unsigned __int64 callbackAddress, std::function<void(unsigned __int64)> andThenDo, const unsigned __int64 arg0 = 0, const unsigned __int64 arg1 = 0, const unsigned __int64 arg2 = 0);
-
-	// Preps a DebugHandler message to be stored in m_DataBuffer for later log retrieval.
-	void LogMessage(const char* const message);
-
-	struct RegisterContext
-	{
-		std::string Rax;
-		std::string Rcx;
-		std::string Rdx;
-		std::string Rbx;
-		std::string Rsp;
-		std::string Rbp;
-		std::string Rsi;
-		std::string Rdi;
-		std::string R8;
-		std::string R9;
-		std::string R10;
-		std::string R11;
-		std::string R12;
-		std::string R13;
-		std::string R14;
-		std::string R15;
-
-		std::string Rip;
-		std::string ContextFlags;
-
-		std::string XmmHigh[16];
-		std::string XmmLow[16];
-	};
-
-	Process m_DummyProc;
-	Process m_CdbProc;
-
-	// Stores the current output data that has not yet been retrieved via GetLogData.
-	std::string m_DataBuffer;
-
-	// Ensures m_DataBuffer isn't being written to while we retrieve it.
-	std::mutex m_DataLock;
-
-	// A callback to fire when any output line comes through.
-	// Returns true if the callback should be removed after being called.
-	std::function<bool(const std::string)> m_OnLineRead;
-
-	// A callback to fire when a cdb prompt comes through.
-	std::function<void()> m_OnPrompt;
-
-	// Used to bypass the first CDB prompt that comes through on connection to resume the program.
-	bool m_FirstPrompt = true;
-	
-	// Used as the new stack location when firing debuggee callbacks. Prevents callback failures when processing stack overflow exceptions.
-	unsigned __int64 m_AltStackLocation = 0;
-
-	// Stores register values so that we can restore them after modifying registers in the debuggee.
-	// This can be changed to a stack if calling callbacks within callback handling is desired.
-	RegisterContext m_StoredContext;
-
-	// Stores the value being returned by a callback function that was fired in the debuggee.
-	unsigned __int64 m_CallbackReturnValue;
-};
\ No newline at end of file
+	// The most worker threads to service the completion port with, however many cores there are.
+	static const unsigned MAX_WORKER_COUNT = 4;
+
+	// A worker thread's loop. Handles completed reads on the sessions' output pipes until it is woken up with no session to stop it.
+	void ServiceCompletions();
+
+	// Runs on the Qt thread when the worker threads have queued sessions with frames, and drains all of them.
+	void DrainSessions();
+
+	std::vector<std::unique_ptr<DebugSession>> m_Sessions;
+
+	// What each session's log is limited to when it is started.
+	size_t m_LogMemoryCap = LogRing::DEFAULT_MEMORY_CAP;
+	LogRing::OverflowPolicy m_LogPolicy = LogRing::OverflowPolicy::DropOldest;
+
+	std::filesystem::path m_TraceDirectory;
+
+	std::vector<EventPolicy> m_EventPolicies;
+
+	bool m_Profiling = false;
+
+	HANDLE m_CompletionPort = nullptr;
+	std::vector<std::thread> m_Workers;
+
+	// Sessions with frames waiting to be drained on the Qt thread, and the ones currently being drained. Swapped rather than copied so their buffers are reused.
+	std::mutex m_ReadyLock;
+	std::vector<DebugSession*> m_ReadySessions;
+	std::vector<DebugSession*> m_DrainingSessions;
+};
@@ -0,0 +1,65 @@
+#include "DebugSession.h"
+
+#include <format>
+
+#include "WinAssert.h"
+
+bool DebugSession::Start(const HANDLE completionPort, const std::string_view dummyCommand)
+{
+	// CreateProcess may write to the command line it is given.
+	std::string dummyStr(dummyCommand);
+	if (!m_DummyProc.Start(dummyStr.data(), false, true))
+	{
+		return false;
+	}
+
+	std::string cdbStr(std::format("C:\\Program Files (x86)\\Windows Kits\\10\\Debuggers\\x64\\cdb.exe -g -o -p {}", m_DummyProc.GetProcessId()));
+	if (!m_CdbProc.Start(cdbStr.data(), true, false))
+	{
+		m_DummyProc.Stop();
+		return false;
+	}
+
+	// CDB output is read by whichever worker thread picks up the completion, which wakes up the Qt thread through DrainFrames when there is something to handle.
+	if (!WinAssert(CreateIoCompletionPort(m_CdbProc.GetOutputHandle(), completionPort, (ULONG_PTR)this, 0), "CreateIoCompletionPort"))
+	{
+		Stop();
+		return false;
+	}
+
+	Begin();
+	m_Reading = true;
+	ReadCdbOutput();
+	return true;
+}
+
+void DebugSession::Stop()
+{
+	// Terminating CDB breaks its stdout pipe, which fails the outstanding read and so ends reading.
+	m_CdbProc.Terminate();
+	m_Reading.wait(true);
+
+	m_CdbProc.Stop();
+	m_DummyProc.Stop();
+	Reset();
+}
+
+bool DebugSession::OnReadComplete(const DWORD bytesRead)
+{
+	return QueueFrames(m_CdbProc.EndRead(bytesRead));
+}
+
+void DebugSession::ReadCdbOutput()
+{
+	if (!m_CdbProc.BeginRead(m_ReadOverlapped))
+	{
+		OnReadFailed();
+	}
+}
+
+void DebugSession::OnReadFailed()
+{
+	// Stop may destroy the session as soon as this is cleared, so it is the last thing done with it.
+	m_Reading = false;
+	m_Reading.notify_all();
+}
\ No newline at end of file
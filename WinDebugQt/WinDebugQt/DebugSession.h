@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <string_view>
+#include <windows.h>
+
+#include "CdbSession.h"
+#include "Process.h"
+
+/*
+* One dummy application and the CDB debugger attached to it, along with everything known about them.
+* Sessions share nothing, so DebugHandler can run any number of them side by side.
+* CDB's output is read by DebugHandler's worker threads through OnReadComplete, and handled on the Qt thread through DrainFrames.
+*/
+class DebugSession
+	final : public CdbSession
+{
+public:
+	// The session's log is capped at logMemoryCap, past which logPolicy decides what is dropped.
+	DebugSession(const size_t logMemoryCap, const LogRing::OverflowPolicy logPolicy)
+		: CdbSession(m_CdbProc, logMemoryCap, logPolicy)
+	{
+	}
+
+	virtual ~DebugSession() override { Stop(); }
+
+	/*
+	* Runs the dummy application with dummyCommand and launches the CDB debugger to attach to it. DummyProgram.exe is found next to WinDebugQt.exe, where the solution builds it.
+	* CDB's output pipe is associated with completionPort, with this session as the completion key, and the first read is issued on it.
+	*/
+	bool Start(const HANDLE completionPort, const std::string_view dummyCommand = "DummyProgram.exe");
+
+	// Stops the dummy application and the CDB debugger attached to it. Waits for the outstanding read on CDB's output to finish.
+	virtual void Stop() override;
+
+	/*
+	* Called by a worker thread when the read on CDB's output completes, to queue up each frame of the output.
+	* Returns true if frames were queued where there were none before, in which case DrainFrames must be called to handle them.
+	*/
+	bool OnReadComplete(const DWORD bytesRead);
+
+	// Called by a worker thread after OnReadComplete to issue the next read on CDB's output. Ends reading if it cannot.
+	void ReadCdbOutput();
+
+	// Called by a worker thread when the read on CDB's output fails, which happens once CDB exits or is terminated. Ends reading.
+	void OnReadFailed();
+
+private:
+	Process m_DummyProc;
+	Process m_CdbProc;
+
+	// The read outstanding on m_CdbProc's output.
+	OVERLAPPED m_ReadOverlapped = {};
+
+	// True from when the first read is issued until a read fails, such as when CDB exits. Stop waits on it, as a worker thread may be using the session until then.
+	std::atomic<bool> m_Reading = false;
+};
\ No newline at end of file
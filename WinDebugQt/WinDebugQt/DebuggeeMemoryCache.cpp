@@ -0,0 +1,440 @@
+#include "DebuggeeMemoryCache.h"
+
+#include <algorithm>
+#include <format>
+
+#include "RegisterContext.h"
+
+namespace
+{
+	constexpr uint64_t ALL_BYTES = ~0ull;
+
+	uint64_t PageOf(const uint64_t address)
+	{
+		return address & ~(DebuggeeMemoryCache::PAGE_SIZE - 1);
+	}
+
+	// The bits of a page's masks covering count bytes from offset.
+	uint64_t ByteMask(const uint64_t offset, const uint64_t count)
+	{
+		return (count >= 64 ? ALL_BYTES : (1ull << count) - 1) << offset;
+	}
+}
+
+DebuggeeMemoryCache::DebuggeeMemoryCache(CdbCommandQueue& queue)
+	: m_Queue(queue),
+	m_ResumeCount(queue.GetResumeCount())
+{
+	static_assert(PAGE_SIZE == 64, "Each page's masks have a bit per byte.");
+	static_assert(MAX_PAGES <= 64, "Each fetch has a bit per page it replaced.");
+}
+
+CachedMemoryRead DebuggeeMemoryCache::Read(const uint64_t address, const size_t count)
+{
+	return CachedMemoryRead(*this, address, count);
+}
+
+void DebuggeeMemoryCache::Prefetch(const uint64_t address, const size_t count)
+{
+	if (!IsKnown(address, count))
+	{
+		Want(address, count);
+	}
+}
+
+void DebuggeeMemoryCache::Insert(const uint64_t address, const uint8_t* const bytes, const size_t count)
+{
+	CheckResumed();
+	Store(address, bytes, count, true);
+}
+
+void DebuggeeMemoryCache::Invalidate(const uint64_t address, const size_t count)
+{
+	CheckResumed();
+	for (uint64_t page = PageOf(address); page < address + count; page += PAGE_SIZE)
+	{
+		if (Page* const cached = FindPage(page))
+		{
+			const uint64_t start = std::max(address, page) - page;
+			const uint64_t end = std::min(address + count, page + PAGE_SIZE) - page;
+			const uint64_t mask = ByteMask(start, end - start);
+			cached->Known &= ~mask;
+			cached->Readable &= ~mask;
+		}
+	}
+
+	++m_Epoch;
+	++m_Stats.Invalidations;
+}
+
+void DebuggeeMemoryCache::InvalidateAll()
+{
+	CheckResumed();
+	DropAll();
+}
+
+void DebuggeeMemoryCache::Reset()
+{
+	for (const std::unique_ptr<PageFetch>& fetch : m_Fetches)
+	{
+		fetch->Abandon();
+	}
+
+	while (m_Waiters)
+	{
+		m_Waiters->m_Waiting = false;
+		m_Waiters = m_Waiters->m_NextWaiter;
+	}
+
+	m_PageCount = 0;
+	m_NextReplaced = 0;
+	m_WantedPages.clear();
+	m_ResumeCount = m_Queue.GetResumeCount();
+	++m_Epoch;
+}
+
+void DebuggeeMemoryCache::CheckResumed()
+{
+	if (m_ResumeCount != m_Queue.GetResumeCount())
+	{
+		m_ResumeCount = m_Queue.GetResumeCount();
+		DropAll();
+	}
+}
+
+void DebuggeeMemoryCache::DropAll()
+{
+	if (m_PageCount)
+	{
+		++m_Stats.Invalidations;
+	}
+
+	m_PageCount = 0;
+	m_NextReplaced = 0;
+	++m_Epoch;
+}
+
+DebuggeeMemoryCache::Page* DebuggeeMemoryCache::FindPage(const uint64_t address)
+{
+	for (size_t i = 0; i < m_PageCount; ++i)
+	{
+		if (m_Pages[i].Address == address)
+		{
+			return &m_Pages[i];
+		}
+	}
+	return nullptr;
+}
+
+DebuggeeMemoryCache::Page& DebuggeeMemoryCache::GetOrAddPage(const uint64_t address)
+{
+	if (Page* const cached = FindPage(address))
+	{
+		return *cached;
+	}
+
+	Page* page;
+	if (m_PageCount < MAX_PAGES)
+	{
+		page = &m_Pages[m_PageCount++];
+	}
+	else
+	{
+		page = &m_Pages[m_NextReplaced];
+		m_NextReplaced = (m_NextReplaced + 1) % MAX_PAGES;
+		for (const std::unique_ptr<PageFetch>& fetch : m_Fetches)
+		{
+			fetch->OnPageReplaced(page->Address);
+		}
+	}
+
+	page->Address = address;
+	page->Known = 0;
+	page->Readable = 0;
+	return *page;
+}
+
+void DebuggeeMemoryCache::Store(const uint64_t address, const uint8_t* const bytes, const size_t count, const bool readable)
+{
+	for (uint64_t page = PageOf(address); page < address + count; page += PAGE_SIZE)
+	{
+		Page& cached = GetOrAddPage(page);
+		const uint64_t start = std::max(address, page) - page;
+		const uint64_t end = std::min(address + count, page + PAGE_SIZE) - page;
+		const uint64_t mask = ByteMask(start, end - start);
+		if (readable)
+		{
+			std::copy(bytes + (page + start - address), bytes + (page + end - address), cached.Bytes + start);
+			cached.Readable |= mask;
+		}
+		else
+		{
+			cached.Readable &= ~mask;
+		}
+		cached.Known |= mask;
+	}
+}
+
+bool DebuggeeMemoryCache::IsKnown(const uint64_t address, const size_t count)
+{
+	CheckResumed();
+	for (uint64_t page = PageOf(address); page < address + count; page += PAGE_SIZE)
+	{
+		const Page* const cached = FindPage(page);
+		const uint64_t start = std::max(address, page) - page;
+		const uint64_t end = std::min(address + count, page + PAGE_SIZE) - page;
+		const uint64_t mask = ByteMask(start, end - start);
+		if (!cached || (cached->Known & mask) != mask)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void DebuggeeMemoryCache::Copy(const uint64_t address, const size_t count, MemoryBytes& out)
+{
+	out.Address = address;
+	for (uint64_t byte = address; byte < address + count; ++byte)
+	{
+		const Page* const cached = FindPage(PageOf(byte));
+		const uint64_t offset = byte - PageOf(byte);
+		if (!cached || !(cached->Readable & (1ull << offset)))
+		{
+			return;
+		}
+		out.Bytes.push_back(cached->Bytes[offset]);
+	}
+}
+
+void DebuggeeMemoryCache::Want(const uint64_t address, const size_t count)
+{
+	for (uint64_t page = PageOf(address); page < address + count; page += PAGE_SIZE)
+	{
+		m_WantedPages.push_back(page);
+	}
+}
+
+bool DebuggeeMemoryCache::IsFetching(const uint64_t pageAddress) const
+{
+	for (const std::unique_ptr<PageFetch>& fetch : m_Fetches)
+	{
+		if (fetch->IsInFlight() && fetch->Covers(pageAddress, m_Epoch))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void DebuggeeMemoryCache::Fetch()
+{
+	CheckResumed();
+
+	// Pages that arrived, or are on their way, since they were wanted need no fetch of their own.
+	std::sort(m_WantedPages.begin(), m_WantedPages.end());
+	m_WantedPages.erase(std::unique(m_WantedPages.begin(), m_WantedPages.end()), m_WantedPages.end());
+	m_WantedPages.erase(std::remove_if(m_WantedPages.begin(), m_WantedPages.end(), [this](const uint64_t page)
+	{
+		const Page* const cached = FindPage(page);
+		return (cached && cached->Known == ALL_BYTES) || IsFetching(page);
+	}), m_WantedPages.end());
+
+	// One db for each run of adjacent pages. No more pages are fetched at once than fit in the cache, or they would replace each other.
+	size_t fetchedPages = 0;
+	size_t runStart = 0;
+	while (runStart < m_WantedPages.size() && fetchedPages < MAX_PAGES)
+	{
+		size_t runEnd = runStart + 1;
+		while (runEnd < m_WantedPages.size() && m_WantedPages[runEnd] == m_WantedPages[runEnd - 1] + PAGE_SIZE && fetchedPages + (runEnd - runStart) < MAX_PAGES)
+		{
+			++runEnd;
+		}
+
+		PageFetch* fetch = nullptr;
+		for (const std::unique_ptr<PageFetch>& idle : m_Fetches)
+		{
+			if (!idle->IsInFlight())
+			{
+				fetch = idle.get();
+				break;
+			}
+		}
+		if (!fetch)
+		{
+			fetch = m_Fetches.emplace_back(std::make_unique<PageFetch>(*this)).get();
+		}
+
+		const size_t pageCount = runEnd - runStart;
+		fetch->Start(m_Queue, m_WantedPages[runStart], pageCount);
+		fetchedPages += pageCount;
+		++m_Stats.Fetches;
+		m_Stats.FetchedBytes += pageCount * PAGE_SIZE;
+		runStart = runEnd;
+	}
+
+	// Whatever did not fit waits for the next fetch.
+	m_WantedPages.erase(m_WantedPages.begin(), m_WantedPages.begin() + runStart);
+}
+
+void DebuggeeMemoryCache::ResumeWaiters()
+{
+	// Resuming a read may destroy or add others, so the list is searched again from the start after each one.
+	bool resumed = true;
+	while (resumed)
+	{
+		resumed = false;
+		for (CachedMemoryRead** link = &m_Waiters; *link; link = &(*link)->m_NextWaiter)
+		{
+			CachedMemoryRead* const read = *link;
+			if (IsKnown(read->m_Address, read->m_Count))
+			{
+				*link = read->m_NextWaiter;
+				read->m_Waiting = false;
+				read->m_Waiter.resume();
+				resumed = true;
+				break;
+			}
+		}
+	}
+
+	// Reads whose pages were dropped before they arrived are still waiting, with nothing in flight to wake them up.
+	if (!m_Waiters || std::any_of(m_Fetches.begin(), m_Fetches.end(), [](const std::unique_ptr<PageFetch>& fetch) { return fetch->IsInFlight(); }))
+	{
+		return;
+	}
+
+	for (const CachedMemoryRead* read = m_Waiters; read; read = read->m_NextWaiter)
+	{
+		Want(read->m_Address, read->m_Count);
+	}
+	Fetch();
+	m_Queue.Flush();
+}
+
+void DebuggeeMemoryCache::PageFetch::Start(CdbCommandQueue& queue, const uint64_t address, const size_t pageCount)
+{
+	m_Address = address;
+	m_PageCount = pageCount;
+	m_Epoch = m_Cache.m_Epoch;
+	m_ReplacedPages = 0;
+	m_InFlight = true;
+
+	char text[64];
+	const auto end = std::format_to_n(text, sizeof(text), "db 0x{:x} L0x{:x}", address, pageCount * PAGE_SIZE);
+	SetText(std::string_view(text, end.out - text));
+	queue.Submit(*this);
+}
+
+void DebuggeeMemoryCache::PageFetch::OnPageReplaced(const uint64_t pageAddress)
+{
+	// Not only while in flight, as completing adds pages of its own. Start clears what a finished fetch picks up.
+	if (pageAddress >= m_Address && pageAddress < m_Address + m_PageCount * PAGE_SIZE)
+	{
+		m_ReplacedPages |= 1ull << ((pageAddress - m_Address) / PAGE_SIZE);
+	}
+}
+
+void DebuggeeMemoryCache::PageFetch::OnLine(const std::string_view line)
+{
+	//Example db output:
+	//00007ff6`6ce72580  cc eb 05 44 43 4d 44 00-c3 cc cc cc cc cc cc cc  ...DCMD.........
+	//Each line holds 16 bytes separated by spaces, or a dash in the middle, followed by their ascii form. Unreadable bytes are printed as ??.
+	uint64_t address;
+	const size_t addressLength = RegisterContextParser::ParseHex(line, address);
+	if (!addressLength || line.substr(addressLength, 2) != "  " || m_Epoch != m_Cache.m_Epoch)
+	{
+		return;
+	}
+
+	const size_t BYTES_PER_LINE = 16;
+	size_t index = addressLength + 2;
+	for (size_t i = 0; i < BYTES_PER_LINE && index + 2 <= line.size() && address + i < m_Address + m_PageCount * PAGE_SIZE; ++i, index += 3)
+	{
+		uint64_t value = 0;
+		const bool readable = RegisterContextParser::ParseHex(line.substr(index, 2), value) == 2;
+		const uint8_t byte = (uint8_t)value;
+		m_Cache.Store(address + i, &byte, 1, readable);
+	}
+}
+
+void DebuggeeMemoryCache::PageFetch::OnComplete(const bool succeeded)
+{
+	m_InFlight = false;
+
+	// A failed fetch cancels the handler waiting on it, the same as any other command.
+	if (!succeeded)
+	{
+		return;
+	}
+
+	// Anything the dump left out could not be read. Output that went stale is fetched again for whoever is still waiting on it,
+	// and so is any page that was replaced while the fetch was in flight, which would otherwise come back with none of its bytes.
+	// Adding a page here may replace a later one of the same fetch, so the replaced pages are checked as each one is marked.
+	if (m_Epoch == m_Cache.m_Epoch)
+	{
+		for (size_t i = 0; i < m_PageCount; ++i)
+		{
+			if (!(m_ReplacedPages & (1ull << i)))
+			{
+				m_Cache.GetOrAddPage(m_Address + i * PAGE_SIZE).Known = ALL_BYTES;
+			}
+		}
+	}
+
+	m_Cache.ResumeWaiters();
+}
+
+CachedMemoryRead::CachedMemoryRead(DebuggeeMemoryCache& cache, const uint64_t address, const size_t count)
+	: m_Cache(cache),
+	m_Address(address),
+	m_Count(count < MemoryByteArray::CAPACITY ? count : MemoryByteArray::CAPACITY)
+{
+	if (cache.IsKnown(m_Address, m_Count))
+	{
+		++cache.m_Stats.Hits;
+	}
+	else
+	{
+		++cache.m_Stats.Misses;
+		cache.Want(m_Address, m_Count);
+	}
+}
+
+CachedMemoryRead::~CachedMemoryRead()
+{
+	if (!m_Waiting)
+	{
+		return;
+	}
+
+	for (CachedMemoryRead** link = &m_Cache.m_Waiters; *link; link = &(*link)->m_NextWaiter)
+	{
+		if (*link == this)
+		{
+			*link = m_NextWaiter;
+			break;
+		}
+	}
+}
+
+void CachedMemoryRead::await_suspend(const std::coroutine_handle<> waiter)
+{
+	m_Waiter = waiter;
+	m_Waiting = true;
+	m_NextWaiter = m_Cache.m_Waiters;
+	m_Cache.m_Waiters = this;
+
+	// Everything wanted since the last fetch goes out together, along with whatever else has been submitted.
+	// This read is wanted again in case what it wanted was dropped since it was made.
+	m_Cache.Want(m_Address, m_Count);
+	m_Cache.Fetch();
+	m_Cache.m_Queue.Flush();
+}
+
+MemoryBytes CachedMemoryRead::await_resume()
+{
+	MemoryBytes bytes;
+	m_Cache.Copy(m_Address, m_Count, bytes);
+	return bytes;
+}
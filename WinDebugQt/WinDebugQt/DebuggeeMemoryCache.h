@@ -0,0 +1,193 @@
+#pragma once
+
+#include <array>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "CdbCommandQueue.h"
+#include "CdbCommands.h"
+
+class CachedMemoryRead;
+
+/*
+* Debuggee memory read while it is stopped, kept in pages so reading the same memory again does not cost another CDB round trip.
+* Reads that miss are gathered up and fetched together when one of them is awaited: the missing pages are fetched with one db per run
+* of adjacent pages, all in the same write. Everything cached is dropped once the debuggee is resumed, as it may have changed since,
+* and whatever the session writes to the debuggee's memory is dropped as it is written.
+* Not thread safe; used on the thread that drains the session.
+*/
+class DebuggeeMemoryCache
+	final
+{
+public:
+	// Pages are small, as CDB prints every byte as text. A 4 KB page would take over 18 KB of output to fetch.
+	static constexpr uint64_t PAGE_SIZE = 64;
+
+	// The most pages kept at once. Past this, the page cached first is reused.
+	static constexpr size_t MAX_PAGES = 64;
+
+	struct Stats
+	{
+		uint64_t Hits = 0; // Reads served without asking CDB.
+		uint64_t Misses = 0; // Reads that had to wait for a fetch.
+		uint64_t Fetches = 0; // db commands sent to fill pages.
+		uint64_t FetchedBytes = 0;
+		uint64_t Invalidations = 0; // Times cached memory was dropped, because the debuggee was resumed or written to.
+	};
+
+	explicit DebuggeeMemoryCache(CdbCommandQueue& queue);
+	DebuggeeMemoryCache(const DebuggeeMemoryCache&) = delete;
+	DebuggeeMemoryCache& operator=(const DebuggeeMemoryCache&) = delete;
+
+	// Reads count bytes at address, capped at MemoryByteArray::CAPACITY. Awaiting it gives back what could be read.
+	CachedMemoryRead Read(const uint64_t address, const size_t count);
+
+	// Has count bytes at address fetched along with the next read that misses, so memory larger than one read is fetched in the same write.
+	void Prefetch(const uint64_t address, const size_t count);
+
+	// Adds memory read some other way, such as through a CDB expression, to the cache.
+	void Insert(const uint64_t address, const uint8_t* const bytes, const size_t count);
+
+	// Drops whatever is cached of memory the session is about to write.
+	void Invalidate(const uint64_t address, const size_t count);
+
+	// Drops everything cached, such as before a write to memory at an address CDB works out.
+	void InvalidateAll();
+
+	// Forgets everything, including fetches in flight and reads waiting on them. Only once the queue has been cleared.
+	void Reset();
+
+	const Stats& GetStats() const { return m_Stats; }
+
+private:
+	friend class CachedMemoryRead;
+
+	struct Page
+	{
+		uint64_t Address = 0;
+		uint64_t Known = 0; // A bit per byte that has been fetched, whether it could be read or not.
+		uint64_t Readable = 0; // A bit per byte that could be read.
+		uint8_t Bytes[PAGE_SIZE] = {};
+	};
+
+	// Fetches a run of adjacent pages with db, and stores each byte of the dump in the cache as it is parsed.
+	class PageFetch
+		final : public CdbCommand
+	{
+	public:
+		explicit PageFetch(DebuggeeMemoryCache& cache) : CdbCommand(std::string()), m_Cache(cache) {}
+
+		// Fetches pageCount pages from address, in the queue's next write.
+		void Start(CdbCommandQueue& queue, const uint64_t address, const size_t pageCount);
+
+		bool IsInFlight() const { return m_InFlight; }
+
+		// Whether the fetch is for the page at pageAddress, and went out in epoch.
+		bool Covers(const uint64_t pageAddress, const uint32_t epoch) const
+		{
+			return m_Epoch == epoch && pageAddress >= m_Address && pageAddress < m_Address + m_PageCount * PAGE_SIZE;
+		}
+		void Abandon() { m_InFlight = false; }
+
+		// Called as the page at pageAddress is replaced to make room for another, so the fetch does not take it as fetched once it completes.
+		void OnPageReplaced(const uint64_t pageAddress);
+
+		virtual void OnLine(const std::string_view line) override;
+		virtual void OnComplete(const bool succeeded) override;
+
+	private:
+		DebuggeeMemoryCache& m_Cache;
+		uint64_t m_Address = 0;
+		size_t m_PageCount = 0;
+		uint32_t m_Epoch = 0; // The cache's epoch when the fetch went out. Output that arrives after anything was invalidated may be stale.
+		uint64_t m_ReplacedPages = 0; // A bit per page of the fetch that was replaced while it was in flight. A fetch is never more than MAX_PAGES long.
+		bool m_InFlight = false;
+	};
+
+	// Drops everything if the debuggee has been resumed since it was cached.
+	void CheckResumed();
+
+	// Drops every page, and the output of every fetch in flight.
+	void DropAll();
+
+	// The cached page at address, or null.
+	Page* FindPage(const uint64_t address);
+
+	// The cached page at address, reusing the oldest page if there is no room for another.
+	Page& GetOrAddPage(const uint64_t address);
+
+	// Marks count bytes from address as known, and unreadable unless given.
+	void Store(const uint64_t address, const uint8_t* const bytes, const size_t count, const bool readable);
+
+	// Whether every byte of a read is known, readable or not.
+	bool IsKnown(const uint64_t address, const size_t count);
+
+	// Copies what is readable of a read, up to the first byte that is not.
+	void Copy(const uint64_t address, const size_t count, MemoryBytes& out);
+
+	// Adds the pages of a read that missed to the next fetch.
+	void Want(const uint64_t address, const size_t count);
+
+	// Sends what has been wanted since the last fetch, coalescing adjacent pages.
+	void Fetch();
+
+	// Resumes the reads that were waiting for pages that have now arrived, and fetches again for any that are still waiting on nothing.
+	void ResumeWaiters();
+
+	// Whether any fetch that is still current is in flight for the page at address.
+	bool IsFetching(const uint64_t pageAddress) const;
+
+	CdbCommandQueue& m_Queue;
+	uint32_t m_ResumeCount = 0;
+
+	// Moved on whenever anything is invalidated, so fetches that went out before then know their output may be stale.
+	uint32_t m_Epoch = 0;
+
+	std::array<Page, MAX_PAGES> m_Pages;
+	size_t m_PageCount = 0;
+	size_t m_NextReplaced = 0;
+
+	// Pages to fetch on the next Fetch. Kept around so its capacity is reused.
+	std::vector<uint64_t> m_WantedPages;
+
+	// Fetch commands, reused once they complete.
+	std::vector<std::unique_ptr<PageFetch>> m_Fetches;
+
+	// Reads waiting on a fetch, linked through CachedMemoryRead::m_NextWaiter.
+	CachedMemoryRead* m_Waiters = nullptr;
+
+	Stats m_Stats;
+};
+
+/*
+* A read through a DebuggeeMemoryCache, which a DbgTask can co_await. Reads that are cached complete without suspending.
+* Lives in the awaiting coroutine's frame; destroying it stops it waiting.
+*/
+class CachedMemoryRead
+{
+public:
+	CachedMemoryRead(DebuggeeMemoryCache& cache, const uint64_t address, const size_t count);
+	CachedMemoryRead(const CachedMemoryRead&) = delete;
+	CachedMemoryRead& operator=(const CachedMemoryRead&) = delete;
+	~CachedMemoryRead();
+
+	// Checked again when awaited, as the debuggee may have been resumed since the read was made.
+	bool await_ready() { return m_Cache.IsKnown(m_Address, m_Count); }
+	void await_suspend(const std::coroutine_handle<> waiter);
+	MemoryBytes await_resume();
+
+private:
+	friend class DebuggeeMemoryCache;
+
+	DebuggeeMemoryCache& m_Cache;
+	uint64_t m_Address;
+	size_t m_Count;
+
+	std::coroutine_handle<> m_Waiter;
+	CachedMemoryRead* m_NextWaiter = nullptr;
+	bool m_Waiting = false;
+};
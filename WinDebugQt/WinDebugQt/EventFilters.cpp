@@ -0,0 +1,221 @@
+#include "EventFilters.h"
+
+#include <charconv>
+#include <format>
+
+#include "RegisterContext.h"
+
+namespace
+{
+	constexpr std::string_view COUNTER_NAMES[EventFilters::MAX_COUNTERS] =
+	{
+		"$t0", "$t1", "$t2", "$t3", "$t4", "$t5", "$t6", "$t7", "$t8", "$t9",
+		"$t10", "$t11", "$t12", "$t13", "$t14", "$t15", "$t16", "$t17", "$t18", "$t19",
+	};
+
+	// Event names go straight into sx commands, so only what CDB uses for them is allowed through: names, hex codes, and * for every other exception.
+	bool IsEventName(const std::string_view event)
+	{
+		if (event.empty())
+		{
+			return false;
+		}
+
+		for (const char c : event)
+		{
+			if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '*'))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+bool EventPolicy::Parse(const std::string_view spec, EventPolicy& outPolicy)
+{
+	const size_t equals = spec.find('=');
+	if (equals == std::string_view::npos)
+	{
+		return false;
+	}
+
+	EventPolicy policy;
+	policy.Event = spec.substr(0, equals);
+	if (!IsEventName(policy.Event) || policy.Event == "bpe" || policy.Event == "80000003")
+	{
+		return false;
+	}
+
+	static constexpr std::string_view SAMPLE = "sample:";
+	const std::string_view action = spec.substr(equals + 1);
+	if (action == "log")
+	{
+		policy.Action = EventAction::Log;
+	}
+	else if (action == "count")
+	{
+		policy.Action = EventAction::Count;
+	}
+	else if (action == "stop")
+	{
+		policy.Action = EventAction::Stop;
+	}
+	else if (action.substr(0, SAMPLE.size()) == SAMPLE)
+	{
+		const std::string_view interval = action.substr(SAMPLE.size());
+		const std::from_chars_result result = std::from_chars(interval.data(), interval.data() + interval.size(), policy.SampleInterval);
+		if (result.ec != std::errc() || result.ptr != interval.data() + interval.size() || policy.SampleInterval == 0)
+		{
+			return false;
+		}
+		policy.Action = EventAction::Sample;
+	}
+	else
+	{
+		return false;
+	}
+
+	outPolicy = std::move(policy);
+	return true;
+}
+
+bool EventFilters::SetPolicies(std::vector<EventPolicy> policies)
+{
+	std::vector<size_t> policyCounters;
+	size_t counterCount = 0;
+	for (const EventPolicy& policy : policies)
+	{
+		const bool counted = policy.Action == EventAction::Count || policy.Action == EventAction::Sample;
+		policyCounters.push_back(counted ? counterCount++ : MAX_COUNTERS);
+	}
+	if (counterCount > MAX_COUNTERS)
+	{
+		return false;
+	}
+
+	m_Policies = std::move(policies);
+	m_PolicyCounters = std::move(policyCounters);
+	m_CounterCount = counterCount;
+	m_Counts = {};
+
+	m_ReadCommand.clear();
+	for (size_t counter = 0; counter < m_CounterCount; ++counter)
+	{
+		if (counter)
+		{
+			m_ReadCommand += ';';
+		}
+		m_ReadCommand += "r ";
+		m_ReadCommand += GetCounterName(counter);
+	}
+	return true;
+}
+
+std::string EventFilters::FormatSetupCommand() const
+{
+	// The counters start from 0, as scripts may have left something in them.
+	std::string command;
+	for (size_t counter = 0; counter < m_CounterCount; ++counter)
+	{
+		command += std::format("r {}=0;", GetCounterName(counter));
+	}
+
+	for (size_t i = 0; i < m_Policies.size(); ++i)
+	{
+		const EventPolicy& policy = m_Policies[i];
+		const std::string_view counter = m_PolicyCounters[i] < MAX_COUNTERS ? GetCounterName(m_PolicyCounters[i]) : std::string_view();
+		switch (policy.Action)
+		{
+			case EventAction::Log:
+			{
+				// Not sxn, which would let a callback's return to rip 0 go by without breaking, so CDB breaks, prints the event, and carries on itself.
+				command += std::format("sxe -c \".if (@rip != 0) {{ gn }}\" {};", policy.Event);
+				break;
+			}
+			case EventAction::Count:
+			{
+				command += std::format("sxe -c \".if (@rip != 0) {{ r {}=@{}+1; gn }}\" {};", counter, counter, policy.Event);
+				break;
+			}
+			case EventAction::Sample:
+			{
+				command += std::format("sxe -c \".if (@rip != 0) {{ .if ((@{} % 0n{}) == 0) {{ .echo Sampled {}; kn }}; r {}=@{}+1; gn }}\" {};",
+					counter, policy.SampleInterval, policy.Event, counter, counter, policy.Event);
+				break;
+			}
+			case EventAction::Stop:
+			{
+				command += std::format("sxe {};", policy.Event);
+				break;
+			}
+		}
+	}
+
+	if (!command.empty())
+	{
+		command.pop_back();
+	}
+	return command;
+}
+
+void EventFilters::ReadCounters(CdbCommandQueue& queue)
+{
+	if (m_CounterCount && !m_CounterRead.IsInFlight())
+	{
+		m_CounterRead.Start(queue, m_ReadCommand);
+	}
+}
+
+uint64_t EventFilters::GetCount(const size_t policy) const
+{
+	return policy < m_PolicyCounters.size() && m_PolicyCounters[policy] < MAX_COUNTERS ? m_Counts[m_PolicyCounters[policy]] : 0;
+}
+
+std::string EventFilters::FormatCounts() const
+{
+	std::string counts;
+	for (size_t i = 0; i < m_Policies.size(); ++i)
+	{
+		if (m_PolicyCounters[i] < MAX_COUNTERS)
+		{
+			counts += std::format("{}{} {}", counts.empty() ? "" : ", ", m_Policies[i].Event, m_Counts[m_PolicyCounters[i]]);
+		}
+	}
+	return counts;
+}
+
+void EventFilters::Reset()
+{
+	m_Counts = {};
+	m_CounterRead.Abandon();
+}
+
+std::string_view EventFilters::GetCounterName(const size_t counter)
+{
+	return COUNTER_NAMES[counter];
+}
+
+void EventFilters::CounterRead::Start(CdbCommandQueue& queue, const std::string_view text)
+{
+	SetText(text);
+	m_InFlight = true;
+	queue.Submit(*this);
+}
+
+void EventFilters::CounterRead::OnLine(const std::string_view line)
+{
+	//Example r $t0 output:
+	//$t0=00000000000004d2
+	//Pseudo-register names start with a $, which RegisterContextParser does not take as part of a name, so they are matched here.
+	for (size_t counter = 0; counter < m_Filters.m_CounterCount; ++counter)
+	{
+		const std::string_view name = GetCounterName(counter);
+		uint64_t count;
+		if (line.substr(0, name.size()) == name && line.substr(name.size(), 1) == "=" && RegisterContextParser::ParseHex(line.substr(name.size() + 1), count))
+		{
+			m_Filters.m_Counts[counter] = count;
+			return;
+		}
+	}
+}
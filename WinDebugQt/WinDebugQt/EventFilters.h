@@ -0,0 +1,107 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "CdbCommandQueue.h"
+
+// What CDB does when the debuggee raises an event that has a policy.
+enum class EventAction
+{
+	Log, // Prints that it happened, without stopping.
+	Count, // Counts it inside CDB and lets the debuggee carry on.
+	Sample, // Counts it, and prints the stack of every Nth one, inside CDB.
+	Stop, // Breaks into the session, which prints the stack and passes the event on (sxe).
+};
+
+struct EventPolicy
+{
+	// A CDB event filter name, such as eh or av, or an exception code in hex.
+	std::string Event;
+	EventAction Action = EventAction::Stop;
+
+	// For Sample, the stack is printed for the first of every SampleInterval events.
+	uint32_t SampleInterval = 0;
+
+	/*
+	* Parses a policy like "eh=count", "av=sample:100", "c0000094=log" or "ch=stop".
+	* Int 3 breaks (bpe, 80000003) cannot be given a policy, as the debug commands are int 3s the session has to see.
+	*/
+	static bool Parse(const std::string_view spec, EventPolicy& outPolicy);
+};
+
+/*
+* Event policies turned into CDB event filters, so the debuggee's exceptions are dealt with inside CDB rather than each one stopping the debuggee
+* for the session to handle. Counted events are counted in CDB's $t pseudo-registers, which are read whenever the debuggee breaks anyway.
+* Every filter command leaves a fault at rip 0 alone, as that is a callback the session fired returning to it.
+*/
+class EventFilters
+	final
+{
+public:
+	// CDB has twenty pseudo-registers for scripts to use, $t0 to $t19.
+	static constexpr size_t MAX_COUNTERS = 20;
+
+	// Counters are read through a queue, which the filters must not outlive.
+	EventFilters() = default;
+	EventFilters(const EventFilters&) = delete;
+	EventFilters& operator=(const EventFilters&) = delete;
+
+	// Replaces the policies. Returns false, and leaves them as they were, if more than MAX_COUNTERS events are to be counted.
+	bool SetPolicies(std::vector<EventPolicy> policies);
+
+	const std::vector<EventPolicy>& GetPolicies() const { return m_Policies; }
+	bool IsEmpty() const { return m_Policies.empty(); }
+
+	// The sx commands that set up every policy, separated by semicolons.
+	std::string FormatSetupCommand() const;
+
+	// Submits a read of the counters, to go out with the queue's next write, unless one is already on its way or nothing is counted.
+	void ReadCounters(CdbCommandQueue& queue);
+
+	// How many times the event of policy has happened, as of the last read. Always 0 for policies that do not count.
+	uint64_t GetCount(const size_t policy) const;
+
+	// Describes what has been counted, such as "eh 1234, av 5", or empty if nothing is counted.
+	std::string FormatCounts() const;
+
+	// Zeroes the counts, and forgets any read in flight. Only once the queue has been cleared.
+	void Reset();
+
+private:
+	// Reads every counter with r, one command per counter.
+	class CounterRead final : public CdbCommand
+	{
+	public:
+		explicit CounterRead(EventFilters& filters) : CdbCommand(std::string()), m_Filters(filters) {}
+
+		bool IsInFlight() const { return m_InFlight; }
+		void Start(CdbCommandQueue& queue, const std::string_view text);
+		void Abandon() { m_InFlight = false; }
+
+		virtual void OnLine(const std::string_view line) override;
+		virtual void OnComplete(const bool) override { m_InFlight = false; }
+
+	private:
+		EventFilters& m_Filters;
+		bool m_InFlight = false;
+	};
+
+	// The counter an event is counted in, as a CDB register.
+	static std::string_view GetCounterName(const size_t counter);
+
+	std::vector<EventPolicy> m_Policies;
+
+	// The counter of each policy, or MAX_COUNTERS for policies that do not count.
+	std::vector<size_t> m_PolicyCounters;
+	size_t m_CounterCount = 0;
+	std::array<uint64_t, MAX_COUNTERS> m_Counts = {};
+
+	// The commands CounterRead sends, worked out once when the policies are set.
+	std::string m_ReadCommand;
+	CounterRead m_CounterRead{ *this };
+};
@@ -0,0 +1,63 @@
+#include "FramePool.h"
+
+#include <new>
+
+FramePool::~FramePool()
+{
+	for (FreeBlock*& freeList : m_FreeLists)
+	{
+		while (freeList)
+		{
+			FreeBlock* const next = freeList->Next;
+			::operator delete(freeList);
+			freeList = next;
+		}
+	}
+}
+
+void* FramePool::Allocate(const size_t size)
+{
+	const size_t sizeClass = (size + sizeof(Header) - 1) / SIZE_CLASS_GRANULARITY;
+	if (sizeClass >= SIZE_CLASS_COUNT)
+	{
+		return AllocateUnpooled(size);
+	}
+
+	void* block = m_FreeLists[sizeClass];
+	if (block)
+	{
+		m_FreeLists[sizeClass] = m_FreeLists[sizeClass]->Next;
+	}
+	else
+	{
+		block = ::operator new((sizeClass + 1) * SIZE_CLASS_GRANULARITY);
+	}
+
+	Header* const header = static_cast<Header*>(block);
+	header->Pool = this;
+	header->SizeClass = sizeClass;
+	return header + 1;
+}
+
+void FramePool::Free(void* const memory)
+{
+	Header* const header = static_cast<Header*>(memory) - 1;
+	if (header->SizeClass == UNPOOLED)
+	{
+		::operator delete(header);
+		return;
+	}
+
+	FreeBlock* const block = reinterpret_cast<FreeBlock*>(header);
+	FramePool* const pool = header->Pool;
+	block->Next = pool->m_FreeLists[header->SizeClass];
+	pool->m_FreeLists[header->SizeClass] = block;
+}
+
+void* FramePool::AllocateUnpooled(const size_t size)
+{
+	Header* const header = static_cast<Header*>(::operator new(sizeof(Header) + size));
+	header->Pool = nullptr;
+	header->SizeClass = UNPOOLED;
+	return header + 1;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+
+/*
+* Allocates coroutine frames for one debug session. Freed frames are kept on a free list per size class and handed out again,
+* so once every handler has run once no more heap allocations are made. Frames larger than the biggest size class go to the heap.
+* Not thread safe; frames must be created and destroyed on the thread that runs the session's handlers.
+*/
+class FramePool
+	final
+{
+public:
+	FramePool() = default;
+	FramePool(const FramePool&) = delete;
+	FramePool& operator=(const FramePool&) = delete;
+	~FramePool();
+
+	void* Allocate(const size_t size);
+
+	// Frees memory returned by Allocate on any pool, or by AllocateUnpooled.
+	static void Free(void* const memory);
+
+	// Allocates memory with the same layout as Allocate, for frames created without a pool.
+	static void* AllocateUnpooled(const size_t size);
+
+private:
+	// Stored in front of every allocation so Free knows where it came from.
+	struct alignas(16) Header
+	{
+		FramePool* Pool;
+		size_t SizeClass;
+	};
+
+	struct FreeBlock
+	{
+		FreeBlock* Next;
+	};
+
+	static constexpr size_t SIZE_CLASS_GRANULARITY = 64;
+	static constexpr size_t SIZE_CLASS_COUNT = 64; // Up to 4 KB per frame, which covers every handler, even CallBatch with its results held inline.
+	static constexpr size_t UNPOOLED = SIZE_CLASS_COUNT;
+
+	FreeBlock* m_FreeLists[SIZE_CLASS_COUNT] = {};
+};
@@ -0,0 +1,31 @@
+#include "FrameQueue.h"
+
+bool FrameQueue::Push(const std::string_view frame, const int frameType)
+{
+	std::scoped_lock lock(m_Lock);
+
+	const bool wasEmpty = m_Queued.Frames.empty();
+	if (wasEmpty)
+	{
+		m_Queued.QueuedAt = std::chrono::steady_clock::now();
+	}
+	m_Queued.Frames.push_back({ m_Queued.Text.size(), frame.size(), frameType });
+	m_Queued.Text += frame;
+
+	return wasEmpty;
+}
+
+void FrameQueue::TakeAll(Batch& batch)
+{
+	batch.Clear();
+
+	// Swapping hands the consumer's emptied buffers back to the producer, so their capacity is reused.
+	std::scoped_lock lock(m_Lock);
+	std::swap(batch, m_Queued);
+}
+
+void FrameQueue::Clear()
+{
+	std::scoped_lock lock(m_Lock);
+	m_Queued.Clear();
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+* Hands frames of child process output from a reader thread to the thread that handles them.
+* Frame text is packed into one string per batch, and batches are swapped rather than copied,
+* so once both sides have grown their buffers no allocations are made.
+*/
+class FrameQueue
+	final
+{
+public:
+	struct Batch
+	{
+		struct Frame
+		{
+			size_t Offset;
+			size_t Length;
+			int Type;
+		};
+
+		std::string Text;
+		std::vector<Frame> Frames;
+
+		// When the first of the frames was queued.
+		std::chrono::steady_clock::time_point QueuedAt;
+
+		std::string_view GetText(const Frame& frame) const { return std::string_view(Text).substr(frame.Offset, frame.Length); }
+		void Clear() { Text.clear(); Frames.clear(); }
+	};
+
+	/*
+	* Called by the producer to queue a frame.
+	* Returns true if the queue was empty, in which case the consumer must be woken up to take it.
+	*/
+	bool Push(const std::string_view frame, const int frameType);
+
+	// Called by the consumer to take everything queued so far. Anything left in batch is discarded.
+	void TakeAll(Batch& batch);
+
+	// Discards everything queued.
+	void Clear();
+
+private:
+	std::mutex m_Lock;
+	Batch m_Queued;
+};
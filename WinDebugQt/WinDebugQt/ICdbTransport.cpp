@@ -0,0 +1,19 @@
+#include "ICdbTransport.h"
+
+#include <fstream>
+
+bool ICdbTransport::ReadDump(const std::filesystem::path& path, std::vector<uint8_t>& image)
+{
+	// Unbuffered, as it is read in one go straight into image, so reading a dump does not allocate once image has grown to fit.
+	std::ifstream file;
+	file.rdbuf()->pubsetbuf(nullptr, 0);
+	file.open(path, std::ios::binary | std::ios::ate);
+	const std::streamoff size = file ? (std::streamoff)file.tellg() : -1;
+	image.resize(size > 0 ? (size_t)size : 0);
+	if (size <= 0 || !file.seekg(0) || !file.read((char*)image.data(), (std::streamsize)size))
+	{
+		image.clear();
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+#include <vector>
+
+#include "OutputTokenizer.h"
+
+/*
+* Whatever a CdbSession talks to CDB through. Normally this is the CDB process itself, but a recorded trace can stand in for it,
+* so a session can be run again exactly as it was without Windows or CDB.
+*/
+class ICdbTransport
+{
+public:
+	virtual ~ICdbTransport() = default;
+
+	// Writes text to CDB's input. Returns false if it could not be written.
+	virtual bool Write(const std::string_view text) = 0;
+
+	/*
+	* Frames output from CDB that has already been received. Returns false if there is no full frame yet.
+	* The previous frame is released by the next call, and outFrame is only valid until then.
+	* The tokenizer keeps its scan state between calls, so it must only be used with this transport.
+	*/
+	virtual bool NextFrame(std::string_view& outFrame, OutputTokenizer& tokenizer, int& frameType) = 0;
+
+	/*
+	* Reads the file CDB dumped memory to with .writemem into image, replacing what it held. Returns false, leaving it empty, if there was nothing to read.
+	* Read straight from disk, unless the transport stands in for CDB some other way, such as a trace that recorded what was read.
+	*/
+	virtual bool ReadDump(const std::filesystem::path& path, std::vector<uint8_t>& image);
+};
@@ -1,14 +1,31 @@
 #pragma once
 
 #include <QtCore/QObject>
-#include <string>
+
+#include "LogRing.h"
+#include "SessionProfile.h"
 
 // Model interface. To be utilized by the presenter.
 
 class IDebugHandler : public QObject
 {
 public:
-	virtual void StartButtonPressed() = 0;
+	// Starts sessionCount debug sessions, each debugging its own instance of the dummy application.
+	virtual void StartButtonPressed(const size_t sessionCount) = 0;
 	virtual void StopButtonPressed() = 0;
-	virtual std::string GetLogData() = 0;
+
+	// The number of sessions started by the last StartButtonPressed. Their output stays available after they are stopped, until the next start.
+	virtual size_t GetSessionCount() = 0;
+
+	// The output of a session, or null if there is no such session. The presenter is its only consumer, and must release every chunk it takes before the next start.
+	virtual LogRing* GetLog(const size_t session) = 0;
+
+	// Caps the memory each session's log may use, and sets what to drop once it is reached. Applies from the next start.
+	virtual void SetLogLimits(const size_t memoryCap, const LogRing::OverflowPolicy policy) = 0;
+
+	// Turns measuring how long each session spends handling debug commands on or off, for the sessions running and any started later.
+	virtual void SetProfiling(const bool enabled) = 0;
+
+	// What a session has measured, or null if there is no such session or the handler does not measure its sessions. Readable at any time.
+	virtual SessionProfile* GetProfile(const size_t session) = 0;
 };
\ No newline at end of file
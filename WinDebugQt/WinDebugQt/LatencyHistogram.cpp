@@ -0,0 +1,108 @@
+#include "LatencyHistogram.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+namespace
+{
+	// Raises maximum to value, if it is larger.
+	void UpdateMax(std::atomic<uint64_t>& maximum, const uint64_t value)
+	{
+		uint64_t current = maximum.load(std::memory_order_relaxed);
+		while (value > current && !maximum.compare_exchange_weak(current, value, std::memory_order_relaxed))
+		{
+		}
+	}
+}
+
+void LatencyHistogram::Record(const uint64_t nanoseconds)
+{
+	m_Buckets[GetBucket(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+	m_Count.fetch_add(1, std::memory_order_relaxed);
+	m_Total.fetch_add(nanoseconds, std::memory_order_relaxed);
+	UpdateMax(m_Max, nanoseconds);
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& other)
+{
+	for (size_t i = 0; i < BUCKET_COUNT; ++i)
+	{
+		const uint64_t count = other.m_Buckets[i].load(std::memory_order_relaxed);
+		if (count)
+		{
+			m_Buckets[i].fetch_add(count, std::memory_order_relaxed);
+		}
+	}
+	m_Count.fetch_add(other.m_Count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	m_Total.fetch_add(other.m_Total.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	UpdateMax(m_Max, other.m_Max.load(std::memory_order_relaxed));
+}
+
+void LatencyHistogram::Reset()
+{
+	for (std::atomic<uint64_t>& bucket : m_Buckets)
+	{
+		bucket.store(0, std::memory_order_relaxed);
+	}
+	m_Count.store(0, std::memory_order_relaxed);
+	m_Total.store(0, std::memory_order_relaxed);
+	m_Max.store(0, std::memory_order_relaxed);
+}
+
+double LatencyHistogram::GetMean() const
+{
+	const uint64_t count = GetCount();
+	return count ? static_cast<double>(m_Total.load(std::memory_order_relaxed)) / count : 0.0;
+}
+
+uint64_t LatencyHistogram::GetPercentile(const double percentile) const
+{
+	const uint64_t count = GetCount();
+	const uint64_t max = GetMax();
+	if (count == 0)
+	{
+		return 0;
+	}
+
+	// The rank of the value wanted, counting from 1.
+	const double clamped = std::clamp(percentile, 0.0, 100.0);
+	const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(clamped / 100.0 * count)));
+
+	uint64_t seen = 0;
+	for (size_t i = 0; i < BUCKET_COUNT; ++i)
+	{
+		seen += m_Buckets[i].load(std::memory_order_relaxed);
+		if (seen >= rank)
+		{
+			// Nothing recorded is larger than the max, which keeps the top percentiles from rounding up past it.
+			return std::min(GetBucketMax(i), max);
+		}
+	}
+	return max;
+}
+
+size_t LatencyHistogram::GetBucket(const uint64_t value)
+{
+	if (value < SUB_BUCKET_COUNT)
+	{
+		return static_cast<size_t>(value);
+	}
+
+	// Keep the top SUB_BUCKET_BITS bits of the value. The highest of them is always set, so only the rest pick the bucket within its power of two.
+	const int shift = std::bit_width(value) - SUB_BUCKET_BITS;
+	const uint64_t subBucket = (value >> shift) - HALF_SUB_BUCKET_COUNT;
+	return static_cast<size_t>(SUB_BUCKET_COUNT + (shift - 1) * HALF_SUB_BUCKET_COUNT + subBucket);
+}
+
+uint64_t LatencyHistogram::GetBucketMax(const size_t bucket)
+{
+	if (bucket < SUB_BUCKET_COUNT)
+	{
+		return bucket;
+	}
+
+	const size_t shift = (bucket - SUB_BUCKET_COUNT) / HALF_SUB_BUCKET_COUNT + 1;
+	const uint64_t subBucket = (bucket - SUB_BUCKET_COUNT) % HALF_SUB_BUCKET_COUNT + HALF_SUB_BUCKET_COUNT;
+	return ((subBucket + 1) << shift) - 1;
+}
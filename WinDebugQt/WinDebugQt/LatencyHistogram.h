@@ -0,0 +1,54 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/*
+* Counts latencies in buckets that are exact below SUB_BUCKET_COUNT nanoseconds and grow with the value above that, in the way HdrHistogram does,
+* so percentiles are within 1 / (SUB_BUCKET_COUNT / 2) of their true value at any scale, without storing every sample.
+* Recording never allocates, and is lock free: any number of threads can record to a histogram and read it at once.
+* A reader may see a value that is partly recorded, counted but not yet in its bucket, which only ever shifts a percentile by one value.
+*/
+class LatencyHistogram
+	final
+{
+public:
+	LatencyHistogram() = default;
+	LatencyHistogram(const LatencyHistogram&) = delete;
+	LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+	void Record(const uint64_t nanoseconds);
+
+	// Adds every value recorded in other to this histogram. Reset first to take a copy.
+	void Merge(const LatencyHistogram& other);
+
+	void Reset();
+
+	uint64_t GetCount() const { return m_Count.load(std::memory_order_relaxed); }
+	uint64_t GetMax() const { return m_Max.load(std::memory_order_relaxed); }
+	double GetMean() const;
+
+	// The value that percentile percent of the recorded values are at or below, or 0 if none have been recorded.
+	uint64_t GetPercentile(const double percentile) const;
+
+private:
+	static constexpr int SUB_BUCKET_BITS = 6;
+	static constexpr uint64_t SUB_BUCKET_COUNT = 1ull << SUB_BUCKET_BITS;
+	static constexpr uint64_t HALF_SUB_BUCKET_COUNT = SUB_BUCKET_COUNT / 2;
+
+	// The values below SUB_BUCKET_COUNT, then HALF_SUB_BUCKET_COUNT buckets for each power of two above it.
+	static constexpr size_t BUCKET_COUNT = SUB_BUCKET_COUNT + (64 - SUB_BUCKET_BITS) * HALF_SUB_BUCKET_COUNT;
+
+	static size_t GetBucket(const uint64_t value);
+
+	// The largest value that goes in bucket.
+	static uint64_t GetBucketMax(const size_t bucket);
+
+	// Only ever updated with relaxed atomics. Nothing orders them with each other, as each is only a count.
+	std::array<std::atomic<uint64_t>, BUCKET_COUNT> m_Buckets = {};
+	std::atomic<uint64_t> m_Count = 0;
+	std::atomic<uint64_t> m_Total = 0;
+	std::atomic<uint64_t> m_Max = 0;
+};
@@ -0,0 +1,680 @@
+#include "LogArchive.h"
+
+#include <algorithm>
+#include <cstring>
+#include <atomic>
+#include <format>
+#include <functional>
+#include <optional>
+#include <regex>
+#include <thread>
+
+// Written at the start of each segment index file, followed by the segment size, block count, and words per trigram bitmap.
+static const char INDEX_MAGIC[8] = { 'W', 'D', 'Q', 'L', 'I', 'D', 'X', '1' };
+
+static char ToLowerAscii(const char c)
+{
+	return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+}
+
+static std::string_view StripLineBreak(std::string_view line)
+{
+	while (!line.empty() && (line.back() == '\n' || line.back() == '\r'))
+	{
+		line.remove_suffix(1);
+	}
+	return line;
+}
+
+// The longest run of plain characters that every match of an ECMAScript regex has to contain, or empty if it cannot be worked out.
+// Only runs outside of any group are considered, and nothing is taken from a regex with alternatives, as those can match without them.
+static std::string RequiredLiteral(const std::string_view regex)
+{
+	if (regex.find('|') != std::string_view::npos)
+	{
+		return std::string();
+	}
+
+	std::string longest;
+	std::string run;
+	const auto endRun = [&]()
+	{
+		if (run.size() > longest.size())
+		{
+			longest = run;
+		}
+		run.clear();
+	};
+
+	int depth = 0;
+	for (size_t i = 0; i < regex.size(); ++i)
+	{
+		const char c = regex[i];
+		const char next = i + 1 < regex.size() ? regex[i + 1] : '\0';
+		if (c == '\\' || c == '[')
+		{
+			// Escapes and character classes match something, but not anything plain.
+			endRun();
+			if (c == '\\')
+			{
+				++i;
+			}
+			else
+			{
+				for (++i; i < regex.size() && regex[i] != ']'; ++i)
+				{
+					i += regex[i] == '\\' ? 1 : 0;
+				}
+			}
+		}
+		else if (c == '(' || c == ')')
+		{
+			endRun();
+			depth += c == '(' ? 1 : -1;
+		}
+		else if (c != '\0' && strchr("^$.?*+{}", c))
+		{
+			endRun();
+		}
+		else if (depth == 0 && (next == '?' || next == '*' || next == '{'))
+		{
+			// The character may not be there at all.
+			endRun();
+		}
+		else if (depth == 0)
+		{
+			run += c;
+		}
+	}
+	endRun();
+
+	return longest;
+}
+
+namespace
+{
+	// Finds the lines of a block that match a query. Shared by every thread of a search, so it keeps no state of its own while matching.
+	class LineMatcher
+	{
+	public:
+		explicit LineMatcher(const LogSearchQuery& query)
+			: m_CaseSensitive(query.CaseSensitive)
+		{
+			if (query.Regex)
+			{
+				try
+				{
+					m_Regex.emplace(query.Pattern, query.CaseSensitive ? std::regex::ECMAScript : std::regex::ECMAScript | std::regex::icase);
+				}
+				catch (const std::regex_error&)
+				{
+					// Leaves the matcher invalid.
+					return;
+				}
+			}
+
+			// Only lines with the literal in them are worth matching the regex against.
+			m_Literal = query.Regex ? RequiredLiteral(query.Pattern) : query.Pattern;
+			if (!m_CaseSensitive)
+			{
+				std::transform(m_Literal.begin(), m_Literal.end(), m_Literal.begin(), ToLowerAscii);
+			}
+			m_Searcher.emplace(m_Literal.begin(), m_Literal.end());
+		}
+
+		bool IsValid() const { return m_Searcher.has_value(); }
+
+		// Text that every matching line contains. It may be empty.
+		const std::string& GetLiteral() const { return m_Literal; }
+
+		// Adds the lines of text that match to hits, until there are maxHits of them. firstLine is the number of the first line in text.
+		// scratch is used to hold a lower case copy of text for case insensitive searches.
+		void FindLines(const std::string_view text, const uint64_t firstLine, const size_t maxHits, std::vector<LogSearchHit>& hits, std::string& scratch) const
+		{
+			if (m_Literal.empty())
+			{
+				// Nothing to narrow the search down with, so every line is matched against the regex.
+				uint64_t line = firstLine;
+				size_t lineStart = 0;
+				while (lineStart < text.size() && hits.size() < maxHits)
+				{
+					const size_t lineEnd = text.find('\n', lineStart);
+					const size_t next = lineEnd == std::string_view::npos ? text.size() : lineEnd + 1;
+					const std::string_view lineText = StripLineBreak(text.substr(lineStart, next - lineStart));
+					if (std::regex_search(lineText.begin(), lineText.end(), *m_Regex))
+					{
+						hits.push_back({ line, std::string(lineText) });
+					}
+
+					lineStart = next;
+					++line;
+				}
+				return;
+			}
+
+			std::string_view haystack = text;
+			if (!m_CaseSensitive)
+			{
+				scratch.resize(text.size());
+				std::transform(text.begin(), text.end(), scratch.begin(), ToLowerAscii);
+				haystack = scratch;
+			}
+
+			// Lines are only counted up to each match, so lines without one cost nothing but the search itself.
+			uint64_t line = firstLine;
+			size_t countedTo = 0;
+			size_t pos = 0;
+			while (pos < haystack.size() && hits.size() < maxHits)
+			{
+				const std::string_view::const_iterator found = std::search(haystack.begin() + pos, haystack.end(), *m_Searcher);
+				if (found == haystack.end())
+				{
+					break;
+				}
+
+				const size_t match = found - haystack.begin();
+				const size_t previousBreak = match == 0 ? std::string_view::npos : haystack.rfind('\n', match - 1);
+				const size_t lineStart = previousBreak == std::string_view::npos ? 0 : previousBreak + 1;
+				const size_t lineEnd = haystack.find('\n', match);
+				const size_t next = lineEnd == std::string_view::npos ? haystack.size() : lineEnd + 1;
+				const std::string_view lineText = StripLineBreak(text.substr(lineStart, next - lineStart));
+
+				if (!m_Regex || std::regex_search(lineText.begin(), lineText.end(), *m_Regex))
+				{
+					line += std::count(haystack.begin() + countedTo, haystack.begin() + lineStart, '\n');
+					countedTo = lineStart;
+					hits.push_back({ line, std::string(lineText) });
+				}
+
+				pos = next;
+			}
+		}
+
+	private:
+		bool m_CaseSensitive;
+		std::string m_Literal;
+		std::optional<std::boyer_moore_horspool_searcher<std::string::const_iterator>> m_Searcher;
+		std::optional<std::regex> m_Regex;
+	};
+}
+
+bool LogArchive::Create(const std::filesystem::path& directory, const Options& options)
+{
+	Close();
+
+	std::error_code error;
+	std::filesystem::remove_all(directory, error);
+	if (!std::filesystem::create_directories(directory, error))
+	{
+		return false;
+	}
+
+	m_Directory = directory;
+	m_Options = options;
+	m_Writable = true;
+	return true;
+}
+
+bool LogArchive::Open(const std::filesystem::path& directory, const Options& options)
+{
+	Close();
+
+	std::error_code error;
+	std::vector<std::filesystem::path> segmentPaths;
+	for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(directory, error))
+	{
+		const std::filesystem::path& path = entry.path();
+		if (path.extension() == ".log" && path.filename().string().starts_with("segment-"))
+		{
+			segmentPaths.push_back(path);
+		}
+	}
+	if (error)
+	{
+		return false;
+	}
+
+	// Segment names are numbered with leading zeroes, so sorting by name puts them in order.
+	std::sort(segmentPaths.begin(), segmentPaths.end());
+
+	m_Options = options;
+	for (const std::filesystem::path& path : segmentPaths)
+	{
+		Segment& segment = m_Segments.emplace_back();
+		segment.Path = path;
+		segment.Size = std::filesystem::file_size(path, error);
+		if (error || !LoadSegmentIndex(segment, m_WrittenLineCount))
+		{
+			m_Segments.clear();
+			m_WrittenLineCount = 0;
+			return false;
+		}
+	}
+
+	m_LineCount = m_WrittenLineCount;
+	m_Directory = directory;
+	return true;
+}
+
+void LogArchive::Close()
+{
+	if (m_Writable)
+	{
+		if (!m_OpenBlock.empty())
+		{
+			WriteBlock(m_OpenBlock.size());
+		}
+		if (!m_Segments.empty())
+		{
+			WriteSegmentIndex(m_Segments.back());
+		}
+	}
+
+	m_SegmentFile.close();
+	m_ReadFile.close();
+	m_ReadSegment = nullptr;
+	m_ReadBlock.clear();
+	m_ReadBlockFirstLine = UINT64_MAX;
+
+	if (!m_Directory.empty() && m_Options.RemoveOnClose)
+	{
+		std::error_code error;
+		std::filesystem::remove_all(m_Directory, error);
+	}
+
+	m_Directory.clear();
+	m_Writable = false;
+	m_Segments.clear();
+	m_OpenBlock.clear();
+	m_WrittenLineCount = 0;
+	m_LineCount = 0;
+}
+
+bool LogArchive::Append(const std::string_view text)
+{
+	if (!m_Writable)
+	{
+		return false;
+	}
+	if (text.empty())
+	{
+		return true;
+	}
+
+	// Every line break ends a line, and text after the last one starts a line unless it continues the open one.
+	const bool lastLineOpen = !m_OpenBlock.empty() && m_OpenBlock.back() != '\n';
+	m_LineCount += std::count(text.begin(), text.end(), '\n') + (text.back() != '\n' ? 1 : 0) - (lastLineOpen ? 1 : 0);
+	m_OpenBlock.append(text);
+
+	while (m_OpenBlock.size() > BLOCK_SIZE)
+	{
+		const size_t blockEnd = m_OpenBlock.find('\n', BLOCK_SIZE - 1);
+		if (blockEnd == std::string::npos)
+		{
+			break;
+		}
+
+		if (!WriteBlock(blockEnd + 1))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool LogArchive::ReadLines(const uint64_t firstLine, const size_t count, std::string& text) const
+{
+	text.clear();
+
+	const uint64_t endLine = std::min(firstLine + count, m_LineCount);
+	uint64_t line = firstLine;
+	while (line < endLine)
+	{
+		std::string_view blockText = m_OpenBlock;
+		uint64_t blockFirstLine = m_WrittenLineCount;
+		if (line < m_WrittenLineCount)
+		{
+			const Segment* segment;
+			const Block* block;
+			if (!FindBlock(line, segment, block))
+			{
+				return false;
+			}
+
+			if (m_ReadBlockFirstLine != block->FirstLine)
+			{
+				m_ReadBlockFirstLine = UINT64_MAX;
+				if (!ReadBlock(m_ReadFile, m_ReadSegment, *segment, *block, m_ReadBlock))
+				{
+					return false;
+				}
+				m_ReadBlockFirstLine = block->FirstLine;
+			}
+
+			blockText = m_ReadBlock;
+			blockFirstLine = block->FirstLine;
+		}
+
+		size_t pos = 0;
+		for (uint64_t skipped = blockFirstLine; skipped < line && pos < blockText.size(); ++skipped)
+		{
+			const size_t lineEnd = blockText.find('\n', pos);
+			pos = lineEnd == std::string_view::npos ? blockText.size() : lineEnd + 1;
+		}
+
+		// If the block has fewer lines than its index says, give up rather than loop forever.
+		const uint64_t lineBefore = line;
+		while (line < endLine && pos < blockText.size())
+		{
+			const size_t lineEnd = blockText.find('\n', pos);
+			const size_t next = lineEnd == std::string_view::npos ? blockText.size() : lineEnd + 1;
+			text.append(blockText.substr(pos, next - pos));
+			pos = next;
+			++line;
+		}
+		if (line == lineBefore)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+std::vector<LogSearchHit> LogArchive::Search(const LogSearchQuery& query) const
+{
+	std::vector<LogSearchHit> hits;
+	const LineMatcher matcher(query);
+	if (query.Pattern.empty() || query.MaxHits == 0 || !matcher.IsValid())
+	{
+		return hits;
+	}
+
+	// Any block with a match contains every trigram of the literal the matches have in common, so blocks missing one are skipped without being read.
+	const std::string& literal = matcher.GetLiteral();
+	std::vector<uint64_t> patternTrigrams;
+	if (literal.size() >= 3)
+	{
+		patternTrigrams.assign(TRIGRAM_WORDS, 0);
+		for (size_t i = 0; i + 2 < literal.size(); ++i)
+		{
+			const size_t bit = TrigramBit(&literal[i]);
+			patternTrigrams[bit / 64] |= (uint64_t)1 << (bit % 64);
+		}
+	}
+
+	std::vector<std::pair<const Segment*, const Block*>> candidates;
+	for (const Segment& segment : m_Segments)
+	{
+		for (const Block& block : segment.Blocks)
+		{
+			bool candidate = true;
+			if (!patternTrigrams.empty() && !block.Trigrams.empty())
+			{
+				for (size_t word = 0; word < TRIGRAM_WORDS && candidate; ++word)
+				{
+					candidate = (block.Trigrams[word] & patternTrigrams[word]) == patternTrigrams[word];
+				}
+			}
+
+			if (candidate)
+			{
+				candidates.emplace_back(&segment, &block);
+			}
+		}
+	}
+
+	// Each thread takes the next block in order, so once enough hits are found, every block before the one being taken has been taken already.
+	// Those blocks hold the first MaxHits hits between them, so nothing after them needs to be searched.
+	std::vector<std::vector<LogSearchHit>> blockHits(candidates.size());
+	std::atomic<size_t> nextCandidate = 0;
+	std::atomic<size_t> hitCount = 0;
+	const auto searchBlocks = [&]()
+	{
+		std::ifstream file;
+		const Segment* fileSegment = nullptr;
+		std::string text;
+		std::string scratch;
+		while (true)
+		{
+			const size_t i = nextCandidate++;
+			if (i >= candidates.size() || hitCount >= query.MaxHits)
+			{
+				return;
+			}
+
+			const auto [segment, block] = candidates[i];
+			if (ReadBlock(file, fileSegment, *segment, *block, text))
+			{
+				matcher.FindLines(text, block->FirstLine, query.MaxHits, blockHits[i], scratch);
+				hitCount += blockHits[i].size();
+			}
+		}
+	};
+
+	const unsigned hardwareThreads = std::thread::hardware_concurrency();
+	const size_t threadCount = std::min<size_t>(hardwareThreads == 0 ? 1 : hardwareThreads, candidates.size());
+	std::vector<std::thread> threads;
+	for (size_t i = 1; i < threadCount; ++i)
+	{
+		threads.emplace_back(searchBlocks);
+	}
+	searchBlocks();
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+
+	for (std::vector<LogSearchHit>& found : blockHits)
+	{
+		for (LogSearchHit& hit : found)
+		{
+			if (hits.size() == query.MaxHits)
+			{
+				return hits;
+			}
+			hits.push_back(std::move(hit));
+		}
+	}
+
+	// Text not yet written out is searched last, as it is the end of the log.
+	std::string scratch;
+	matcher.FindLines(m_OpenBlock, m_WrittenLineCount, query.MaxHits, hits, scratch);
+	return hits;
+}
+
+size_t LogArchive::TrigramBit(const char* const text)
+{
+	static_assert(TRIGRAM_BITS == 1 << 13, "The trigram hash gives 13 bits.");
+
+	const uint32_t trigram = (uint8_t)ToLowerAscii(text[0]) | (uint8_t)ToLowerAscii(text[1]) << 8 | (uint8_t)ToLowerAscii(text[2]) << 16;
+	return (trigram * 2654435761u) >> (32 - 13);
+}
+
+void LogArchive::IndexBlock(Block& block, const std::string_view text) const
+{
+	block.Size = text.size();
+	block.LineCount = std::count(text.begin(), text.end(), '\n') + (!text.empty() && text.back() != '\n' ? 1 : 0);
+
+	block.Trigrams.clear();
+	if (m_Options.TrigramIndex)
+	{
+		block.Trigrams.assign(TRIGRAM_WORDS, 0);
+		for (size_t i = 0; i + 2 < text.size(); ++i)
+		{
+			const size_t bit = TrigramBit(&text[i]);
+			block.Trigrams[bit / 64] |= (uint64_t)1 << (bit % 64);
+		}
+	}
+}
+
+bool LogArchive::WriteBlock(const size_t size)
+{
+	if (m_Segments.empty() || (m_Segments.back().Size > 0 && m_Segments.back().Size + size > m_Options.SegmentSize))
+	{
+		if (!m_Segments.empty())
+		{
+			WriteSegmentIndex(m_Segments.back());
+		}
+		if (!StartSegment())
+		{
+			return false;
+		}
+	}
+
+	const std::string_view text(m_OpenBlock.data(), size);
+	m_SegmentFile.write(text.data(), (std::streamsize)size);
+	m_SegmentFile.flush();
+	if (!m_SegmentFile)
+	{
+		return false;
+	}
+
+	Segment& segment = m_Segments.back();
+	Block& block = segment.Blocks.emplace_back();
+	block.Offset = segment.Size;
+	block.FirstLine = m_WrittenLineCount;
+	IndexBlock(block, text);
+
+	segment.Size += size;
+	m_WrittenLineCount += block.LineCount;
+	m_OpenBlock.erase(0, size);
+	return true;
+}
+
+bool LogArchive::StartSegment()
+{
+	m_SegmentFile.close();
+
+	Segment& segment = m_Segments.emplace_back();
+	segment.Path = m_Directory / std::format("segment-{:06}.log", m_Segments.size());
+	m_SegmentFile.open(segment.Path, std::ios::binary | std::ios::trunc);
+	if (!m_SegmentFile)
+	{
+		m_Segments.pop_back();
+		return false;
+	}
+
+	return true;
+}
+
+bool LogArchive::WriteSegmentIndex(const Segment& segment) const
+{
+	std::filesystem::path indexPath = segment.Path;
+	indexPath.replace_extension(".idx");
+	std::ofstream file(indexPath, std::ios::binary | std::ios::trunc);
+
+	const uint64_t firstLine = segment.Blocks.empty() ? 0 : segment.Blocks.front().FirstLine;
+	const uint64_t header[] = { segment.Size, segment.Blocks.size(), m_Options.TrigramIndex ? TRIGRAM_WORDS : 0 };
+	file.write(INDEX_MAGIC, sizeof(INDEX_MAGIC));
+	file.write((const char*)header, sizeof(header));
+	for (const Block& block : segment.Blocks)
+	{
+		// Line numbers are stored from the start of the segment, so the index does not depend on the segments before it.
+		const uint64_t fields[] = { block.Offset, block.FirstLine - firstLine, block.LineCount, block.Size };
+		file.write((const char*)fields, sizeof(fields));
+		file.write((const char*)block.Trigrams.data(), (std::streamsize)(block.Trigrams.size() * sizeof(uint64_t)));
+	}
+
+	return (bool)file;
+}
+
+bool LogArchive::LoadSegmentIndex(Segment& segment, uint64_t& firstLine)
+{
+	std::filesystem::path indexPath = segment.Path;
+	indexPath.replace_extension(".idx");
+
+	// An index is only used if it was written for the segment as it is now. The last segment may have been written to since, or not closed at all.
+	std::ifstream indexFile(indexPath, std::ios::binary);
+	char magic[sizeof(INDEX_MAGIC)];
+	uint64_t header[3];
+	if (indexFile.read(magic, sizeof(magic)) && std::equal(magic, magic + sizeof(magic), INDEX_MAGIC) &&
+		indexFile.read((char*)header, sizeof(header)) && header[0] == segment.Size && header[1] <= segment.Size &&
+		(header[2] == 0 || header[2] == TRIGRAM_WORDS))
+	{
+		segment.Blocks.resize(header[1]);
+		uint64_t expectedOffset = 0;
+		for (Block& block : segment.Blocks)
+		{
+			uint64_t fields[4];
+			block.Trigrams.resize(header[2]);
+			if (!indexFile.read((char*)fields, sizeof(fields)) || !indexFile.read((char*)block.Trigrams.data(), (std::streamsize)(header[2] * sizeof(uint64_t))) ||
+				fields[0] != expectedOffset)
+			{
+				segment.Blocks.clear();
+				break;
+			}
+
+			block.Offset = fields[0];
+			block.FirstLine = firstLine + fields[1];
+			block.LineCount = fields[2];
+			block.Size = fields[3];
+			expectedOffset += block.Size;
+		}
+
+		if (!segment.Blocks.empty() && expectedOffset == segment.Size)
+		{
+			firstLine = segment.Blocks.back().FirstLine + segment.Blocks.back().LineCount;
+			return true;
+		}
+		segment.Blocks.clear();
+	}
+
+	// Otherwise cut the segment into blocks just as they were written, and index them.
+	std::ifstream file(segment.Path, std::ios::binary);
+	std::string text(segment.Size, '\0');
+	if (!file.read(text.data(), (std::streamsize)text.size()))
+	{
+		return false;
+	}
+
+	size_t blockStart = 0;
+	while (blockStart < text.size())
+	{
+		const size_t lineEnd = text.size() - blockStart > BLOCK_SIZE ? text.find('\n', blockStart + BLOCK_SIZE - 1) : std::string::npos;
+		const size_t blockEnd = lineEnd == std::string::npos ? text.size() : lineEnd + 1;
+
+		Block& block = segment.Blocks.emplace_back();
+		block.Offset = blockStart;
+		block.FirstLine = firstLine;
+		IndexBlock(block, std::string_view(text).substr(blockStart, blockEnd - blockStart));
+
+		firstLine += block.LineCount;
+		blockStart = blockEnd;
+	}
+
+	return true;
+}
+
+bool LogArchive::ReadBlock(std::ifstream& file, const Segment*& fileSegment, const Segment& segment, const Block& block, std::string& text)
+{
+	if (fileSegment != &segment)
+	{
+		file.close();
+		file.clear();
+		file.open(segment.Path, std::ios::binary);
+		fileSegment = &segment;
+	}
+
+	text.resize(block.Size);
+	file.clear();
+	return file.seekg((std::streamoff)block.Offset) && file.read(text.data(), (std::streamsize)block.Size);
+}
+
+bool LogArchive::FindBlock(const uint64_t line, const Segment*& segment, const Block*& block) const
+{
+	// Find the last segment, and then the last block in it, that starts at or before the line.
+	const auto segmentAfter = std::upper_bound(m_Segments.begin(), m_Segments.end(), line,
+		[](const uint64_t line, const Segment& segment) { return !segment.Blocks.empty() && line < segment.Blocks.front().FirstLine; });
+	if (segmentAfter == m_Segments.begin() || std::prev(segmentAfter)->Blocks.empty())
+	{
+		return false;
+	}
+	segment = &*std::prev(segmentAfter);
+
+	const auto blockAfter = std::upper_bound(segment->Blocks.begin(), segment->Blocks.end(), line,
+		[](const uint64_t line, const Block& block) { return line < block.FirstLine; });
+	block = &*std::prev(blockAfter);
+	return line < block->FirstLine + block->LineCount;
+}
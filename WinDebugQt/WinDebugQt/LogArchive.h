@@ -0,0 +1,156 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// What to search a LogArchive for.
+struct LogSearchQuery
+{
+	// A substring to find, or an ECMAScript regular expression if Regex is set. Either way it is matched against one line at a time.
+	std::string Pattern;
+	bool Regex = false;
+
+	// Only applies to ASCII letters.
+	bool CaseSensitive = true;
+
+	// The search stops once it has found this many matching lines.
+	size_t MaxHits = 1000;
+};
+
+// A line that matched a search.
+struct LogSearchHit
+{
+	uint64_t Line;
+
+	// The line, without its line break.
+	std::string Text;
+};
+
+/*
+* A log persisted to disk as append-only segment files, which can be read back by line and searched without the GUI.
+* Each segment is made up of blocks of whole lines. The index keeps where each block starts and the number of its first line, so any line can be found by
+* reading a single block, and optionally which trigrams appear in each block, so a substring search only reads the blocks that could contain it.
+* The blocks a search has to read are shared out between a thread per core.
+* When a segment is full, its index is written next to it, so an archive can be opened again later without reading all of it.
+* Not thread safe. Appending, reading and searching all have to happen on the same thread.
+*/
+class LogArchive
+	final
+{
+public:
+	struct Options
+	{
+		// A new segment is started once the current one reaches this size.
+		uint64_t SegmentSize = 64 * 1024 * 1024;
+
+		// Whether to index the trigrams in each block. This takes about 1 KB for every 64 KB of log.
+		bool TrigramIndex = true;
+
+		// Whether to delete the archive when it is closed.
+		bool RemoveOnClose = false;
+	};
+
+	LogArchive() = default;
+	LogArchive(const LogArchive&) = delete;
+	LogArchive& operator=(const LogArchive&) = delete;
+	~LogArchive() { Close(); }
+
+	// Starts a new, empty archive in directory, deleting any archive already there.
+	bool Create(const std::filesystem::path& directory, const Options& options);
+
+	// Opens an archive written before, to read and search it. Nothing can be appended to it.
+	bool Open(const std::filesystem::path& directory, const Options& options);
+
+	// Writes out anything not yet written, along with the index of the last segment, and closes the archive.
+	void Close();
+
+	bool IsOpen() const { return !m_Directory.empty(); }
+
+	// Appends text to the log. Text after the last newline is an open line, which the next append continues. Returns false if it could not be written.
+	bool Append(const std::string_view text);
+
+	// The number of lines in the log, counting an open last line.
+	uint64_t GetLineCount() const { return m_LineCount; }
+
+	// Reads count lines starting at firstLine into text, along with their line breaks. Fewer are read if the log ends first.
+	bool ReadLines(const uint64_t firstLine, const size_t count, std::string& text) const;
+
+	// Finds the lines that match query, in order.
+	std::vector<LogSearchHit> Search(const LogSearchQuery& query) const;
+
+private:
+	// Blocks are cut at the first line break past this size.
+	static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+	// Each block's trigrams are hashed into a bitmap of this many bits.
+	static constexpr size_t TRIGRAM_BITS = 8192;
+	static constexpr size_t TRIGRAM_WORDS = TRIGRAM_BITS / 64;
+
+	struct Block
+	{
+		uint64_t Offset;
+		uint64_t FirstLine;
+		uint64_t LineCount;
+		uint64_t Size;
+
+		// TRIGRAM_WORDS words of the trigram bitmap, if the trigram index is kept.
+		std::vector<uint64_t> Trigrams;
+	};
+
+	struct Segment
+	{
+		std::filesystem::path Path;
+		uint64_t Size = 0;
+		std::vector<Block> Blocks;
+	};
+
+	// The bit for the trigram ending at text[2] in a trigram bitmap, ignoring ASCII case.
+	static size_t TrigramBit(const char* const text);
+
+	// Fills in the size, line count and trigrams of a block from its text.
+	void IndexBlock(Block& block, const std::string_view text) const;
+
+	// Writes out the text of the open block from the start up to size, and indexes it. It has to end in a line break unless it is the last block.
+	bool WriteBlock(const size_t size);
+
+	// Starts a new segment file to write blocks to.
+	bool StartSegment();
+
+	// Writes the index of a segment next to it.
+	bool WriteSegmentIndex(const Segment& segment) const;
+
+	// Reads the index of a segment if it was written, or indexes the segment file itself if not.
+	bool LoadSegmentIndex(Segment& segment, uint64_t& firstLine);
+
+	// Reads the text of a block from its segment file, first opening the segment in file if fileSegment says it has another one open.
+	static bool ReadBlock(std::ifstream& file, const Segment*& fileSegment, const Segment& segment, const Block& block, std::string& text);
+
+	// Finds the block that line is in, in which case segment and block are set. The open block is not included.
+	bool FindBlock(const uint64_t line, const Segment*& segment, const Block*& block) const;
+
+	std::filesystem::path m_Directory;
+	Options m_Options;
+	bool m_Writable = false;
+
+	// A deque, so segments stay put as more are added.
+	std::deque<Segment> m_Segments;
+	std::ofstream m_SegmentFile;
+
+	// Text appended since the last block was written, which starts at line m_WrittenLineCount. Only whole blocks are written, apart from on Close.
+	std::string m_OpenBlock;
+	uint64_t m_WrittenLineCount = 0;
+
+	uint64_t m_LineCount = 0;
+
+	// Used by ReadLines, which tends to be called for lines in the same block over and over.
+	// The last block read is kept along with the first line in it, or UINT64_MAX if there is none.
+	mutable std::ifstream m_ReadFile;
+	mutable const Segment* m_ReadSegment = nullptr;
+	mutable std::string m_ReadBlock;
+	mutable uint64_t m_ReadBlockFirstLine = UINT64_MAX;
+};
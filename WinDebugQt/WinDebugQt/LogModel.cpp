@@ -0,0 +1,200 @@
+#include "LogModel.h"
+
+#include <algorithm>
+#include <climits>
+
+LogModel::LogModel(const std::filesystem::path& archiveDirectory, const size_t maxRetainedLines, QObject* const parent)
+	: QAbstractListModel(parent),
+	m_MaxRetainedLines(maxRetainedLines > MIN_RETAINED_LINES ? maxRetainedLines : MIN_RETAINED_LINES),
+	m_ArchiveDirectory(archiveDirectory)
+{
+	CreateArchive();
+}
+
+void LogModel::Append(const std::string_view text)
+{
+	if (text.empty())
+	{
+		return;
+	}
+
+	m_Archived = m_Archived && m_Archive.Append(text);
+
+	const size_t lineCount = m_SpilledLines + m_LineStarts.size();
+	size_t pos = 0;
+
+	// Finish off the open line first.
+	if (m_LastLineOpen)
+	{
+		const size_t lineEnd = text.find('\n');
+		pos = lineEnd == std::string_view::npos ? text.size() : lineEnd + 1;
+		m_Text.append(text.substr(0, pos));
+		m_LastLineOpen = lineEnd == std::string_view::npos;
+
+		const QModelIndex lastLine = index((int)std::min<size_t>(lineCount - 1, INT_MAX));
+		emit dataChanged(lastLine, lastLine);
+	}
+
+	if (pos < text.size())
+	{
+		const std::string_view rest = text.substr(pos);
+		const size_t newLineCount = std::count(rest.begin(), rest.end(), '\n') + (rest.back() != '\n' ? 1 : 0);
+
+		// The view only has room for INT_MAX rows, so any lines past that are kept but never shown.
+		const bool shown = lineCount < INT_MAX;
+		if (shown)
+		{
+			beginInsertRows(QModelIndex(), (int)lineCount, (int)std::min<size_t>(lineCount + newLineCount - 1, INT_MAX - 1));
+		}
+
+		size_t lineStart = 0;
+		while (lineStart < rest.size())
+		{
+			m_LineStarts.push_back(m_TextBase + m_Text.size() + lineStart);
+			const size_t lineEnd = rest.find('\n', lineStart);
+			lineStart = lineEnd == std::string_view::npos ? rest.size() : lineEnd + 1;
+		}
+		m_Text.append(rest);
+		m_LastLineOpen = rest.back() != '\n';
+
+		if (shown)
+		{
+			endInsertRows();
+		}
+	}
+
+	// Drop a quarter of the cap at a time, so the lines kept in memory are only moved up every so often.
+	if (m_LineStarts.size() > m_MaxRetainedLines)
+	{
+		Spill(m_LineStarts.size() - m_MaxRetainedLines + m_MaxRetainedLines / 4);
+	}
+}
+
+void LogModel::Clear()
+{
+	beginResetModel();
+
+	m_Text.clear();
+	m_TextBase = 0;
+	m_LineStarts.clear();
+	m_LastLineOpen = false;
+
+	CreateArchive();
+	m_SpilledLines = 0;
+	for (SpillBlock& block : m_SpillCache)
+	{
+		block = {};
+	}
+
+	endResetModel();
+}
+
+std::vector<LogSearchHit> LogModel::Search(const LogSearchQuery& query) const
+{
+	return m_Archived ? m_Archive.Search(query) : std::vector<LogSearchHit>();
+}
+
+int LogModel::rowCount(const QModelIndex& parent) const
+{
+	return parent.isValid() ? 0 : (int)std::min<size_t>(m_SpilledLines + m_LineStarts.size(), INT_MAX);
+}
+
+QVariant LogModel::data(const QModelIndex& index, const int role) const
+{
+	if (role != Qt::DisplayRole || !index.isValid())
+	{
+		return QVariant();
+	}
+
+	std::string_view line = GetLine(index.row());
+	while (!line.empty() && (line.back() == '\n' || line.back() == '\r'))
+	{
+		line.remove_suffix(1);
+	}
+
+	return QString::fromUtf8(line.data(), (qsizetype)line.size());
+}
+
+std::string_view LogModel::GetLine(const size_t line) const
+{
+	if (line >= m_SpilledLines)
+	{
+		const size_t retainedLine = line - m_SpilledLines;
+		if (retainedLine >= m_LineStarts.size())
+		{
+			return std::string_view();
+		}
+
+		const size_t start = m_LineStarts[retainedLine] - m_TextBase;
+		const size_t end = retainedLine + 1 < m_LineStarts.size() ? m_LineStarts[retainedLine + 1] - m_TextBase : m_Text.size();
+		return std::string_view(m_Text).substr(start, end - start);
+	}
+
+	const SpillBlock* const block = ReadSpillBlock(line / SPILL_BLOCK_LINES);
+	const size_t blockLine = line % SPILL_BLOCK_LINES;
+	if (!block || blockLine >= block->LineStarts.size())
+	{
+		return std::string_view();
+	}
+
+	const size_t start = block->LineStarts[blockLine];
+	const size_t end = blockLine + 1 < block->LineStarts.size() ? block->LineStarts[blockLine + 1] : block->Text.size();
+	return std::string_view(block->Text).substr(start, end - start);
+}
+
+const LogModel::SpillBlock* LogModel::ReadSpillBlock(const size_t block) const
+{
+	// The last block may have had more lines dropped into it since it was read in, in which case it is read again.
+	const size_t blockLineCount = std::min(SPILL_BLOCK_LINES, m_SpilledLines - block * SPILL_BLOCK_LINES);
+	for (const SpillBlock& cached : m_SpillCache)
+	{
+		if (cached.Block == block && cached.LineStarts.size() == blockLineCount)
+		{
+			return &cached;
+		}
+	}
+
+	SpillBlock& slot = m_SpillCache[m_NextSpillCacheSlot];
+	m_NextSpillCacheSlot = (m_NextSpillCacheSlot + 1) % SPILL_CACHE_SIZE;
+	slot = {};
+
+	if (!m_Archive.ReadLines(block * SPILL_BLOCK_LINES, blockLineCount, slot.Text))
+	{
+		slot.Text.clear();
+		return nullptr;
+	}
+
+	size_t lineStart = 0;
+	while (lineStart < slot.Text.size())
+	{
+		slot.LineStarts.push_back(lineStart);
+		const size_t lineEnd = slot.Text.find('\n', lineStart);
+		lineStart = lineEnd == std::string::npos ? slot.Text.size() : lineEnd + 1;
+	}
+
+	slot.Block = block;
+	return &slot;
+}
+
+void LogModel::Spill(const size_t lineCount)
+{
+	// If anything failed to be archived, everything just stays in memory.
+	if (!m_Archived)
+	{
+		return;
+	}
+
+	// Only whole lines are dropped. The open line is always the last, and is never dropped as a quarter of the cap is always kept.
+	const uint64_t spillEnd = m_LineStarts[lineCount];
+	m_Text.erase(0, (size_t)(spillEnd - m_TextBase));
+	m_LineStarts.erase(m_LineStarts.begin(), m_LineStarts.begin() + lineCount);
+	m_TextBase = spillEnd;
+	m_SpilledLines += lineCount;
+}
+
+void LogModel::CreateArchive()
+{
+	LogArchive::Options options;
+	options.RemoveOnClose = true;
+	m_Archived = m_Archive.Create(m_ArchiveDirectory, options);
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <QtCore/QAbstractListModel>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "LogArchive.h"
+
+/*
+* A log as a list of lines, for a view to show only the lines that are visible.
+* Every line is found through an index of where it starts, so looking one up costs the same however long the log gets.
+* Everything appended is also written to a LogArchive, which the log can be searched through. Only the newest lines are kept in memory as well.
+* Once there are more than the cap, the oldest are dropped from memory, and read back from the archive a block at a time when scrolled to.
+*/
+class LogModel : public QAbstractListModel
+{
+public:
+	static constexpr size_t DEFAULT_MAX_RETAINED_LINES = 10000;
+	static constexpr size_t MIN_RETAINED_LINES = 4;
+
+	// The log is archived to archiveDirectory, which is deleted along with the log.
+	LogModel(const std::filesystem::path& archiveDirectory, const size_t maxRetainedLines = DEFAULT_MAX_RETAINED_LINES, QObject* const parent = nullptr);
+
+	// Appends text to the log. Text after the last newline is left as an open line, which the next append continues.
+	void Append(const std::string_view text);
+
+	// Discards every line, including the ones archived to disk.
+	void Clear();
+
+	// Finds the lines that match query, in order. Lines can only be searched once they are archived, so nothing is found if archiving failed.
+	std::vector<LogSearchHit> Search(const LogSearchQuery& query) const;
+
+	virtual int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+	virtual QVariant data(const QModelIndex& index, const int role = Qt::DisplayRole) const override;
+
+private:
+	// Lines dropped from memory are read back from the archive this many at a time.
+	static constexpr size_t SPILL_BLOCK_LINES = 256;
+
+	// The number of blocks of dropped lines kept read in, so scrolling around one spot does not read them again.
+	static constexpr size_t SPILL_CACHE_SIZE = 4;
+
+	// A block of lines dropped from memory, read back from the archive.
+	struct SpillBlock
+	{
+		size_t Block = SIZE_MAX;
+		std::string Text;
+		std::vector<size_t> LineStarts;
+	};
+
+	// Gets a line, including its line break. Lines dropped from memory are read back from the archive, and are only valid until the next call.
+	std::string_view GetLine(const size_t line) const;
+
+	// Reads a block of dropped lines back in, or returns the one already read in. Null if the archive cannot be read.
+	const SpillBlock* ReadSpillBlock(const size_t block) const;
+
+	// Drops the oldest lineCount lines from memory, as long as they are all archived.
+	void Spill(const size_t lineCount);
+
+	// Starts a new, empty archive.
+	void CreateArchive();
+
+	const size_t m_MaxRetainedLines;
+
+	// Holds every line of the log, as long as m_Archived is set. It is cleared if anything fails to be archived, after which nothing more is dropped from memory.
+	const std::filesystem::path m_ArchiveDirectory;
+	LogArchive m_Archive;
+	bool m_Archived = false;
+
+	// The lines kept in memory. They start at m_TextBase in the whole text of the log, as everything before that has been dropped.
+	std::string m_Text;
+	uint64_t m_TextBase = 0;
+
+	// Where each line kept in memory starts in the whole text of the log.
+	std::vector<uint64_t> m_LineStarts;
+
+	// Whether the last line has yet to end with a line break.
+	bool m_LastLineOpen = false;
+
+	// The number of lines dropped from memory, which come before the ones kept.
+	size_t m_SpilledLines = 0;
+
+	mutable SpillBlock m_SpillCache[SPILL_CACHE_SIZE];
+	mutable size_t m_NextSpillCacheSlot = 0;
+};
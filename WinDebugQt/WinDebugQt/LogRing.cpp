@@ -0,0 +1,133 @@
+#include "LogRing.h"
+
+#include <cstring>
+
+LogRing::LogRing(const size_t memoryCap, const OverflowPolicy policy, const size_t chunkSize)
+	: m_ChunkSize(chunkSize),
+	m_MaxChunks(memoryCap / chunkSize > 2 ? memoryCap / chunkSize : 2),
+	m_Policy(policy),
+	m_Queued(std::make_unique<std::atomic<Chunk*>[]>(m_MaxChunks)),
+	m_Free(std::make_unique<std::atomic<Chunk*>[]>(m_MaxChunks))
+{
+	m_Chunks.reserve(m_MaxChunks);
+}
+
+bool LogRing::Write(std::string_view text)
+{
+	while (!text.empty())
+	{
+		if (!m_Current)
+		{
+			m_Current = NextChunk();
+			if (!m_Current)
+			{
+				m_DroppedBytes.fetch_add(text.size(), std::memory_order_relaxed);
+				return false;
+			}
+		}
+
+		// Move on once the chunk is full or the consumer has taken it.
+		size_t size = m_Current->m_State.load(std::memory_order_acquire);
+		if ((size & TAKEN) || size == m_ChunkSize)
+		{
+			m_Current = nullptr;
+			continue;
+		}
+
+		// The consumer only ever reads up to the committed size, so the bytes after it are ours to write.
+		// If the consumer takes the chunk before they are committed, they are written again into the next one.
+		const size_t length = text.size() < m_ChunkSize - size ? text.size() : m_ChunkSize - size;
+		memcpy(m_Current->m_Data.get() + size, text.data(), length);
+		if (!m_Current->m_State.compare_exchange_strong(size, size + length, std::memory_order_release, std::memory_order_relaxed))
+		{
+			m_Current = nullptr;
+			continue;
+		}
+
+		text.remove_prefix(length);
+	}
+
+	return true;
+}
+
+const LogRing::Chunk* LogRing::Acquire()
+{
+	// The newest chunk may be one the producer has only just started on. Leave it be until it has text in it, rather than make the producer start another.
+	const uint64_t head = m_QueuedHead.load(std::memory_order_acquire);
+	if (head == m_QueuedTail.load(std::memory_order_acquire) ||
+		(m_Queued[head % m_MaxChunks].load(std::memory_order_relaxed)->m_State.load(std::memory_order_relaxed) & ~TAKEN) == 0)
+	{
+		return nullptr;
+	}
+
+	Chunk* const chunk = PopQueued();
+	if (!chunk)
+	{
+		return nullptr;
+	}
+
+	chunk->m_TakenSize = chunk->m_State.fetch_or(TAKEN, std::memory_order_acq_rel) & ~TAKEN;
+	return chunk;
+}
+
+void LogRing::Release(const Chunk* const chunk)
+{
+	const uint64_t tail = m_FreeTail.load(std::memory_order_relaxed);
+	m_Free[tail % m_MaxChunks].store(const_cast<Chunk*>(chunk), std::memory_order_relaxed);
+	m_FreeTail.store(tail + 1, std::memory_order_release);
+}
+
+LogRing::Chunk* LogRing::NextChunk()
+{
+	Chunk* chunk = nullptr;
+
+	// Reuse a chunk the consumer has handed back, or allocate another while under the cap.
+	const uint64_t freeHead = m_FreeHead.load(std::memory_order_relaxed);
+	if (freeHead != m_FreeTail.load(std::memory_order_acquire))
+	{
+		chunk = m_Free[freeHead % m_MaxChunks].load(std::memory_order_relaxed);
+		m_FreeHead.store(freeHead + 1, std::memory_order_release);
+	}
+	else if (m_Chunks.size() < m_MaxChunks)
+	{
+		std::unique_ptr<Chunk>& allocated = m_Chunks.emplace_back(std::make_unique<Chunk>());
+		allocated->m_Data = std::make_unique_for_overwrite<char[]>(m_ChunkSize);
+		chunk = allocated.get();
+	}
+	else if (m_Policy == OverflowPolicy::DropOldest)
+	{
+		// Everything is in use, so throw away the oldest text the consumer has not taken yet.
+		chunk = PopQueued();
+		if (chunk)
+		{
+			m_DroppedBytes.fetch_add(chunk->m_State.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		}
+	}
+
+	if (chunk)
+	{
+		// There are never more chunks than queue slots, so there is always room to queue it.
+		chunk->m_State.store(0, std::memory_order_relaxed);
+		const uint64_t tail = m_QueuedTail.load(std::memory_order_relaxed);
+		m_Queued[tail % m_MaxChunks].store(chunk, std::memory_order_relaxed);
+		m_QueuedTail.store(tail + 1, std::memory_order_release);
+	}
+
+	return chunk;
+}
+
+LogRing::Chunk* LogRing::PopQueued()
+{
+	uint64_t head = m_QueuedHead.load(std::memory_order_acquire);
+	while (head != m_QueuedTail.load(std::memory_order_acquire))
+	{
+		// The slot can only be reused once the head has moved past it, in which case the CAS fails and the read is thrown away.
+		Chunk* const chunk = m_Queued[head % m_MaxChunks].load(std::memory_order_relaxed);
+		if (m_QueuedHead.compare_exchange_weak(head, head + 1, std::memory_order_acq_rel, std::memory_order_acquire))
+		{
+			return chunk;
+		}
+	}
+
+	return nullptr;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+/*
+* Carries log text from one producer thread to one consumer thread without locks, within a fixed memory cap.
+* Text is written into chunks, which are queued up for the consumer as soon as the producer starts on them, so the consumer never waits for one to fill.
+* The consumer takes whole chunks by pointer, reads them and hands them back to be reused, so no text is copied between the two.
+* If the producer would go over the memory cap, the policy decides whether the oldest unread text or the new text is dropped. Either way it is counted.
+*/
+class LogRing
+	final
+{
+public:
+	enum class OverflowPolicy
+	{
+		DropOldest,		// Unread chunks are discarded, oldest first, to make room for new text.
+		Backpressure,	// New text is refused, and Write returns false so the producer can hold off.
+	};
+
+	// A chunk of log text taken by the consumer.
+	class Chunk
+	{
+	public:
+		// The text in the chunk as of when the consumer took it.
+		std::string_view GetText() const { return std::string_view(m_Data.get(), m_TakenSize); }
+
+	private:
+		friend class LogRing;
+
+		std::unique_ptr<char[]> m_Data;
+
+		// The number of bytes the producer has committed, with TAKEN set once the consumer takes the chunk. The producer stops writing to it from then on.
+		std::atomic<size_t> m_State = 0;
+
+		// Only used by the consumer.
+		size_t m_TakenSize = 0;
+	};
+
+	static constexpr size_t DEFAULT_CHUNK_SIZE = 16 * 1024;
+	static constexpr size_t DEFAULT_MEMORY_CAP = 1024 * 1024;
+
+	// memoryCap is rounded down to a whole number of chunks, and is at least two of them.
+	LogRing(const size_t memoryCap, const OverflowPolicy policy, const size_t chunkSize = DEFAULT_CHUNK_SIZE);
+	LogRing(const LogRing&) = delete;
+	LogRing& operator=(const LogRing&) = delete;
+
+	/*
+	* Called by the producer to add text to the log.
+	* Returns false if any of it was dropped, which only happens with the Backpressure policy or if the consumer is holding every chunk.
+	*/
+	bool Write(std::string_view text);
+
+	/*
+	* Called by the consumer to take the oldest chunk that has text in it, or null if there is none. The chunk must be handed back with Release once read.
+	* Every chunk must be released before the ring is destroyed.
+	*/
+	const Chunk* Acquire();
+
+	// Called by the consumer to hand back a chunk taken by Acquire.
+	void Release(const Chunk* const chunk);
+
+	// The total number of bytes written but never read, due to the memory cap.
+	uint64_t GetDroppedBytes() const { return m_DroppedBytes.load(std::memory_order_relaxed); }
+
+private:
+	static constexpr size_t TAKEN = (size_t)1 << (sizeof(size_t) * 8 - 1);
+
+	// Called by the producer to get an empty chunk to write into, and queue it up for the consumer. Null if none can be had within the memory cap.
+	Chunk* NextChunk();
+
+	// Pops the oldest queued chunk. Both the consumer and the producer (when dropping the oldest text) pop, so the head is advanced with a CAS.
+	Chunk* PopQueued();
+
+	const size_t m_ChunkSize;
+	const size_t m_MaxChunks;
+	const OverflowPolicy m_Policy;
+
+	// Every chunk allocated so far, which is at most m_MaxChunks. Only the producer allocates.
+	std::vector<std::unique_ptr<Chunk>> m_Chunks;
+
+	// The chunk the producer is writing into. It is also queued, unless the consumer has taken it.
+	Chunk* m_Current = nullptr;
+
+	// Chunks queued up for the consumer, in the order they were started. The producer pushes at the tail; both sides pop at the head.
+	// Indices only ever increase, so a slot is m_Queued[index % m_MaxChunks].
+	std::unique_ptr<std::atomic<Chunk*>[]> m_Queued;
+	alignas(64) std::atomic<uint64_t> m_QueuedHead = 0;
+	alignas(64) std::atomic<uint64_t> m_QueuedTail = 0;
+
+	// Chunks the consumer has handed back for reuse. The consumer pushes at the tail and the producer pops at the head.
+	std::unique_ptr<std::atomic<Chunk*>[]> m_Free;
+	alignas(64) std::atomic<uint64_t> m_FreeHead = 0;
+	alignas(64) std::atomic<uint64_t> m_FreeTail = 0;
+
+	std::atomic<uint64_t> m_DroppedBytes = 0;
+};
@@ -0,0 +1,106 @@
+#include "OutputTokenizer.h"
+
+void OutputTokenizer::AddUserPattern(const std::string& pattern)
+{
+	m_UserPatterns.emplace_back(pattern, std::regex::ECMAScript | std::regex::optimize);
+}
+
+bool OutputTokenizer::Scan(std::string_view pending, size_t& frameLength, int& frameType)
+{
+	const bool hasNewOutput = m_ScanIndex < pending.size();
+	for (size_t i = m_ScanIndex; i < pending.size(); ++i)
+	{
+		const char c = pending[i];
+		if (c == '\n')
+		{
+			frameLength = i + 1;
+			frameType = FRAME_TYPE_LINE;
+			Reset();
+			return true;
+		}
+
+		const bool isDigit = c >= '0' && c <= '9';
+		switch (m_PromptState)
+		{
+			case PROMPT_STATE_START:
+			{
+				m_PromptState = isDigit ? PROMPT_STATE_DIGITS : PROMPT_STATE_REJECTED;
+				break;
+			}
+			case PROMPT_STATE_DIGITS:
+			{
+				if (c == ':')
+				{
+					m_PromptState = PROMPT_STATE_COLON;
+				}
+				else if (c == '>')
+				{
+					m_PromptState = PROMPT_STATE_ARROW;
+				}
+				else if (!isDigit)
+				{
+					m_PromptState = PROMPT_STATE_REJECTED;
+				}
+				break;
+			}
+			case PROMPT_STATE_COLON:
+			{
+				m_PromptState = isDigit ? PROMPT_STATE_THREAD_DIGITS : PROMPT_STATE_REJECTED;
+				break;
+			}
+			case PROMPT_STATE_THREAD_DIGITS:
+			{
+				if (c == '>')
+				{
+					m_PromptState = PROMPT_STATE_ARROW;
+				}
+				else if (!isDigit)
+				{
+					m_PromptState = PROMPT_STATE_REJECTED;
+				}
+				break;
+			}
+			case PROMPT_STATE_ARROW:
+			{
+				if (c == ' ')
+				{
+					frameLength = i + 1;
+					frameType = FRAME_TYPE_PROMPT;
+					Reset();
+					return true;
+				}
+				m_PromptState = PROMPT_STATE_REJECTED;
+				break;
+			}
+			case PROMPT_STATE_REJECTED:
+			{
+				break;
+			}
+		}
+	}
+
+	m_ScanIndex = pending.size();
+
+	// Nothing built in ended the frame, so check whether the output stopped on something a user pattern is waiting for.
+	if (hasNewOutput)
+	{
+		for (size_t patternIndex = 0; patternIndex < m_UserPatterns.size(); ++patternIndex)
+		{
+			if (std::regex_match(pending.begin(), pending.end(), m_UserPatterns[patternIndex]))
+			{
+				frameLength = pending.size();
+				frameType = FRAME_TYPE_USER_PATTERN + (int)patternIndex;
+				Reset();
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+void OutputTokenizer::Reset()
+{
+	m_ScanIndex = 0;
+	m_PromptState = PROMPT_STATE_START;
+}
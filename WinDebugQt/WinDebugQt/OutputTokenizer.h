@@ -0,0 +1,55 @@
+#pragma once
+
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+* Splits the output of a child process into frames: full lines, and CDB prompts which are not followed by a newline.
+* Scan state is kept between calls, so each byte of output is only examined once no matter how many reads it takes to arrive.
+* The prompt format is an optional one or more numbers followed by a colon, then a definite one or more numbers followed by "> ".
+*/
+class OutputTokenizer
+{
+public:
+	enum FrameType
+	{
+		FRAME_TYPE_LINE = 0,
+		FRAME_TYPE_PROMPT,
+		FRAME_TYPE_USER_PATTERN, // User pattern i is reported as FRAME_TYPE_USER_PATTERN + i.
+	};
+
+	/*
+	* Adds an extra regex stop pattern. The pattern is compiled once here.
+	* User patterns are only tested against an unterminated frame once all pending output has been scanned,
+	* which is where a child process stops when it is waiting on input (such as a question that has no trailing newline).
+	*/
+	void AddUserPattern(const std::string& pattern);
+
+	/*
+	* Scans pending output, which must start at the beginning of the current frame, continuing from where the last call left off.
+	* Returns true and sets frameLength and frameType if a frame ends within pending. The scan state is then reset for the next frame.
+	* Returns false if pending holds no full frame yet; the next call must pass the same data with anything newly read appended.
+	*/
+	bool Scan(std::string_view pending, size_t& frameLength, int& frameType);
+
+	// Forgets any partially scanned frame.
+	void Reset();
+
+private:
+	// Position within the prompt pattern of the characters scanned so far in the current frame.
+	enum PromptState
+	{
+		PROMPT_STATE_START = 0,		// Nothing scanned yet.
+		PROMPT_STATE_DIGITS,		// One or more numbers.
+		PROMPT_STATE_COLON,			// Numbers followed by a colon.
+		PROMPT_STATE_THREAD_DIGITS,	// Numbers after the colon.
+		PROMPT_STATE_ARROW,			// The > ending the numbers.
+		PROMPT_STATE_REJECTED,		// The frame cannot be a prompt; only a newline can end it.
+	};
+
+	size_t m_ScanIndex = 0; // Index in the current frame of the next char to scan.
+	PromptState m_PromptState = PROMPT_STATE_START;
+	std::vector<std::regex> m_UserPatterns;
+};
@@ -0,0 +1,326 @@
+#include "PosixProcess.h"
+
+#ifdef __linux__
+
+#include <cerrno>
+#include <cstdint>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+// Reports a failed call along with errno's description, the way WinAssert reports GetLastError's. Returns ok.
+static bool PosixAssert(const bool ok, const char* const function)
+{
+	if (!ok)
+	{
+		std::fprintf(stderr, "%s failed with error %d: %s\n", function, errno, strerror(errno));
+	}
+	return ok;
+}
+
+static void CloseFd(int& fd)
+{
+	if (fd != -1)
+	{
+		close(fd);
+		fd = -1;
+	}
+}
+
+bool PosixProcess::Start(const char* const* argv)
+{
+	if (m_Pid)
+	{
+		return true;
+	}
+
+	// Both pipes are made close-on-exec, so neither the child nor anything else we spawn holds on to our ends.
+	// The child's ends are duplicated onto its stdin, stdout and stderr, which clears the flag on them.
+	int stdInPipe[2];
+	int stdOutPipe[2];
+	if (!PosixAssert(pipe2(stdInPipe, O_CLOEXEC) == 0, "Stdin pipe2"))
+	{
+		return false;
+	}
+	if (!PosixAssert(pipe2(stdOutPipe, O_CLOEXEC) == 0, "Stdout pipe2"))
+	{
+		close(stdInPipe[0]);
+		close(stdInPipe[1]);
+		return false;
+	}
+	m_ChildStdInWr = stdInPipe[1];
+	m_ChildStdOutRd = stdOutPipe[0];
+
+	// Only our ends are non-blocking. The child sees ordinary blocking pipes.
+	// A blocking end would stall the poller's whole thread on one child, so the child is not started without them.
+	if (!PosixAssert(fcntl(m_ChildStdInWr, F_SETFL, O_NONBLOCK) == 0, "Stdin fcntl")
+		|| !PosixAssert(fcntl(m_ChildStdOutRd, F_SETFL, O_NONBLOCK) == 0, "Stdout fcntl"))
+	{
+		close(stdInPipe[0]);
+		close(stdOutPipe[1]);
+		CloseFd(m_ChildStdInWr);
+		CloseFd(m_ChildStdOutRd);
+		return false;
+	}
+
+	posix_spawn_file_actions_t fileActions;
+	posix_spawn_file_actions_init(&fileActions);
+	posix_spawn_file_actions_adddup2(&fileActions, stdInPipe[0], STDIN_FILENO);
+	posix_spawn_file_actions_adddup2(&fileActions, stdOutPipe[1], STDOUT_FILENO);
+	posix_spawn_file_actions_adddup2(&fileActions, stdOutPipe[1], STDERR_FILENO);
+
+	const int error = posix_spawnp(&m_Pid, argv[0], &fileActions, nullptr, const_cast<char* const*>(argv), environ);
+	posix_spawn_file_actions_destroy(&fileActions);
+
+	// Close the ends of the pipes only the child needs.
+	// If they are not closed, there is no way to recognize that the child process has ended.
+	close(stdInPipe[0]);
+	close(stdOutPipe[1]);
+
+	if (error)
+	{
+		errno = error;
+		PosixAssert(false, "posix_spawnp");
+		m_Pid = 0;
+		CloseFd(m_ChildStdInWr);
+		CloseFd(m_ChildStdOutRd);
+		return false;
+	}
+
+	return true;
+}
+
+void PosixProcess::Stop()
+{
+	Terminate();
+	Wait();
+
+	CloseFd(m_ChildStdInWr);
+	CloseFd(m_ChildStdOutRd);
+
+	m_Buffer.Clear();
+	m_FrameLength = 0;
+}
+
+void PosixProcess::Terminate()
+{
+	if (m_Pid)
+	{
+		kill(m_Pid, SIGKILL);
+	}
+}
+
+bool PosixProcess::Write(const std::string_view str)
+{
+	if (m_ChildStdInWr == -1)
+	{
+		return false;
+	}
+
+	// Commands are short, so the pipe is almost never full. When it is, wait for the child to catch up rather than queueing here.
+	size_t written = 0;
+	while (written < str.size())
+	{
+		const ssize_t result = write(m_ChildStdInWr, str.data() + written, str.size() - written);
+		if (result >= 0)
+		{
+			written += result;
+		}
+		else if (errno == EAGAIN)
+		{
+			pollfd writable = { m_ChildStdInWr, POLLOUT, 0 };
+			poll(&writable, 1, -1);
+		}
+		else if (errno != EINTR)
+		{
+			// A broken pipe means the process has exited, which is not worth reporting.
+			if (errno != EPIPE)
+			{
+				PosixAssert(false, "write");
+			}
+			return false;
+		}
+	}
+
+	return true;
+}
+
+PosixProcess::ReadStatus PosixProcess::Read(std::string_view& received)
+{
+	if (m_ChildStdOutRd == -1)
+	{
+		return ReadStatus::Closed;
+	}
+
+	// Release the frame handed out last, so its space can be reused for this read.
+	m_Buffer.Consume(m_FrameLength);
+	m_FrameLength = 0;
+
+	// A read on a pipe returns as soon as any data is there, so offer it plenty of room and take whatever comes.
+	ssize_t bytesRead;
+	do
+	{
+		bytesRead = read(m_ChildStdOutRd, m_Buffer.PrepareWrite(MIN_READ_SIZE), MIN_READ_SIZE);
+	} while (bytesRead < 0 && errno == EINTR);
+
+	if (bytesRead < 0)
+	{
+		if (errno == EAGAIN)
+		{
+			return ReadStatus::WouldBlock;
+		}
+		PosixAssert(false, "read");
+		return ReadStatus::Failed;
+	}
+	if (bytesRead == 0)
+	{
+		return ReadStatus::Closed;
+	}
+
+	m_Buffer.CommitWrite(bytesRead);
+
+	const std::string_view unconsumed = m_Buffer.Unconsumed();
+	received = unconsumed.substr(unconsumed.size() - bytesRead);
+	return ReadStatus::Read;
+}
+
+bool PosixProcess::NextFrame(std::string_view& outFrame, OutputTokenizer& tokenizer, int& frameType)
+{
+	// Release the frame handed out by the last call.
+	m_Buffer.Consume(m_FrameLength);
+	m_FrameLength = 0;
+
+	// The tokenizer remembers how far it got last time, so only the new data is scanned.
+	const std::string_view unconsumed = m_Buffer.Unconsumed();
+	size_t frameLength;
+	if (tokenizer.Scan(unconsumed, frameLength, frameType))
+	{
+		outFrame = unconsumed.substr(0, frameLength);
+		m_FrameLength = frameLength;
+		return true;
+	}
+
+	return false;
+}
+
+int PosixProcess::Wait()
+{
+	if (!m_Pid)
+	{
+		return -1;
+	}
+
+	int status;
+	pid_t result;
+	do
+	{
+		result = waitpid(m_Pid, &status, 0);
+	} while (result < 0 && errno == EINTR);
+	m_Pid = 0;
+
+	if (!PosixAssert(result >= 0, "waitpid"))
+	{
+		return -1;
+	}
+	return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
+
+ProcessPoller::ProcessPoller()
+{
+	m_Epoll = epoll_create1(EPOLL_CLOEXEC);
+	if (!PosixAssert(m_Epoll != -1, "epoll_create1"))
+	{
+		return;
+	}
+
+	// The wake eventfd has no key, which is how Wait tells it apart from the processes.
+	m_WakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (!PosixAssert(m_WakeFd != -1, "eventfd"))
+	{
+		return;
+	}
+	epoll_event event = {};
+	event.events = EPOLLIN;
+	event.data.ptr = nullptr;
+	PosixAssert(epoll_ctl(m_Epoll, EPOLL_CTL_ADD, m_WakeFd, &event) == 0, "epoll_ctl");
+}
+
+ProcessPoller::~ProcessPoller()
+{
+	CloseFd(m_WakeFd);
+	CloseFd(m_Epoll);
+}
+
+bool ProcessPoller::Add(const PosixProcess& process, void* const key)
+{
+	// A closed pipe is reported as EPOLLHUP whether asked for or not, so only input needs asking for.
+	epoll_event event = {};
+	event.events = EPOLLIN;
+	event.data.ptr = key;
+	return PosixAssert(epoll_ctl(m_Epoll, EPOLL_CTL_ADD, process.GetOutputFd(), &event) == 0, "epoll_ctl");
+}
+
+void ProcessPoller::Remove(const PosixProcess& process)
+{
+	epoll_ctl(m_Epoll, EPOLL_CTL_DEL, process.GetOutputFd(), nullptr);
+}
+
+void ProcessPoller::Wake()
+{
+	// EAGAIN means the count is already as high as it goes, which wakes the poller all the same.
+	const uint64_t one = 1;
+	ssize_t written;
+	do
+	{
+		written = write(m_WakeFd, &one, sizeof(one));
+	} while (written < 0 && errno == EINTR);
+	PosixAssert(written == sizeof(one) || errno == EAGAIN, "Wake write");
+}
+
+int ProcessPoller::Wait(void** const keys, const int capacity, const int timeoutMs)
+{
+	epoll_event events[MAX_EVENTS];
+	const int eventCount = epoll_wait(m_Epoll, events, capacity < MAX_EVENTS ? capacity : MAX_EVENTS, timeoutMs);
+	if (eventCount < 0)
+	{
+		if (errno == EINTR)
+		{
+			return 0;
+		}
+		PosixAssert(false, "epoll_wait");
+		return -1;
+	}
+
+	int keyCount = 0;
+	for (int i = 0; i < eventCount; ++i)
+	{
+		if (events[i].data.ptr)
+		{
+			keys[keyCount++] = events[i].data.ptr;
+		}
+		else
+		{
+			// Reset the eventfd, so the next Wait blocks again. EAGAIN means another read got there first, leaving it reset already.
+			uint64_t count;
+			ssize_t bytesRead;
+			do
+			{
+				bytesRead = read(m_WakeFd, &count, sizeof(count));
+			} while (bytesRead < 0 && errno == EINTR);
+			PosixAssert(bytesRead == sizeof(count) || errno == EAGAIN, "Wake read");
+		}
+	}
+
+	return keyCount;
+}
+
+#endif
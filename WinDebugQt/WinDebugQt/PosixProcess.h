@@ -0,0 +1,126 @@
+#pragma once
+
+#ifdef __linux__
+
+#include <string_view>
+#include <sys/types.h>
+
+#include "ICdbTransport.h"
+#include "OutputTokenizer.h"
+#include "StreamBuffer.h"
+
+/*
+* The POSIX counterpart of Process: a child process started with posix_spawn, whose stdin and stdout are pipes this process holds the other ends of.
+* Our ends are non-blocking, so one thread can service any number of children by waiting on their output with a ProcessPoller,
+* and reading from whichever are ready. Like Process, the child's stderr goes to the same pipe as its stdout.
+*/
+class PosixProcess
+	final : public ICdbTransport
+{
+public:
+	// What a Read found.
+	enum class ReadStatus
+	{
+		Read, // Some output was read.
+		WouldBlock, // There is no output waiting.
+		Closed, // The child has closed its end of the pipe, which it does when it exits.
+		Failed,
+	};
+
+	PosixProcess() = default;
+	PosixProcess(const PosixProcess&) = delete;
+	PosixProcess(PosixProcess&&) = delete;
+	PosixProcess& operator=(const PosixProcess&) = delete;
+	PosixProcess& operator=(PosixProcess&&) = delete;
+	virtual ~PosixProcess() override { Stop(); }
+
+	/*
+	* Launches argv[0], searched for on the PATH, with the null-terminated arguments argv, and its input and output redirected for communication with this process.
+	* Returns false if the pipes could not be made or the process could not be spawned.
+	*/
+	bool Start(const char* const* argv);
+
+	// Kills the process, reaps it, and cleans up resources while instance is still in scope. Resets the state of this instance.
+	void Stop();
+
+	/*
+	* Kills the process but keeps the pipes open, so a poller waiting on its output sees the pipe close and wakes up.
+	* Stop must still be called afterwards to clean up.
+	*/
+	void Terminate();
+
+	/*
+	* Writes the contents of str to the child process' stdin pipe, waiting for it to drain if it is full.
+	* Returns false once the child has exited. SIGPIPE must be ignored, or writing to a child that has exited kills this process instead.
+	*/
+	virtual bool Write(const std::string_view str) override;
+
+	// The child process' stdout pipe, which is non-blocking, for a ProcessPoller to wait on. -1 if the process has not been started.
+	int GetOutputFd() const { return m_ChildStdOutRd; }
+
+	/*
+	* Reads whatever output is waiting onto the end of m_Buffer, without blocking, to be framed by NextFrame.
+	* On ReadStatus::Read, received is set to the bytes read, valid until the next Read.
+	* The previous frame handed out by NextFrame is released, so its space can be reused.
+	*/
+	ReadStatus Read(std::string_view& received);
+
+	/*
+	* Frames output that has already been read into m_Buffer. Returns false if there is no full frame yet.
+	* The previous frame is released by the next call, and outFrame is only valid until then.
+	* The tokenizer keeps its scan state between calls, so it must only be used with this process.
+	*/
+	virtual bool NextFrame(std::string_view& outFrame, OutputTokenizer& tokenizer, int& frameType) override;
+
+	// Waits for the process to exit and reaps it. Returns its exit code, 128 plus the signal if it was killed by one, or -1 if it had already been reaped.
+	int Wait();
+
+	pid_t GetProcessId() const { return m_Pid; }
+
+private:
+	// The amount of space to offer each read, since the amount about to arrive is unknown.
+	static const size_t MIN_READ_SIZE = 4096;
+
+	pid_t m_Pid = 0; // 0 once the process has been reaped.
+	int m_ChildStdInWr = -1;
+	int m_ChildStdOutRd = -1;
+	StreamBuffer m_Buffer;
+	size_t m_FrameLength = 0; // Length of the frame last handed out by NextFrame, which is released on the next call.
+};
+
+/*
+* Waits on the output of many PosixProcesses from one thread with epoll. Waits are level-triggered, so a process that is not read from
+* until it would block is simply reported again by the next Wait, and reading once per wakeup keeps one chatty process from starving the rest.
+*/
+class ProcessPoller
+{
+public:
+	ProcessPoller();
+	ProcessPoller(const ProcessPoller&) = delete;
+	ProcessPoller& operator=(const ProcessPoller&) = delete;
+	~ProcessPoller();
+
+	// Starts waiting on process' output. key is handed back by Wait when it is ready. Returns false if it could not be added.
+	bool Add(const PosixProcess& process, void* const key);
+
+	// Stops waiting on process' output. This must be done before the process is stopped.
+	void Remove(const PosixProcess& process);
+
+	// Makes a Wait on another thread return straight away, with no keys.
+	void Wake();
+
+	/*
+	* Waits up to timeoutMs milliseconds, or forever if it is negative, for some of the processes to have output to read or to close their pipes.
+	* Fills keys with up to capacity of their keys, and returns how many. Returns 0 on timeout or Wake, and -1 if waiting failed.
+	*/
+	int Wait(void** const keys, const int capacity, const int timeoutMs);
+
+private:
+	// The most processes reported by one Wait, regardless of capacity.
+	static constexpr int MAX_EVENTS = 64;
+
+	int m_Epoll = -1;
+	int m_WakeFd = -1; // An eventfd, written to by Wake.
+};
+
+#endif
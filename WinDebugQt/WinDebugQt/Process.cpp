@@ -1,44 +1,13 @@
 #include "Process.h"
 
+#include <atomic>
+#include <format>
 #include <string>
 
 #include "WinAssert.h"
 
-Process::Process(Process&& other) noexcept
-	: m_ProcInfo(other.m_ProcInfo),
-	m_ChildStdInWr(other.m_ChildStdInWr),
-	m_ChildStdOutRd(other.m_ChildStdOutRd),
-	m_CurrBufferIndex(other.m_CurrBufferIndex),
-	m_Started(other.m_Started)
-{
-	std::copy(std::begin(other.m_Buffer), std::end(other.m_Buffer), m_Buffer);
-
-	SecureZeroMemory(&other.m_ProcInfo, sizeof(PROCESS_INFORMATION));
-	other.m_ChildStdInWr = nullptr;
-	other.m_ChildStdOutRd = nullptr;
-	other.m_CurrBufferIndex = 0;
-	other.m_Buffer[0] = '\0';
-	other.m_Started = false;
-}
-
-Process& Process::operator=(Process&& other) noexcept
-{
-	m_ProcInfo = other.m_ProcInfo;
-	m_ChildStdInWr = other.m_ChildStdInWr;
-	m_ChildStdOutRd = other.m_ChildStdOutRd;
-	m_CurrBufferIndex = other.m_CurrBufferIndex;
-	std::copy(std::begin(other.m_Buffer), std::end(other.m_Buffer), m_Buffer);
-	m_Started = other.m_Started;
-
-	SecureZeroMemory(&other.m_ProcInfo, sizeof(PROCESS_INFORMATION));
-	other.m_ChildStdInWr = nullptr;
-	other.m_ChildStdOutRd = nullptr;
-	other.m_CurrBufferIndex = 0;
-	other.m_Buffer[0] = '\0';
-	other.m_Started = false;
-
-	return *this;
-}
+// Anonymous pipes do not support overlapped I/O, so each process' stdout gets a uniquely named pipe instead.
+static std::atomic<unsigned> s_PipeCount = 0;
 
 bool Process::Start(char* const launchCommand, const bool redirectInputOutput, const bool showWindow)
 {
@@ -58,21 +27,26 @@ bool Process::Start(char* const launchCommand, const bool redirectInputOutput, c
 
 	if (redirectInputOutput)
 	{
-		// Create the pipes for communication with the process.
-		if (!WinAssert(CreatePipe(&m_ChildStdOutRd, &childStdOutWr, &saAttr, 0), "StdoutRd CreatePipe"))
+		// Create the pipes for communication with the process. Our end of stdout is overlapped, and not inherited as it is created without saAttr.
+		const std::string pipeName = std::format("\\\\.\\pipe\\WinDebugQt.{}.{}", GetCurrentProcessId(), s_PipeCount++);
+		m_ChildStdOutRd = CreateNamedPipeA(pipeName.c_str(), PIPE_ACCESS_INBOUND | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE,
+			PIPE_TYPE_BYTE | PIPE_WAIT, 1, MIN_READ_SIZE, MIN_READ_SIZE, 0, nullptr);
+		if (!WinAssert(m_ChildStdOutRd != INVALID_HANDLE_VALUE, "Stdout CreateNamedPipeA"))
 		{
+			m_ChildStdOutRd = nullptr;
 			return false;
 		}
-		if (!WinAssert(CreatePipe(&childStdInRd, &m_ChildStdInWr, &saAttr, 0), "Stdin CreatePipe"))
+		childStdOutWr = CreateFileA(pipeName.c_str(), GENERIC_WRITE, 0, &saAttr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (!WinAssert(childStdOutWr != INVALID_HANDLE_VALUE, "Stdout CreateFileA"))
 		{
 			return false;
 		}
-
-		// Ensure these ends of the pipe aren't inherited.
-		if (!WinAssert(SetHandleInformation(m_ChildStdOutRd, HANDLE_FLAG_INHERIT, 0), "Stdout SetHandleInformation"))
+		if (!WinAssert(CreatePipe(&childStdInRd, &m_ChildStdInWr, &saAttr, 0), "Stdin CreatePipe"))
 		{
 			return false;
 		}
+
+		// Ensure this end of the pipe isn't inherited.
 		if (!WinAssert(SetHandleInformation(m_ChildStdInWr, HANDLE_FLAG_INHERIT, 0), "Stdin SetHandleInformation"))
 		{
 			return false;
@@ -116,11 +90,7 @@ bool Process::Start(char* const launchCommand, const bool redirectInputOutput, c
 
 void Process::Stop()
 {
-	if (m_Started)
-	{
-		TerminateProcess(m_ProcInfo.hProcess, 0);
-		m_Started = false;
-	}
+	Terminate();
 
 	if (m_ChildStdInWr)
 	{
@@ -142,76 +112,79 @@ void Process::Stop()
 	}
 
 	SecureZeroMemory(&m_ProcInfo, sizeof(PROCESS_INFORMATION));
-	m_CurrBufferIndex = 0;
-	m_Buffer[0] = '\0';
+	m_Buffer.Clear();
+	m_FrameLength = 0;
+}
+
+void Process::Terminate()
+{
+	if (m_Started)
+	{
+		TerminateProcess(m_ProcInfo.hProcess, 0);
+		m_Started = false;
+	}
 }
 
-bool Process::Write(const char* const str)
+bool Process::Write(const std::string_view str)
 {
 	if (m_ChildStdInWr)
 	{
 		DWORD dwWritten;
-		return WinAssert(WriteFile(m_ChildStdInWr, str, (DWORD)strlen(str), &dwWritten, nullptr), "WriteFile");
+		return WinAssert(WriteFile(m_ChildStdInWr, str.data(), (DWORD)str.size(), &dwWritten, nullptr), "WriteFile");
 	}
 
 	return false;
 }
 
-bool Process::Read(std::string& outStr, const std::regex (&stopPatterns)[], const int stopPatternCount, int& patternIndexHit)
+bool Process::BeginRead(OVERLAPPED& overlapped)
 {
 	if (!m_ChildStdOutRd)
 	{
 		return false;
 	}
-	
-	// First check if there is anything to read.
-	DWORD bytesAvailable;
-	if (!WinAssert(PeekNamedPipe(m_ChildStdOutRd, nullptr, 0, nullptr, &bytesAvailable, nullptr), "PeekNamedPipe"))
-	{
-		return false;
-	}
 
-	// If there is, concat it to the end of m_Buffer.
-	if (bytesAvailable)
+	// Release the frame handed out last, so its space can be reused for this read.
+	m_Buffer.Consume(m_FrameLength);
+	m_FrameLength = 0;
+
+	// A read on a pipe completes as soon as any data arrives, so offer it plenty of room and take whatever comes.
+	SecureZeroMemory(&overlapped, sizeof(OVERLAPPED));
+	if (!ReadFile(m_ChildStdOutRd, m_Buffer.PrepareWrite(MIN_READ_SIZE), MIN_READ_SIZE, nullptr, &overlapped) && GetLastError() != ERROR_IO_PENDING)
 	{
-		char tempBuf[BUFFER_SIZE];
-		DWORD readCount;
-		if (!WinAssert(ReadFile(m_ChildStdOutRd, tempBuf, BUFFER_SIZE - 1 - (DWORD)strlen(m_Buffer), &readCount, nullptr), "ReadFile"))
+		// A broken pipe means the process has exited, which is the expected way for reading to end.
+		if (GetLastError() != ERROR_BROKEN_PIPE)
 		{
-			return false;
+			WinAssert(false, "ReadFile");
 		}
-		tempBuf[readCount] = '\0';
-		strcat_s(m_Buffer, tempBuf);
+		return false;
 	}
 
-	// Note m_Buffer may have already had data stored in it from the last read, so continue even if there was no new data.
-
-	// Iterate one char at a time through the new data, to return as soon as we hit a requested regex pattern.
-	const size_t newBufferLen = strlen(m_Buffer);
-	for (size_t i = m_CurrBufferIndex; i < newBufferLen; ++i)
-	{
-		// Iterate all the regex patterns to see if any of them are now matched.
-		for (int regexIndex = 0; regexIndex < stopPatternCount; ++regexIndex)
-		{
-			if (std::regex_match(std::begin(m_Buffer), std::begin(m_Buffer) + i + 1, stopPatterns[regexIndex]))
-			{
-				// If we matched, put everything in the buffer into outStr.
-				outStr = m_Buffer;
+	return true;
+}
 
-				// Only leave everything after the spot we matched in m_Buffer.
-				strcpy_s(m_Buffer, outStr.substr(i + 1).c_str());
+std::string_view Process::EndRead(const DWORD bytesRead)
+{
+	m_Buffer.CommitWrite(bytesRead);
 
-				// Now remove everything after the spot we matched from outStr.
-				outStr = outStr.substr(0, i + 1);
+	const std::string_view unconsumed = m_Buffer.Unconsumed();
+	return unconsumed.substr(unconsumed.size() - bytesRead);
+}
 
-				m_CurrBufferIndex = 0;
-				patternIndexHit = regexIndex;
-				return true;
-			}
-		}
+bool Process::NextFrame(std::string_view& outFrame, OutputTokenizer& tokenizer, int& frameType)
+{
+	// Release the frame handed out by the last call.
+	m_Buffer.Consume(m_FrameLength);
+	m_FrameLength = 0;
+
+	// The tokenizer remembers how far it got last time, so only the new data is scanned.
+	const std::string_view unconsumed = m_Buffer.Unconsumed();
+	size_t frameLength;
+	if (tokenizer.Scan(unconsumed, frameLength, frameType))
+	{
+		outFrame = unconsumed.substr(0, frameLength);
+		m_FrameLength = frameLength;
+		return true;
 	}
 
-	// Leave anything still unmatched in m_Buffer, mark the current location, and return no match.
-	m_CurrBufferIndex = newBufferLen;
 	return false;
 }
\ No newline at end of file
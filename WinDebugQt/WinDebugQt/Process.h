@@ -1,55 +1,82 @@
 #pragma once
 
-#include <regex>
-#include <string>
+#include <string_view>
 #include <windows.h>
 
+#include "ICdbTransport.h"
+#include "OutputTokenizer.h"
+#include "StreamBuffer.h"
+
 // A simple OOP RAII implementation of a Windows process started with CreateProcessA.
 // Based on non-OOP Microsoft implementation: https://docs.microsoft.com/en-us/windows/win32/procthread/creating-a-child-process-with-redirected-input-and-output
 
 class Process
-	final // Marked final as a warning due to non-virtual destructor. If inheritance is wanted, ensure non-virutal destructor is desired or make it virtual.
+	final : public ICdbTransport
 {
 public:
 	Process() { SecureZeroMemory(&m_ProcInfo, sizeof(PROCESS_INFORMATION)); }
 	Process(const Process&) = delete;
-	Process(Process&& other) noexcept;
+	Process(Process&&) = delete;
 	Process& operator=(const Process&) = delete;
-	Process& operator=(Process&& other) noexcept;
-	~Process() { Stop(); }
+	Process& operator=(Process&&) = delete;
+	virtual ~Process() override { Stop(); }
 
 	/* 
 	* Launches a process with the specified command.
 	* If redirectInputOutput is true, the input and output pipes will be redirected for communication with this calling process.
-	* If redirectInputOutput is false, the Read() and Write() functions will do nothing.
+	* If redirectInputOutput is false, the BeginRead() and Write() functions will do nothing.
 	*/
 	bool Start(char* const launchCommand, const bool redirectInputOutput, const bool showWindow);
 
 	// Stops the process and cleans up resources while instance is still in scope. Resets the state of this instance.
 	void Stop();
 
+	/*
+	* Terminates the process but keeps the pipe handles open, so an outstanding read sees the pipe break and completes.
+	* Stop must still be called afterwards to clean up.
+	*/
+	void Terminate();
+
 	/*
 	* Write the contents of str to the child process' stdin pipe.
 	* Note: This will do nothing if process was launched with redirectInputOutput set to false.
 	*/
-	bool Write(const char* const str);
+	virtual bool Write(const std::string_view str) override;
 
-	/* 
-	* Read output from the child process' stdout pipe until it is empty (returns false) or a regex delim pattern is hit (returns true).  
-	* If the delim pattern is not hit, anything read in so far will be stored in m_Buffer and outStr will be unmodified.
-	* Note: This will do nothing if process was launched with redirectInputOutput set to false.
+	/*
+	* The child process' stdout pipe, which is opened for overlapped I/O so it can be serviced by an I/O completion port.
+	* Reads are issued with BeginRead and finished with EndRead once they complete.
+	* Null if the process was launched with redirectInputOutput set to false.
+	*/
+	HANDLE GetOutputHandle() const { return m_ChildStdOutRd; }
+
+	/*
+	* Issues an overlapped read of the child process' stdout pipe onto the end of m_Buffer, using overlapped. Only one read may be outstanding at a time.
+	* Returns false if the read could not be issued, such as when the pipe has been closed because the process exited or was terminated.
+	* The previous frame handed out by NextFrame is released, so its space can be reused.
+	*/
+	bool BeginRead(OVERLAPPED& overlapped);
+
+	// Adds the bytesRead bytes that a read issued by BeginRead has completed with to m_Buffer, to be framed by NextFrame. Returns them, valid until the next BeginRead.
+	std::string_view EndRead(const DWORD bytesRead);
+
+	/*
+	* Frames output that has already been read into m_Buffer. Returns false if there is no full frame yet.
+	* The previous frame is released by the next call, and outFrame is only valid until then.
+	* The tokenizer keeps its scan state between calls, so it must only be used with this process.
 	*/
-	bool Read(std::string& outStr, const std::regex (&stopPatterns)[], const int stopPatternCount, int& patternIndexHit);
+	virtual bool NextFrame(std::string_view& outFrame, OutputTokenizer& tokenizer, int& frameType) override;
 
 	DWORD GetProcessId() const { return m_ProcInfo.dwProcessId; }
 
 private:
-	static const int BUFFER_SIZE = 1024;
+	// The amount of space to offer each read, since the amount about to arrive is unknown.
+	static const DWORD MIN_READ_SIZE = 4096;
 
 	PROCESS_INFORMATION m_ProcInfo;
 	HANDLE m_ChildStdInWr = nullptr;
 	HANDLE m_ChildStdOutRd = nullptr;
-	size_t m_CurrBufferIndex = 0; // Index after the last output char written to m_Buffer.
-	char m_Buffer[BUFFER_SIZE] = "\0";
+	StreamBuffer m_Buffer;
+	size_t m_FrameLength = 0; // Length of the frame last handed out by NextFrame, which is released on the next call.
 	bool m_Started = false;
 };
\ No newline at end of file
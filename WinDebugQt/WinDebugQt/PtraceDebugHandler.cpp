@@ -0,0 +1,423 @@
+#include "PtraceDebugHandler.h"
+
+#ifdef __linux__
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <format>
+#include <sys/ptrace.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// The System V ABI lets a function use the 128 bytes below rsp without moving rsp, so callbacks must not put their stack frame there.
+static const uint64_t RED_ZONE_SIZE = 128;
+
+// The direction flag in RFLAGS, which must be clear on function entry.
+static const uint64_t EFLAGS_DF = 0x400;
+
+PtraceDebugHandler::~PtraceDebugHandler()
+{
+	StopButtonPressed();
+}
+
+void PtraceDebugHandler::StartButtonPressed(const size_t sessionCount)
+{
+	StopButtonPressed();
+
+	m_Sessions.clear();
+	for (size_t i = 0; i < sessionCount; ++i)
+	{
+		m_Sessions.push_back(std::make_unique<Session>(m_LogMemoryCap, m_LogPolicy));
+	}
+
+	m_StopRequested = false;
+	m_TracerThread = std::thread(&PtraceDebugHandler::TraceDebuggees, this);
+}
+
+void PtraceDebugHandler::StopButtonPressed()
+{
+	// Killing the debuggees ends the tracer thread's wait for them to stop. If the tracer thread has not forked one yet, it sees the request once it does.
+	m_StopRequested = true;
+	for (const std::unique_ptr<Session>& session : m_Sessions)
+	{
+		const pid_t pid = session->Pid;
+		if (pid)
+		{
+			kill(pid, SIGKILL);
+		}
+	}
+
+	if (m_TracerThread.joinable())
+	{
+		m_TracerThread.join();
+	}
+}
+
+LogRing* PtraceDebugHandler::GetLog(const size_t session)
+{
+	return session < m_Sessions.size() ? &m_Sessions[session]->Log : nullptr;
+}
+
+void PtraceDebugHandler::SetLogLimits(const size_t memoryCap, const LogRing::OverflowPolicy policy)
+{
+	m_LogMemoryCap = memoryCap;
+	m_LogPolicy = policy;
+}
+
+void PtraceDebugHandler::TraceDebuggees()
+{
+	// Just continue each debuggee from its first stop, which is at its first instruction.
+	m_ProcessGroup = 0;
+	size_t runningCount = 0;
+	for (const std::unique_ptr<Session>& session : m_Sessions)
+	{
+		if (Launch(*session) && Continue(*session, 0))
+		{
+			++runningCount;
+		}
+	}
+
+	while (runningCount > 0)
+	{
+		// Only the debuggees are waited on, so any other children of this process are left for whoever started them to reap.
+		int status;
+		const pid_t pid = waitpid(-m_ProcessGroup, &status, __WALL);
+		if (pid == -1)
+		{
+			if (errno != EINTR)
+			{
+				break;
+			}
+			continue;
+		}
+
+		Session* session = nullptr;
+		for (const std::unique_ptr<Session>& candidate : m_Sessions)
+		{
+			if (candidate->Pid == pid)
+			{
+				session = candidate.get();
+				break;
+			}
+		}
+		if (!session)
+		{
+			continue;
+		}
+
+		if (!WIFSTOPPED(status))
+		{
+			OnExited(*session);
+			--runningCount;
+			continue;
+		}
+
+		// Handling the stop may run into the debuggee exiting, such as while firing a callback.
+		const int signal = HandleStop(*session, WSTOPSIG(status));
+		if (!session->Pid || !Continue(*session, signal))
+		{
+			--runningCount;
+		}
+	}
+}
+
+bool PtraceDebugHandler::Launch(Session& session)
+{
+	const pid_t pid = fork();
+	if (pid == -1)
+	{
+		LogError(session, "fork");
+		return false;
+	}
+
+	if (pid == 0)
+	{
+		// In the child. Join the debuggees' process group, or start it if this is the first, so the tracer can wait on the debuggees alone.
+		// Have it stop at its first instruction once exec'd, so the tracer can take over from there.
+		if (setpgid(0, m_ProcessGroup) == -1)
+		{
+			_exit(126);
+		}
+		ptrace(PTRACE_TRACEME, 0, nullptr, nullptr);
+		execl("./DummyProgram", "DummyProgram", nullptr);
+		_exit(127);
+	}
+
+	// Also set from this side, in case the tracer waits on the group before the child gets to it. Fails harmlessly if the child has already exec'd.
+	setpgid(pid, m_ProcessGroup ? m_ProcessGroup : pid);
+
+	session.Pid = pid;
+	if (m_StopRequested)
+	{
+		kill(pid, SIGKILL);
+	}
+
+	int status;
+	if (waitpid(pid, &status, 0) == -1 || !WIFSTOPPED(status))
+	{
+		if (!m_StopRequested)
+		{
+			LogMessage(session, "Failed to launch DummyProgram!\n");
+		}
+		session.Pid = 0;
+		return false;
+	}
+
+	// The group is only started by a debuggee that launches, so it stays around for the rest to join as long as that one is running.
+	if (!m_ProcessGroup)
+	{
+		m_ProcessGroup = pid;
+	}
+
+	// Take the debuggee down with us if we go away without stopping it.
+	if (ptrace(PTRACE_SETOPTIONS, pid, nullptr, PTRACE_O_EXITKILL) == -1)
+	{
+		LogError(session, "PTRACE_SETOPTIONS");
+	}
+
+	return true;
+}
+
+int PtraceDebugHandler::HandleStop(Session& session, const int signal)
+{
+	if (signal != SIGTRAP)
+	{
+		LogMessage(session, std::format("The application received signal {}.\n", strsignal(signal)).c_str());
+		return signal;
+	}
+
+	// After an int 3, rip points just past it. Check the code from the int 3 on to see if the debuggee is firing a debug command, and if so, which one it is.
+	user_regs_struct regs;
+	if (ptrace(PTRACE_GETREGS, session.Pid.load(), nullptr, &regs) == -1)
+	{
+		LogError(session, "PTRACE_GETREGS");
+		return signal;
+	}
+
+	uint8_t signature[DBG_CMD_SIGNATURE_SIZE];
+	uint8_t opCode;
+	if (!ReadMemory(session, regs.rip - 1, signature, sizeof(signature)) || !ParseDbgCmdSignature(signature, opCode))
+	{
+		// Unidentified break, since it was not a DbgCmd. Pass it on to the debuggee.
+		LogMessage(session, std::format("Unidentified break at 0x{:x}.\n", regs.rip - 1).c_str());
+		return signal;
+	}
+
+	// The debug command jumps over its signature and returns once resumed, so nothing needs to change to continue from it.
+	HandleDbgCmd(session, opCode, regs);
+	return 0;
+}
+
+void PtraceDebugHandler::HandleDbgCmd(Session& session, const uint8_t opCode, const user_regs_struct& regs)
+{
+	// Generated from DBG_CMD_LIST, so a command added there fails to build until it has a handler here.
+	using Handler = void (PtraceDebugHandler::*)(Session&, const user_regs_struct&);
+#define DBG_CMD_HANDLER(name, opCode, parameters) &PtraceDebugHandler::HandleDbgCmd##name,
+	static constexpr Handler HANDLERS[] = { DBG_CMD_LIST(DBG_CMD_HANDLER) };
+#undef DBG_CMD_HANDLER
+
+	if (opCode < DBG_CMD_COUNT)
+	{
+		(this->*HANDLERS[opCode])(session, regs);
+	}
+	else
+	{
+		LogMessage(session, std::format("Unknown debugger command {}!\n", opCode).c_str());
+	}
+}
+
+void PtraceDebugHandler::HandleDbgCmdNop(Session& session, const user_regs_struct&)
+{
+	LogMessage(session, "Processed a nop!\n");
+}
+
+void PtraceDebugHandler::HandleDbgCmdRegisterAltStack(Session& session, const user_regs_struct& regs)
+{
+	// Rdi stores the first param passed in, which is the location of the static char array used for the new stack location in the debuggee application.
+	session.AltStackLocation = regs.rdi;
+	LogMessage(session, "The alternate stack location has been set!\n");
+}
+
+void PtraceDebugHandler::HandleDbgCmdRegisterCallTrampoline(Session& session, const user_regs_struct&)
+{
+	// Registers are saved and restored through ptrace in binary, which is no slower than the trampoline would be, so it goes unused here.
+	LogMessage(session, "The call trampoline location has been set, but is not needed!\n");
+}
+
+void PtraceDebugHandler::HandleDbgCmdFlushTelemetry(Session& session, const user_regs_struct& regs)
+{
+	// Rdi stores the first param passed in, which is the location of the records the debuggee has batched up, and rsi the second, their size.
+	if (regs.rsi > MAX_TELEMETRY_FLUSH_SIZE)
+	{
+		LogMessage(session, "Error reading telemetry! The flush is larger than any the debuggee may make!\n");
+		return;
+	}
+	session.TelemetryImage.resize(regs.rsi);
+	const uint64_t recordsBefore = session.Telemetry.GetStats().Records;
+	if (!ReadMemory(session, regs.rdi, session.TelemetryImage.data(), session.TelemetryImage.size()) || !session.Telemetry.Deliver(session.TelemetryImage))
+	{
+		LogMessage(session, "Error reading telemetry! The flush could not be read, or is not of a version this debugger supports!\n");
+		return;
+	}
+	LogMessage(session, std::format("Received {} telemetry records!\n", session.Telemetry.GetStats().Records - recordsBefore).c_str());
+}
+
+void PtraceDebugHandler::HandleDbgCmdSetCallbacks(Session& session, const user_regs_struct& regs)
+{
+	// Rdi stores the first param passed in, which is the location of the callback registry in the debuggee application.
+	// Rsi stores the second, the number of entries in it, so the whole registry is read at once. It is an unsigned, so only the low half of rsi is the count.
+	const uint32_t count = (uint32_t)regs.rsi;
+	if (count > MAX_CALLBACKS)
+	{
+		LogMessage(session, std::format("Error setting callbacks! The registry holds {} callbacks, more than the {} this debugger supports!\n", count, MAX_CALLBACKS).c_str());
+		return;
+	}
+	session.RegistryQwords.resize(CallbackRegistry::HEADER_QWORDS + count * CallbackRegistry::ENTRY_QWORDS);
+	if (!ReadMemory(session, regs.rdi, session.RegistryQwords.data(), session.RegistryQwords.size() * sizeof(uint64_t))
+		|| !session.RegisteredCallbacks.Load(session.RegistryQwords))
+	{
+		LogMessage(session, "Error setting callbacks! The registry could not be read, or is not of a version this debugger supports!\n");
+		return;
+	}
+	LogMessage(session, "Callbacks have been set!\n");
+
+	const CallbackRegistryEntry* const printAAA = session.RegisteredCallbacks.Find(DbgCallbacks::PrintAAA);
+	const CallbackRegistryEntry* const returnDoubleTheInput = session.RegisteredCallbacks.Find(DbgCallbacks::ReturnDoubleTheInput);
+	if (!printAAA || !returnDoubleTheInput)
+	{
+		LogMessage(session, "Error firing callbacks! The debuggee has not registered PrintAAA and ReturnDoubleTheInput as this debugger calls them!\n");
+		return;
+	}
+
+	uint64_t retValue;
+	LogMessage(session, "Firing callback PrintAAA!\n");
+	if (!FireCallback(session, printAAA->Address, retValue))
+	{
+		return;
+	}
+
+	LogMessage(session, "Firing callback ReturnDoubleTheInput!\n");
+	const int valueToDouble = 7;
+	if (FireCallback(session, returnDoubleTheInput->Address, retValue, valueToDouble))
+	{
+		// The callback returns an int, so only the low half of rax is its return value.
+		LogMessage(session, std::format("Double the value of {} is {}!\n", valueToDouble, (int)retValue).c_str());
+	}
+}
+
+bool PtraceDebugHandler::FireCallback(Session& session, const uint64_t callbackAddress, uint64_t& returnValue, const uint64_t arg0, const uint64_t arg1, const uint64_t arg2)
+{
+	const pid_t pid = session.Pid;
+
+	// Save every register, since the callback may clobber any of the volatile ones, and restoring the nonvolatile ones to what they already are is harmless.
+	user_regs_struct savedRegs;
+	user_fpregs_struct savedFpRegs;
+	if (ptrace(PTRACE_GETREGS, pid, nullptr, &savedRegs) == -1 || ptrace(PTRACE_GETFPREGS, pid, nullptr, &savedFpRegs) == -1)
+	{
+		LogError(session, "PTRACE_GETREGS");
+		return false;
+	}
+
+	// The System V ABI requires rsp%16=0 at a call, so align the stack pointer then decrement by 8 to simulate one, below the interrupted function's red zone.
+	// If an alternate stack location has been set, use that instead of the current stack location.
+	// Set rip to the callback address, clear RFLAGS.DF (the direction flag), and pass the arguments in rdi, rsi and rdx.
+	// orig_rax is cleared so the kernel does not try to restart a system call the debuggee might have been stopped in.
+	user_regs_struct regs = savedRegs;
+	const uint64_t stackTop = session.AltStackLocation ? session.AltStackLocation : savedRegs.rsp - RED_ZONE_SIZE;
+	regs.rsp = (stackTop & ~15ull) - 8;
+	regs.rip = callbackAddress;
+	regs.eflags &= ~EFLAGS_DF;
+	regs.rdi = arg0;
+	regs.rsi = arg1;
+	regs.rdx = arg2;
+	regs.orig_rax = (unsigned long long)-1;
+
+	// Write 0 to the return address so that returning from the callback faults back into the debugger.
+	if (ptrace(PTRACE_POKEDATA, pid, (void*)regs.rsp, nullptr) == -1 || ptrace(PTRACE_SETREGS, pid, nullptr, &regs) == -1)
+	{
+		LogError(session, "PTRACE_SETREGS");
+		return false;
+	}
+
+	// Anything else the debuggee runs into during the callback is passed on to it.
+	int signal = 0;
+	while (ContinueAndWait(session, signal, signal))
+	{
+		if (signal == SIGSEGV && ptrace(PTRACE_GETREGS, pid, nullptr, &regs) != -1 && regs.rip == 0)
+		{
+			// The callback returned to address 0. Take its return value and put everything back the way it was.
+			returnValue = regs.rax;
+			if (ptrace(PTRACE_SETREGS, pid, nullptr, &savedRegs) == -1 || ptrace(PTRACE_SETFPREGS, pid, nullptr, &savedFpRegs) == -1)
+			{
+				LogError(session, "PTRACE_SETREGS");
+				return false;
+			}
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool PtraceDebugHandler::Continue(Session& session, const int signal)
+{
+	if (ptrace(PTRACE_CONT, session.Pid.load(), nullptr, (void*)(intptr_t)signal) == -1)
+	{
+		LogError(session, "PTRACE_CONT");
+		return false;
+	}
+
+	return true;
+}
+
+bool PtraceDebugHandler::ContinueAndWait(Session& session, const int signal, int& stopSignal)
+{
+	if (!Continue(session, signal))
+	{
+		return false;
+	}
+
+	int status;
+	if (waitpid(session.Pid, &status, 0) == -1)
+	{
+		LogError(session, "waitpid");
+		return false;
+	}
+
+	if (!WIFSTOPPED(status))
+	{
+		OnExited(session);
+		return false;
+	}
+
+	stopSignal = WSTOPSIG(status);
+	return true;
+}
+
+void PtraceDebugHandler::OnExited(Session& session)
+{
+	LogMessage(session, "The application has exited!\n");
+	session.Pid = 0;
+}
+
+bool PtraceDebugHandler::ReadMemory(const Session& session, const uint64_t address, void* const buffer, const size_t size)
+{
+	const iovec local = { buffer, size };
+	const iovec remote = { (void*)address, size };
+	return process_vm_readv(session.Pid, &local, 1, &remote, 1, 0) == (ssize_t)size;
+}
+
+void PtraceDebugHandler::LogError(Session& session, const char* const function)
+{
+	LogMessage(session, std::format("{} failed with error {}: {}\n", function, errno, strerror(errno)).c_str());
+}
+
+void PtraceDebugHandler::LogMessage(Session& session, const char* const message)
+{
+	session.Log.Write("DebugHandler: ");
+	session.Log.Write(message);
+}
+
+#endif
@@ -0,0 +1,144 @@
+#pragma once
+
+#ifdef __linux__
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+#include <sys/user.h>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "CallbackRegistry.h"
+#include "DbgCmds.h"
+#include "IDebugHandler.h"
+#include "LogRing.h"
+#include "TelemetryChannel.h"
+
+/*
+* Debugs the dummy application on Linux with ptrace, instead of through CDB. Understands the same debug commands as DebugHandler, but reads
+* registers and memory directly and fires debuggee callbacks by rewriting the registers itself.
+* ptrace only accepts requests from the thread that started tracing, so everything that touches the debuggees happens on m_TracerThread.
+* That one thread runs every session, waiting on all of their debuggees at once.
+*/
+class PtraceDebugHandler : public IDebugHandler
+{
+public:
+	PtraceDebugHandler() = default;
+	virtual ~PtraceDebugHandler() override;
+
+	// Runs sessionCount instances of the dummy application under ptrace.
+	virtual void StartButtonPressed(const size_t sessionCount) override;
+
+	// Kills the dummy applications and stops tracing them.
+	virtual void StopButtonPressed() override;
+
+	// The number of sessions started by the last StartButtonPressed.
+	virtual size_t GetSessionCount() override { return m_Sessions.size(); }
+
+	// The output of a session, or null if there is no such session.
+	virtual LogRing* GetLog(const size_t session) override;
+
+	// Caps the memory each session's log may use, and sets what to drop once it is reached. Applies from the next start.
+	virtual void SetLogLimits(const size_t memoryCap, const LogRing::OverflowPolicy policy) override;
+
+	// Debuggees are driven through ptrace rather than CDB, so there are no CDB round trips to measure.
+	virtual void SetProfiling(const bool) override {}
+	virtual SessionProfile* GetProfile(const size_t) override { return nullptr; }
+
+private:
+	// One debuggee, and everything known about it.
+	struct Session
+	{
+		Session(const size_t logMemoryCap, const LogRing::OverflowPolicy logPolicy)
+			: Log(logMemoryCap, logPolicy)
+		{
+		}
+
+		// Only the tracer thread starts or reaps the debuggee, but StopButtonPressed kills it from the Qt thread. 0 once it has exited.
+		std::atomic<pid_t> Pid = 0;
+
+		// Used as the new stack location when firing debuggee callbacks. Prevents callback failures when processing stack overflow signals.
+		uint64_t AltStackLocation = 0;
+
+		// The debuggee's callbacks, once it has registered them, and the registry they were loaded from. Kept around so their capacity is reused.
+		CallbackRegistry RegisteredCallbacks;
+		std::vector<uint64_t> RegistryQwords;
+
+		// Hands on the telemetry the debuggee flushes, and the last flush read from it. Kept around so its capacity is reused.
+		TelemetryChannel Telemetry;
+		std::vector<uint8_t> TelemetryImage;
+
+		// Stores the output data that has not yet been retrieved through GetLog. The tracer thread is its only producer.
+		LogRing Log;
+	};
+
+	// The tracer thread's loop. Launches every session's debuggee and handles each of their stops until they have all exited.
+	void TraceDebuggees();
+
+	// Forks and execs a session's debuggee with tracing enabled. Returns with it stopped at its first instruction.
+	bool Launch(Session& session);
+
+	// Handles a session's debuggee stopping with signal. Returns the signal to deliver when resuming it, which is 0 if the stop was handled.
+	int HandleStop(Session& session, const int signal);
+
+	// Handles a debugger command coming from the debuggee application, through a table of the handlers below indexed by opCode. regs are the registers at the command's int 3.
+	void HandleDbgCmd(Session& session, const uint8_t opCode, const user_regs_struct& regs);
+
+	// Handles the command that does nothing but break.
+	void HandleDbgCmdNop(Session& session, const user_regs_struct& regs);
+
+	// Handles the command to set the callbacks in the debuggee code that can be called.
+	void HandleDbgCmdSetCallbacks(Session& session, const user_regs_struct& regs);
+
+	// Handles the command to set the alt stack location in the debuggee code that can be used as the new stack location when firing debuggee callbacks.
+	void HandleDbgCmdRegisterAltStack(Session& session, const user_regs_struct& regs);
+
+	// Handles the command to set the location of the debuggee's call trampoline, which goes unused here.
+	void HandleDbgCmdRegisterCallTrampoline(Session& session, const user_regs_struct& regs);
+
+	// Handles the command to take the telemetry records the debuggee has batched up, which are read in one go and handed on to the consumers.
+	void HandleDbgCmdFlushTelemetry(Session& session, const user_regs_struct& regs);
+
+	/*
+	* Fires one of the callbacks the debuggee application has registered to be callable, and stores its return value in returnValue.
+	* Returns false if the debuggee exits before the callback returns. Other sessions wait until it does.
+	*/
+	bool FireCallback(Session& session, const uint64_t callbackAddress, uint64_t& returnValue, const uint64_t arg0 = 0, const uint64_t arg1 = 0, const uint64_t arg2 = 0);
+
+	// Resumes a session's debuggee, delivering signal to it unless it is 0.
+	bool Continue(Session& session, const int signal);
+
+	// Resumes a session's debuggee and waits for it, and only it, to stop again. Returns false if it exits instead.
+	bool ContinueAndWait(Session& session, const int signal, int& stopSignal);
+
+	// Handles a session's debuggee having exited, after it has been reaped.
+	void OnExited(Session& session);
+
+	// Reads size bytes of a debuggee's memory at address into buffer. Returns false if not all of it could be read.
+	bool ReadMemory(const Session& session, const uint64_t address, void* const buffer, const size_t size);
+
+	// Logs a failed system call, along with the reason from errno.
+	void LogError(Session& session, const char* const function);
+
+	// Preps a DebugHandler message to be stored in a session's Log for later log retrieval.
+	void LogMessage(Session& session, const char* const message);
+
+	// Created by StartButtonPressed before the tracer thread starts, and kept after stopping so their output can still be fetched.
+	std::vector<std::unique_ptr<Session>> m_Sessions;
+
+	std::atomic<bool> m_StopRequested = false;
+
+	// The process group every debuggee is put in, which the first to launch leads. Only touched on the tracer thread. 0 until a debuggee launches.
+	pid_t m_ProcessGroup = 0;
+
+	std::thread m_TracerThread;
+
+	// What each session's log is limited to when it is started.
+	size_t m_LogMemoryCap = LogRing::DEFAULT_MEMORY_CAP;
+	LogRing::OverflowPolicy m_LogPolicy = LogRing::OverflowPolicy::DropOldest;
+};
+
+#endif
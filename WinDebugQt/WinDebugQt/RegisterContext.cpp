@@ -0,0 +1,153 @@
+#include "RegisterContext.h"
+
+namespace
+{
+	struct GprField
+	{
+		std::string_view Name;
+		uint64_t RegisterContext::* Field;
+	};
+
+	// The general purpose registers in the order r prints them, so the usual lookup is short.
+	constexpr GprField GPR_FIELDS[] =
+	{
+		{ "rax", &RegisterContext::Rax },
+		{ "rbx", &RegisterContext::Rbx },
+		{ "rcx", &RegisterContext::Rcx },
+		{ "rdx", &RegisterContext::Rdx },
+		{ "rsi", &RegisterContext::Rsi },
+		{ "rdi", &RegisterContext::Rdi },
+		{ "rip", &RegisterContext::Rip },
+		{ "rsp", &RegisterContext::Rsp },
+		{ "rbp", &RegisterContext::Rbp },
+		{ "r8", &RegisterContext::R8 },
+		{ "r9", &RegisterContext::R9 },
+		{ "r10", &RegisterContext::R10 },
+		{ "r11", &RegisterContext::R11 },
+		{ "r12", &RegisterContext::R12 },
+		{ "r13", &RegisterContext::R13 },
+		{ "r14", &RegisterContext::R14 },
+		{ "r15", &RegisterContext::R15 },
+		{ "efl", &RegisterContext::ContextFlags },
+	};
+
+	bool IsNameChar(const char c)
+	{
+		return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9');
+	}
+
+	/*
+	* Calls onAssignment(name, valueText) for every "name=value" in line, where name starts the line or follows a space.
+	* This skips things like the "ds:00000000`00000000=" effective address annotations in disassembly lines.
+	*/
+	template <typename OnAssignment>
+	void ForEachAssignment(const std::string_view line, OnAssignment onAssignment)
+	{
+		for (size_t equals = line.find('='); equals != std::string_view::npos; equals = line.find('=', equals + 1))
+		{
+			size_t nameStart = equals;
+			while (nameStart > 0 && IsNameChar(line[nameStart - 1]))
+			{
+				--nameStart;
+			}
+
+			if (nameStart != equals && (nameStart == 0 || line[nameStart - 1] == ' '))
+			{
+				onAssignment(line.substr(nameStart, equals - nameStart), line.substr(equals + 1));
+			}
+		}
+	}
+}
+
+bool RegisterContextParser::ParseLine(const std::string_view line, RegisterContext& context)
+{
+	ForEachAssignment(line, [this, &context](const std::string_view name, const std::string_view valueText)
+	{
+		// r xmmN:uq prints the high half, a space, then the low half.
+		if (name.size() > 3 && name.substr(0, 3) == "xmm")
+		{
+			size_t index = 0;
+			for (const char c : name.substr(3))
+			{
+				index = index * 10 + (size_t)(c - '0');
+			}
+			if (index >= XMM_COUNT)
+			{
+				return;
+			}
+
+			uint64_t high;
+			uint64_t low;
+			const size_t highLength = ParseHex(valueText, high);
+			if (highLength && highLength < valueText.size() && valueText[highLength] == ' ' && ParseHex(valueText.substr(highLength + 1), low))
+			{
+				context.Xmms[index].High = high;
+				context.Xmms[index].Low = low;
+				m_ParsedMask |= 1ull << (GPR_COUNT + index);
+			}
+			return;
+		}
+
+		for (int i = 0; i < GPR_COUNT; ++i)
+		{
+			if (GPR_FIELDS[i].Name == name)
+			{
+				if (ParseHex(valueText, context.*GPR_FIELDS[i].Field))
+				{
+					m_ParsedMask |= 1ull << i;
+				}
+				return;
+			}
+		}
+	});
+
+	return m_ParsedMask == COMPLETE_MASK;
+}
+
+bool RegisterContextParser::FindRegister(const std::string_view line, const std::string_view registerName, uint64_t& value)
+{
+	bool found = false;
+	ForEachAssignment(line, [&](const std::string_view name, const std::string_view valueText)
+	{
+		if (!found && name == registerName)
+		{
+			found = ParseHex(valueText, value) != 0;
+		}
+	});
+
+	return found;
+}
+
+size_t RegisterContextParser::ParseHex(const std::string_view text, uint64_t& value)
+{
+	uint64_t result = 0;
+	size_t i = 0;
+	for (; i < text.size(); ++i)
+	{
+		const char c = text[i];
+		if (c >= '0' && c <= '9')
+		{
+			result = (result << 4) | (uint64_t)(c - '0');
+		}
+		else if (c >= 'a' && c <= 'f')
+		{
+			result = (result << 4) | (uint64_t)(c - 'a' + 10);
+		}
+		else if (c >= 'A' && c <= 'F')
+		{
+			result = (result << 4) | (uint64_t)(c - 'A' + 10);
+		}
+		else if (c != '`' || i == 0)
+		{
+			break;
+		}
+	}
+
+	if (i == 0)
+	{
+		return 0;
+	}
+
+	value = result;
+	return i;
+}
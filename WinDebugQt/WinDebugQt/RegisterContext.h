@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+// A snapshot of the registers of a debuggee thread, stored as binary values.
+struct RegisterContext
+{
+	// The two 64-bit halves of an xmm register, in the order CDB assigns them.
+	struct Xmm
+	{
+		uint64_t Low = 0;
+		uint64_t High = 0;
+	};
+
+	uint64_t Rax = 0;
+	uint64_t Rcx = 0;
+	uint64_t Rdx = 0;
+	uint64_t Rbx = 0;
+	uint64_t Rsp = 0;
+	uint64_t Rbp = 0;
+	uint64_t Rsi = 0;
+	uint64_t Rdi = 0;
+	uint64_t R8 = 0;
+	uint64_t R9 = 0;
+	uint64_t R10 = 0;
+	uint64_t R11 = 0;
+	uint64_t R12 = 0;
+	uint64_t R13 = 0;
+	uint64_t R14 = 0;
+	uint64_t R15 = 0;
+
+	uint64_t Rip = 0;
+	uint64_t ContextFlags = 0;
+
+	alignas(16) Xmm Xmms[16];
+};
+
+/*
+* Fills a RegisterContext from the output of REGISTER_DUMP_COMMAND, one line at a time.
+* Register assignments ("name=value") are picked out of each line by hand rather than with a regex, and converted straight to binary.
+*/
+class RegisterContextParser
+{
+public:
+	// Prints every register stored in a RegisterContext. The xmm registers must be printed one at a time as 64-bit halves to get them in a usable format.
+	static constexpr const char* REGISTER_DUMP_COMMAND = "r;"
+		"r xmm0:uq;r xmm1:uq;r xmm2:uq;r xmm3:uq;r xmm4:uq;r xmm5:uq;r xmm6:uq;r xmm7:uq;"
+		"r xmm8:uq;r xmm9:uq;r xmm10:uq;r xmm11:uq;r xmm12:uq;r xmm13:uq;r xmm14:uq;r xmm15:uq";
+
+	// Starts a new snapshot.
+	void Reset() { m_ParsedMask = 0; }
+
+	// Stores every register assigned in line into context. Returns true once every register in the context has been parsed.
+	bool ParseLine(const std::string_view line, RegisterContext& context);
+
+	/*
+	* Finds the value of a single register assigned in a line of r command output, such as "rcx=0000000000000000".
+	* Returns false if the register is not in the line.
+	*/
+	static bool FindRegister(const std::string_view line, const std::string_view registerName, uint64_t& value);
+
+	/*
+	* Parses the hex number at the start of text, which may contain CDB's ` separator between its 32-bit halves.
+	* Returns the number of characters used, which is 0 if text does not start with a hex digit.
+	*/
+	static size_t ParseHex(const std::string_view text, uint64_t& value);
+
+private:
+	static constexpr int GPR_COUNT = 18;
+	static constexpr int XMM_COUNT = 16;
+	static constexpr uint64_t COMPLETE_MASK = (1ull << (GPR_COUNT + XMM_COUNT)) - 1;
+
+	// Bit i is set once general purpose register i has been parsed, and bit GPR_COUNT + i once xmm i has.
+	uint64_t m_ParsedMask = 0;
+};
@@ -0,0 +1,136 @@
+#include "SessionProfile.h"
+
+#include <format>
+
+namespace
+{
+	constexpr std::string_view PHASE_NAMES[SessionProfile::PHASE_COUNT] =
+	{
+		"Dispatch",
+		"Write",
+		"Line",
+		"Prompt",
+		"Decode",
+		"SaveContext",
+		"Call",
+		"ReturnRead",
+		"Restore",
+	};
+
+	// The percentiles exported, and what they are called.
+	constexpr double EXPORTED_PERCENTILES[] = { 50, 90, 99, 99.9 };
+	constexpr std::string_view EXPORTED_PERCENTILE_NAMES[] = { "p50", "p90", "p99", "p99.9" };
+}
+
+void SessionProfile::RecordSince(const Phase phase, const Clock::time_point start)
+{
+	if (m_Enabled && start != Clock::time_point())
+	{
+		m_Phases[(size_t)phase].Record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+	}
+}
+
+void SessionProfile::RecordBetween(const Phase phase, const Clock::time_point start, const Clock::time_point end)
+{
+	// Either end may have been taken while measuring was off, or come out of order if the two were taken on different threads.
+	if (m_Enabled && start != Clock::time_point() && end >= start)
+	{
+		m_Phases[(size_t)phase].Record(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+	}
+}
+
+void SessionProfile::RecordDbgCmd(const uint8_t opCode, const std::chrono::nanoseconds latency)
+{
+	if (m_Enabled && opCode < DBG_CMD_COUNT)
+	{
+		m_DbgCmds[opCode].Record(latency.count());
+	}
+}
+
+void SessionProfile::Merge(const SessionProfile& other)
+{
+	for (size_t i = 0; i < PHASE_COUNT; ++i)
+	{
+		m_Phases[i].Merge(other.m_Phases[i]);
+	}
+	for (size_t i = 0; i < DBG_CMD_COUNT; ++i)
+	{
+		m_DbgCmds[i].Merge(other.m_DbgCmds[i]);
+	}
+}
+
+void SessionProfile::Reset()
+{
+	for (LatencyHistogram& histogram : m_Phases)
+	{
+		histogram.Reset();
+	}
+	for (LatencyHistogram& histogram : m_DbgCmds)
+	{
+		histogram.Reset();
+	}
+}
+
+std::string_view SessionProfile::GetPhaseName(const Phase phase)
+{
+	return (size_t)phase < PHASE_COUNT ? PHASE_NAMES[(size_t)phase] : "Unknown";
+}
+
+std::string_view SessionProfile::GetDbgCmdName(const size_t opCode)
+{
+	return opCode < DBG_CMD_COUNT ? DBG_CMD_NAMES[opCode] : "Unknown";
+}
+
+template <typename Visit>
+void SessionProfile::ForEachHistogram(const Visit& visit) const
+{
+	for (size_t i = 0; i < DBG_CMD_COUNT; ++i)
+	{
+		visit("DbgCmd", DBG_CMD_NAMES[i], m_DbgCmds[i]);
+	}
+	for (size_t i = 0; i < PHASE_COUNT; ++i)
+	{
+		visit("Phase", PHASE_NAMES[i], m_Phases[i]);
+	}
+}
+
+std::string SessionProfile::ToJson() const
+{
+	std::string json = "{\n\t\"unit\": \"ns\",\n\t\"histograms\": [";
+	bool first = true;
+	ForEachHistogram([&](const std::string_view kind, const std::string_view name, const LatencyHistogram& histogram)
+	{
+		json += first ? "\n" : ",\n";
+		first = false;
+
+		json += std::format("\t\t{{ \"kind\": \"{}\", \"name\": \"{}\", \"count\": {}, \"mean\": {}", kind, name, histogram.GetCount(), (uint64_t)histogram.GetMean());
+		for (size_t i = 0; i < std::size(EXPORTED_PERCENTILES); ++i)
+		{
+			json += std::format(", \"{}\": {}", EXPORTED_PERCENTILE_NAMES[i], histogram.GetPercentile(EXPORTED_PERCENTILES[i]));
+		}
+		json += std::format(", \"max\": {} }}", histogram.GetMax());
+	});
+	json += "\n\t]\n}\n";
+	return json;
+}
+
+std::string SessionProfile::ToCsv() const
+{
+	std::string csv = "kind,name,count,mean_ns";
+	for (const std::string_view name : EXPORTED_PERCENTILE_NAMES)
+	{
+		csv += std::format(",{}_ns", name);
+	}
+	csv += ",max_ns\n";
+
+	ForEachHistogram([&](const std::string_view kind, const std::string_view name, const LatencyHistogram& histogram)
+	{
+		csv += std::format("{},{},{},{}", kind, name, histogram.GetCount(), (uint64_t)histogram.GetMean());
+		for (const double percentile : EXPORTED_PERCENTILES)
+		{
+			csv += std::format(",{}", histogram.GetPercentile(percentile));
+		}
+		csv += std::format(",{}\n", histogram.GetMax());
+	});
+	return csv;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "DbgCmds.h"
+#include "LatencyHistogram.h"
+
+/*
+* Where a session's time goes, from a debug command's break to the resume that ends it: how long each debug command takes to handle,
+* and how long each phase of handling takes, in a histogram apiece. The session records to them on the thread that drains it,
+* and the presenter or anything else can read them on any thread while it does.
+* Measuring is off until SetEnabled is called. While it is off, every point measured costs one check of a flag, and no clock is read.
+*/
+class SessionProfile
+	final
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	enum class Phase
+	{
+		Dispatch, // From a batch of CDB's output being queued by the reading thread to it being drained.
+		Write, // Writing to CDB's input.
+		Line, // From a write to CDB to each line of output that belongs to one of its commands.
+		Prompt, // From a write to CDB to the prompt that ends it.
+		Decode, // From a break to the debug command it fired being decoded from the debuggee's memory.
+		SaveContext, // From sending the debuggee into a callback to the register dump that saves its context coming back.
+		Call, // From the saved context coming back to the callback returning.
+		ReturnRead, // From the callback returning to its return value being read.
+		Restore, // From the return value being read to the registers the callback changed being restored.
+		Count,
+	};
+
+	static constexpr size_t PHASE_COUNT = (size_t)Phase::Count;
+	static constexpr size_t DBG_CMD_COUNT = ::DBG_CMD_COUNT;
+
+	SessionProfile() = default;
+	SessionProfile(const SessionProfile&) = delete;
+	SessionProfile& operator=(const SessionProfile&) = delete;
+
+	// Only to be called on the thread that records, so a phase is never measured from a point taken while measuring was off.
+	void SetEnabled(const bool enabled) { m_Enabled = enabled; }
+	bool IsEnabled() const { return m_Enabled; }
+
+	// The time now, to measure a phase from. The epoch while measuring is off, which the Record functions skip.
+	Clock::time_point Now() const { return m_Enabled ? Clock::now() : Clock::time_point(); }
+
+	// Records the time from start to now against phase.
+	void RecordSince(const Phase phase, const Clock::time_point start);
+
+	// Records the time from start to end against phase.
+	void RecordBetween(const Phase phase, const Clock::time_point start, const Clock::time_point end);
+
+	// Records how long a debug command took to handle, from its break to its handler finishing.
+	void RecordDbgCmd(const uint8_t opCode, const std::chrono::nanoseconds latency);
+
+	const LatencyHistogram& GetPhase(const Phase phase) const { return m_Phases[(size_t)phase]; }
+	const LatencyHistogram& GetDbgCmd(const size_t opCode) const { return m_DbgCmds[opCode]; }
+
+	// Adds everything recorded in other to this profile, to sum up several sessions.
+	void Merge(const SessionProfile& other);
+
+	// Forgets everything recorded so far.
+	void Reset();
+
+	static std::string_view GetPhaseName(const Phase phase);
+	static std::string_view GetDbgCmdName(const size_t opCode);
+
+	// Every histogram's count, mean, percentiles and max, in nanoseconds.
+	std::string ToJson() const;
+
+	// The same as ToJson, as a row per histogram.
+	std::string ToCsv() const;
+
+private:
+	// Calls visit with the kind, name and histogram of every debug command and phase, in order.
+	template <typename Visit>
+	void ForEachHistogram(const Visit& visit) const;
+
+	bool m_Enabled = false;
+
+	std::array<LatencyHistogram, PHASE_COUNT> m_Phases;
+	std::array<LatencyHistogram, DBG_CMD_COUNT> m_DbgCmds;
+};
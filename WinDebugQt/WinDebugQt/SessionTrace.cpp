@@ -0,0 +1,176 @@
+#include "SessionTrace.h"
+
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Records are padded out to this so the next header is aligned.
+static constexpr size_t RECORD_ALIGNMENT = 8;
+
+static size_t AlignRecordLength(const size_t length)
+{
+	return (length + RECORD_ALIGNMENT - 1) & ~(RECORD_ALIGNMENT - 1);
+}
+
+bool TraceRecorder::Open(const std::filesystem::path& path)
+{
+	Close();
+
+	std::lock_guard<std::mutex> lock(m_Lock);
+	m_File.open(path, std::ios::binary | std::ios::trunc);
+
+	TraceFileHeader header = {};
+	std::memcpy(header.Magic, TraceFileHeader::MAGIC, sizeof(header.Magic));
+	header.Version = TraceFileHeader::VERSION;
+	m_File.write((const char*)&header, sizeof(header));
+
+	m_Start = std::chrono::steady_clock::now();
+	return m_File.good();
+}
+
+void TraceRecorder::Close()
+{
+	std::lock_guard<std::mutex> lock(m_Lock);
+	if (m_File.is_open())
+	{
+		m_File.close();
+	}
+}
+
+void TraceRecorder::Record(const TraceDirection direction, const std::string_view data)
+{
+	static const char padding[RECORD_ALIGNMENT] = {};
+
+	// Reads can be as large as a pipe buffer, but never anywhere near 4 GB.
+	TraceRecordHeader header = {};
+	header.Length = (uint32_t)data.size();
+	header.Direction = direction;
+
+	std::lock_guard<std::mutex> lock(m_Lock);
+	if (!m_File.good())
+	{
+		return;
+	}
+
+	// Taken under the lock, so timestamps never go backwards through the file.
+	header.Timestamp = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_Start).count();
+	m_File.write((const char*)&header, sizeof(header));
+	m_File.write(data.data(), data.size());
+	m_File.write(padding, AlignRecordLength(data.size()) - data.size());
+}
+
+bool TraceReader::Open(const std::filesystem::path& path)
+{
+	Close();
+
+#ifdef _WIN32
+	const HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || (uint64_t)size.QuadPart < sizeof(TraceFileHeader))
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	const HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+	if (!mapping)
+	{
+		return false;
+	}
+
+	m_Data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if (!m_Data)
+	{
+		return false;
+	}
+	m_Size = (size_t)size.QuadPart;
+#else
+	const int file = open(path.c_str(), O_RDONLY);
+	if (file < 0)
+	{
+		return false;
+	}
+
+	struct stat status;
+	if (fstat(file, &status) != 0 || (uint64_t)status.st_size < sizeof(TraceFileHeader))
+	{
+		close(file);
+		return false;
+	}
+
+	void* const view = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	if (view == MAP_FAILED)
+	{
+		return false;
+	}
+
+	// Replay walks the trace front to back.
+	madvise(view, (size_t)status.st_size, MADV_SEQUENTIAL);
+	m_Data = (const char*)view;
+	m_Size = (size_t)status.st_size;
+#endif
+
+	TraceFileHeader header;
+	std::memcpy(&header, m_Data, sizeof(header));
+	if (std::memcmp(header.Magic, TraceFileHeader::MAGIC, sizeof(header.Magic)) != 0 || header.Version != TraceFileHeader::VERSION)
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void TraceReader::Close()
+{
+	if (m_Data)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(m_Data);
+#else
+		munmap((void*)m_Data, m_Size);
+#endif
+	}
+
+	m_Data = nullptr;
+	m_Size = 0;
+}
+
+bool TraceReader::Next(size_t& offset, TraceRecord& record) const
+{
+	if (offset + sizeof(TraceRecordHeader) > m_Size)
+	{
+		return false;
+	}
+
+	TraceRecordHeader header;
+	std::memcpy(&header, m_Data + offset, sizeof(header));
+	const size_t dataOffset = offset + sizeof(header);
+	if (header.Length > m_Size - dataOffset)
+	{
+		return false;
+	}
+
+	record.Timestamp = header.Timestamp;
+	record.Direction = header.Direction;
+	record.Data = std::string_view(m_Data + dataOffset, header.Length);
+
+	// The padding after the last record may be missing if the recording was cut short.
+	offset = dataOffset + AlignRecordLength(header.Length);
+	return true;
+}
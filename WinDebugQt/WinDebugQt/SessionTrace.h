@@ -0,0 +1,112 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string_view>
+
+/*
+* A session trace is everything a session read from and wrote to CDB, in order, so the session can be replayed later without CDB.
+* The file starts with a TraceFileHeader, followed by records that are each a TraceRecordHeader and then the bytes read or written.
+* Every header and payload starts 8 byte aligned, so a trace can be mapped into memory and walked in place.
+*/
+
+enum class TraceDirection : uint8_t
+{
+	Read, // Output read from CDB.
+	Write, // Input written to CDB.
+	Dump, // The contents of a file CDB dumped memory to with .writemem, as the session read it. Empty if it could not be read.
+	DumpPrefix, // Where the session had CDB dump memory to, so a replay writes the same commands.
+};
+
+struct TraceFileHeader
+{
+	static constexpr char MAGIC[8] = { 'W', 'D', 'Q', 'T', 'R', 'C', '0', '1' };
+	static constexpr uint32_t VERSION = 1;
+
+	char Magic[8];
+	uint32_t Version;
+	uint32_t Reserved;
+};
+
+struct TraceRecordHeader
+{
+	// Nanoseconds from when the recording started, on a monotonic clock.
+	uint64_t Timestamp;
+	uint32_t Length;
+	TraceDirection Direction;
+	uint8_t Reserved[3];
+};
+
+static_assert(sizeof(TraceFileHeader) == 16 && sizeof(TraceRecordHeader) == 16, "Trace headers keep the records 8 byte aligned.");
+
+// One record of a trace, pointing into the mapped file.
+struct TraceRecord
+{
+	uint64_t Timestamp;
+	TraceDirection Direction;
+	std::string_view Data;
+};
+
+/*
+* Records a session's traffic with CDB to a trace file.
+* Reads are recorded by whichever worker thread handled them and writes by the Qt thread, so recording is serialized by a lock.
+*/
+class TraceRecorder
+	final
+{
+public:
+	TraceRecorder() = default;
+	TraceRecorder(const TraceRecorder&) = delete;
+	TraceRecorder& operator=(const TraceRecorder&) = delete;
+	~TraceRecorder() { Close(); }
+
+	// Starts a new trace at path, replacing any file already there. Timestamps count from now.
+	bool Open(const std::filesystem::path& path);
+
+	// Flushes the trace and closes the file.
+	void Close();
+
+	// Appends a record of data being read or written. Once a record fails to be written, nothing more is recorded.
+	void Record(const TraceDirection direction, const std::string_view data);
+
+private:
+	std::mutex m_Lock;
+	std::ofstream m_File;
+	std::chrono::steady_clock::time_point m_Start;
+};
+
+/*
+* Maps a trace file into memory to walk its records. Records are handed out as views into the mapping, so nothing is copied.
+* Read only, so any number of threads can walk the same trace.
+*/
+class TraceReader
+	final
+{
+public:
+	TraceReader() = default;
+	TraceReader(const TraceReader&) = delete;
+	TraceReader& operator=(const TraceReader&) = delete;
+	~TraceReader() { Close(); }
+
+	// Maps the trace at path. Fails if it is not a trace of this version.
+	bool Open(const std::filesystem::path& path);
+
+	void Close();
+
+	// Where the first record starts, to begin walking the trace from.
+	static constexpr size_t FIRST_RECORD_OFFSET = sizeof(TraceFileHeader);
+
+	/*
+	* Reads the record at offset and moves offset on to the next one. Returns false at the end of the trace.
+	* A record cut short, such as by the recording process being killed, ends the trace.
+	*/
+	bool Next(size_t& offset, TraceRecord& record) const;
+
+private:
+	// The mapped view of the whole file. The file and mapping handles are closed once it is mapped, as the view keeps them alive.
+	const char* m_Data = nullptr;
+	size_t m_Size = 0;
+};
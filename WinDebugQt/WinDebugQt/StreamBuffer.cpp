@@ -0,0 +1,52 @@
+#include "StreamBuffer.h"
+
+#include <cstring>
+
+StreamBuffer::StreamBuffer(const size_t initialCapacity)
+	: m_Data(std::make_unique_for_overwrite<char[]>(initialCapacity)),
+	m_Capacity(initialCapacity)
+{
+}
+
+char* StreamBuffer::PrepareWrite(const size_t minSize)
+{
+	const size_t unconsumedSize = m_WriteIndex - m_ReadIndex;
+
+	if (m_Capacity - m_WriteIndex < minSize)
+	{
+		if (m_Capacity - unconsumedSize >= minSize)
+		{
+			// Sliding the unconsumed data back to the start frees up enough room.
+			memmove(m_Data.get(), m_Data.get() + m_ReadIndex, unconsumedSize);
+		}
+		else
+		{
+			size_t newCapacity = m_Capacity ? m_Capacity * 2 : minSize;
+			while (newCapacity - unconsumedSize < minSize)
+			{
+				newCapacity *= 2;
+			}
+
+			std::unique_ptr<char[]> newData = std::make_unique_for_overwrite<char[]>(newCapacity);
+			memcpy(newData.get(), m_Data.get() + m_ReadIndex, unconsumedSize);
+			m_Data = std::move(newData);
+			m_Capacity = newCapacity;
+		}
+
+		m_ReadIndex = 0;
+		m_WriteIndex = unconsumedSize;
+	}
+
+	return m_Data.get() + m_WriteIndex;
+}
+
+void StreamBuffer::Consume(const size_t size)
+{
+	m_ReadIndex += size;
+
+	// Once everything is consumed, start over at the beginning so the next write never needs to slide anything.
+	if (m_ReadIndex == m_WriteIndex)
+	{
+		Clear();
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <memory>
+#include <string_view>
+
+/*
+* A growable buffer for a stream of output that is written at the tail and consumed from the head.
+* Unconsumed data is always contiguous, so frames can be handed out as string_views into the buffer without copying.
+* Consumed space is reclaimed by sliding the unconsumed remainder (usually a partial line) back to the start before a write,
+* and the buffer doubles in size whenever a write needs more room than that frees up.
+*/
+class StreamBuffer
+	final
+{
+public:
+	explicit StreamBuffer(const size_t initialCapacity = 4096);
+	StreamBuffer(const StreamBuffer&) = delete;
+	StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+	// Returns space for at least minSize bytes to be written after the unconsumed data. Invalidates any views previously returned.
+	char* PrepareWrite(const size_t minSize);
+
+	// Marks size bytes written into the space returned by PrepareWrite as readable.
+	void CommitWrite(const size_t size) { m_WriteIndex += size; }
+
+	// Everything written that has not been consumed yet. Stays valid until the next PrepareWrite or Clear.
+	std::string_view Unconsumed() const { return std::string_view(m_Data.get() + m_ReadIndex, m_WriteIndex - m_ReadIndex); }
+
+	// Releases size bytes from the head of the unconsumed data.
+	void Consume(const size_t size);
+
+	// Releases everything. The capacity is kept for reuse.
+	void Clear() { m_ReadIndex = m_WriteIndex = 0; }
+
+	size_t Capacity() const { return m_Capacity; }
+
+private:
+	std::unique_ptr<char[]> m_Data;
+	size_t m_Capacity = 0;
+	size_t m_ReadIndex = 0; // Index of the first unconsumed byte.
+	size_t m_WriteIndex = 0; // Index after the last byte written.
+};
@@ -0,0 +1,55 @@
+#include "TelemetryChannel.h"
+
+#include <cstring>
+
+bool TelemetryChannel::Deliver(const std::span<const uint8_t> flush)
+{
+	++m_Stats.Flushes;
+	m_Stats.Bytes += flush.size();
+
+	// The flush is read byte by byte into its headers, as the dump it was read from need not be aligned.
+	TelemetryFlushHeader header;
+	if (flush.size() < sizeof(header))
+	{
+		++m_Stats.Rejected;
+		return false;
+	}
+	std::memcpy(&header, flush.data(), sizeof(header));
+	if (header.Version != TELEMETRY_VERSION)
+	{
+		++m_Stats.Rejected;
+		return false;
+	}
+
+	size_t offset = sizeof(header);
+	for (uint32_t i = 0; i < header.RecordCount; ++i)
+	{
+		TelemetryRecordHeader record;
+		if (flush.size() - offset < sizeof(record))
+		{
+			++m_Stats.Rejected;
+			return false;
+		}
+		std::memcpy(&record, flush.data() + offset, sizeof(record));
+
+		// The last record's padding may have been left off, but not its payload.
+		const size_t payloadOffset = offset + sizeof(record);
+		if (flush.size() - payloadOffset < record.Size)
+		{
+			++m_Stats.Rejected;
+			return false;
+		}
+
+		const std::span<const uint8_t> payload = flush.subspan(payloadOffset, record.Size);
+		for (const Consumer& consumer : m_Consumers)
+		{
+			consumer(record.Type, payload);
+		}
+		++m_Stats.Records;
+
+		const size_t recordSize = GetTelemetryRecordSize(record.Size);
+		offset = flush.size() - offset < recordSize ? flush.size() : offset + recordSize;
+	}
+
+	return true;
+}
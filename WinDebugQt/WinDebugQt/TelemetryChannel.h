@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <vector>
+
+#include "DbgCmds.h"
+
+/*
+* Hands the records in each telemetry flush from the debuggee on to whatever has registered to consume them.
+* Records are handed over in place, straight out of the flush, so delivering a flush does not allocate however many records it holds.
+*/
+class TelemetryChannel
+	final
+{
+public:
+	// Called with each record's type and payload. The payload is only valid for the duration of the call.
+	using Consumer = std::function<void(const uint32_t type, const std::span<const uint8_t> payload)>;
+
+	// What has come through the channel.
+	struct Stats
+	{
+		uint64_t Flushes = 0;
+		uint64_t Records = 0;
+		uint64_t Bytes = 0; // Counting the headers and padding.
+		uint64_t Rejected = 0; // Flushes that were not of TELEMETRY_VERSION or were cut short.
+	};
+
+	// Registers consumer to be handed every record from then on, after those registered before it.
+	void AddConsumer(Consumer consumer) { m_Consumers.push_back(std::move(consumer)); }
+
+	/*
+	* Hands each record in flush, header first, to every consumer in turn. Returns false if the flush is not of TELEMETRY_VERSION,
+	* or is cut short, in which case the records before where it went wrong have still been delivered.
+	*/
+	bool Deliver(const std::span<const uint8_t> flush);
+
+	const Stats& GetStats() const { return m_Stats; }
+
+private:
+	std::vector<Consumer> m_Consumers;
+	Stats m_Stats;
+};
@@ -0,0 +1,163 @@
+#include "TraceReplay.h"
+
+#include <cstring>
+#include <format>
+#include <thread>
+
+#include "CdbSession.h"
+
+std::string_view TraceReplayTransport::Receive(const std::string_view data)
+{
+	char* const destination = m_Buffer.PrepareWrite(data.size());
+	std::memcpy(destination, data.data(), data.size());
+	m_Buffer.CommitWrite(data.size());
+	return std::string_view(destination, data.size());
+}
+
+bool TraceReplayTransport::Write(const std::string_view text)
+{
+	++m_WriteCount;
+
+	TraceRecord record;
+	const bool recorded = NextRecordedWrite(m_NextWriteOffset, record);
+	if (!recorded || record.Data != text)
+	{
+		if (!m_MismatchedWrites++)
+		{
+			m_FirstMismatch = recorded ? std::format("Write {} was \"{}\", but \"{}\" was recorded.", m_WriteCount, text, record.Data)
+				: std::format("Write {} was \"{}\", but the recording made no more writes.", m_WriteCount, text);
+		}
+	}
+
+	return true;
+}
+
+bool TraceReplayTransport::NextFrame(std::string_view& outFrame, OutputTokenizer& tokenizer, int& frameType)
+{
+	// Release the frame handed out by the last call.
+	m_Buffer.Consume(m_FrameLength);
+	m_FrameLength = 0;
+
+	const std::string_view unconsumed = m_Buffer.Unconsumed();
+	size_t frameLength;
+	if (tokenizer.Scan(unconsumed, frameLength, frameType))
+	{
+		outFrame = unconsumed.substr(0, frameLength);
+		m_FrameLength = frameLength;
+		return true;
+	}
+
+	return false;
+}
+
+bool TraceReplayTransport::ReadDump(const std::filesystem::path&, std::vector<uint8_t>& image)
+{
+	TraceRecord record;
+	while (m_Trace.Next(m_NextDumpOffset, record))
+	{
+		if (record.Direction == TraceDirection::Dump)
+		{
+			image.assign((const uint8_t*)record.Data.data(), (const uint8_t*)record.Data.data() + record.Data.size());
+			return !image.empty();
+		}
+	}
+
+	image.clear();
+	return false;
+}
+
+uint64_t TraceReplayTransport::CountMissingWrites() const
+{
+	uint64_t count = 0;
+	size_t offset = m_NextWriteOffset;
+	TraceRecord record;
+	while (NextRecordedWrite(offset, record))
+	{
+		++count;
+	}
+	return count;
+}
+
+bool TraceReplayTransport::NextRecordedWrite(size_t& offset, TraceRecord& record) const
+{
+	while (m_Trace.Next(offset, record))
+	{
+		if (record.Direction == TraceDirection::Write)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+TraceReplay::Result TraceReplay::Run(const TraceReader& trace, const Speed speed, std::ostream* const log)
+{
+	TraceReplayTransport transport(trace);
+
+	// Nothing holds the session's output back, so the oldest is dropped if it is not being written out.
+	CdbSession session(transport, LogRing::DEFAULT_MEMORY_CAP, LogRing::OverflowPolicy::DropOldest);
+
+	// Has the session dump memory to the same files as the recorded one did, so it writes the same commands.
+	size_t offset = TraceReader::FIRST_RECORD_OFFSET;
+	TraceRecord record;
+	while (trace.Next(offset, record))
+	{
+		if (record.Direction == TraceDirection::DumpPrefix)
+		{
+			session.SetDumpFilePrefix(std::filesystem::path(std::string(record.Data)));
+			break;
+		}
+	}
+	session.Begin();
+
+	const auto writeLog = [&]()
+	{
+		LogRing& sessionLog = session.GetLog();
+		while (const LogRing::Chunk* const chunk = sessionLog.Acquire())
+		{
+			if (log)
+			{
+				log->write(chunk->GetText().data(), chunk->GetText().size());
+			}
+			sessionLog.Release(chunk);
+		}
+	};
+
+	Result result;
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	offset = TraceReader::FIRST_RECORD_OFFSET;
+	while (trace.Next(offset, record))
+	{
+		if (record.Direction != TraceDirection::Read)
+		{
+			continue;
+		}
+
+		if (speed == Speed::Recorded)
+		{
+			std::this_thread::sleep_until(start + std::chrono::nanoseconds(record.Timestamp));
+		}
+
+		++result.Reads;
+		result.BytesRead += record.Data.size();
+		if (session.QueueFrames(transport.Receive(record.Data)))
+		{
+			session.DrainFrames();
+		}
+		writeLog();
+
+		// The session stops when the debuggee exits, after which the recording has nothing more that it would handle.
+		if (!session.IsRunning())
+		{
+			result.Stopped = true;
+			break;
+		}
+	}
+	result.Elapsed = std::chrono::steady_clock::now() - start;
+
+	result.Writes = transport.GetWriteCount();
+	result.MismatchedWrites = transport.GetMismatchedWrites();
+	result.MissingWrites = transport.CountMissingWrites();
+	result.FirstMismatch = transport.GetFirstMismatch();
+	return result;
+}
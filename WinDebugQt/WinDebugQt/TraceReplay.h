@@ -0,0 +1,96 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+#include "ICdbTransport.h"
+#include "SessionTrace.h"
+#include "StreamBuffer.h"
+
+/*
+* Stands in for CDB by playing back a trace. Output is fed in with Receive, and everything the session writes is checked against what the
+* recorded session wrote at the same point, so a replay that goes a different way from the recording shows up as mismatched writes.
+*/
+class TraceReplayTransport
+	final : public ICdbTransport
+{
+public:
+	explicit TraceReplayTransport(const TraceReader& trace) : m_Trace(trace) {}
+
+	// Adds data to the output waiting to be framed, as though CDB had just written it. Returns the copy added, valid until the next call.
+	std::string_view Receive(const std::string_view data);
+
+	// Checks text against the next write in the trace. Always succeeds, so the session carries on either way.
+	virtual bool Write(const std::string_view text) override;
+
+	virtual bool NextFrame(std::string_view& outFrame, OutputTokenizer& tokenizer, int& frameType) override;
+
+	// Serves the next dump in the trace, as the files CDB wrote are long gone by the time of a replay.
+	virtual bool ReadDump(const std::filesystem::path& path, std::vector<uint8_t>& image) override;
+
+	uint64_t GetWriteCount() const { return m_WriteCount; }
+	uint64_t GetMismatchedWrites() const { return m_MismatchedWrites; }
+
+	// The writes the recorded session made that the replayed one has not.
+	uint64_t CountMissingWrites() const;
+
+	// Describes the first write that did not match, or empty if they all have.
+	const std::string& GetFirstMismatch() const { return m_FirstMismatch; }
+
+private:
+	// Finds the next write in the trace from offset, moving offset past it.
+	bool NextRecordedWrite(size_t& offset, TraceRecord& record) const;
+
+	const TraceReader& m_Trace;
+
+	// Where to look for the next recorded write from. Writes are matched in order, on their own pass through the trace,
+	// as the session writes in response to output it is given before the replay reaches the recorded write.
+	size_t m_NextWriteOffset = TraceReader::FIRST_RECORD_OFFSET;
+
+	// Where to look for the next recorded dump from. Dumps are served in order, on their own pass like writes.
+	size_t m_NextDumpOffset = TraceReader::FIRST_RECORD_OFFSET;
+
+	uint64_t m_WriteCount = 0;
+	uint64_t m_MismatchedWrites = 0;
+	std::string m_FirstMismatch;
+
+	StreamBuffer m_Buffer;
+	size_t m_FrameLength = 0; // Length of the frame last handed out by NextFrame, which is released on the next call.
+};
+
+/*
+* Runs a recorded trace back through a CdbSession on the calling thread, without CDB, Windows, or the GUI.
+* Used to reproduce a session offline, and to measure how quickly sessions handle real output.
+*/
+class TraceReplay
+	final
+{
+public:
+	enum class Speed
+	{
+		Recorded, // Feeds each read in at the time it was recorded.
+		Maximum, // Feeds each read in as soon as the last one has been handled.
+	};
+
+	struct Result
+	{
+		uint64_t Reads = 0;
+		uint64_t BytesRead = 0;
+		uint64_t Writes = 0;
+		uint64_t MismatchedWrites = 0;
+		uint64_t MissingWrites = 0;
+		std::string FirstMismatch;
+
+		// Whether the session stopped itself before the end of the trace, which it does when the debuggee exits.
+		bool Stopped = false;
+
+		// The time taken to feed in and handle every read.
+		std::chrono::nanoseconds Elapsed{};
+	};
+
+	// Replays trace through a new session, writing the session's log to log if it is given.
+	static Result Run(const TraceReader& trace, const Speed speed, std::ostream* const log = nullptr);
+};
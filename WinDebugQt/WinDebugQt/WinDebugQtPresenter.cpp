@@ -1,7 +1,10 @@
 #include "WinDebugQtPresenter.h"
 
-#include <QScrollBar>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFileDialog>
 #include <QTimer> 
+#include <fstream>
 #include <string>
 
 WinDebugQtPresenter::WinDebugQtPresenter(IDebugHandler& model, QWidget* const parent)
@@ -9,6 +12,30 @@ WinDebugQtPresenter::WinDebugQtPresenter(IDebugHandler& model, QWidget* const pa
     QMainWindow(parent)
 {
     m_Ui.setupUi(this);
+    m_Ui.sessionView->addItem("All sessions");
+    m_Ui.debugOutput->setModel(&m_AggregateLog);
+
+    // A row for each debug command, then one for each phase of handling them.
+    QStringList latencyRows;
+    for (size_t opCode = 0; opCode < SessionProfile::DBG_CMD_COUNT; ++opCode)
+    {
+        latencyRows.append(QString::fromUtf8(SessionProfile::GetDbgCmdName(opCode)));
+    }
+    for (size_t phase = 0; phase < SessionProfile::PHASE_COUNT; ++phase)
+    {
+        latencyRows.append(QString::fromUtf8(SessionProfile::GetPhaseName((SessionProfile::Phase)phase)));
+    }
+    m_Ui.latencyTable->setRowCount(latencyRows.size());
+    m_Ui.latencyTable->setVerticalHeaderLabels(latencyRows);
+    for (int row = 0; row < m_Ui.latencyTable->rowCount(); ++row)
+    {
+        for (int column = 0; column < m_Ui.latencyTable->columnCount(); ++column)
+        {
+            QTableWidgetItem* const item = new QTableWidgetItem();
+            item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+            m_Ui.latencyTable->setItem(row, column, item);
+        }
+    }
 
     QTimer* const timer = new QTimer(this);
     connect(timer, &QTimer::timeout, this, QOverload<>::of(&WinDebugQtPresenter::UpdateTick));
@@ -17,38 +44,184 @@ WinDebugQtPresenter::WinDebugQtPresenter(IDebugHandler& model, QWidget* const pa
 
 void WinDebugQtPresenter::UpdateTick()
 {
-    // Get data pending in the model and feed it into the view.
-    std::string logData = m_Model.GetLogData();
+    // Get data pending in each session of the model, and add it to that session's log and the aggregate one.
+    // Index 0 of the view is all of the sessions, so session n is index n + 1.
+    const int view = m_Ui.sessionView->currentIndex();
+    bool shownLogChanged = false;
+    uint64_t droppedBytes = 0;
+    for (size_t session = 0; session < m_SessionLogs.size(); ++session)
+    {
+        LogRing* const log = m_Model.GetLog(session);
+        if (!log)
+        {
+            continue;
+        }
+
+        const bool shown = view <= 0 || (size_t)view == session + 1;
 
-    if (!logData.empty())
+        // Chunks are read in place and handed straight back, so the session can reuse them.
+        while (const LogRing::Chunk* const chunk = log->Acquire())
+        {
+            const std::string_view sessionData = chunk->GetText();
+            m_SessionLogs[session]->Append(sessionData);
+
+            m_TaggedData.clear();
+            AppendTagged(m_TaggedData, session, sessionData);
+            m_AggregateLog.Append(m_TaggedData);
+
+            shownLogChanged |= shown;
+            log->Release(chunk);
+        }
+
+        if (shown)
+        {
+            droppedBytes += log->GetDroppedBytes();
+        }
+    }
+
+    // The view only asks the log for the lines it shows, so it stays just as quick however long the log gets.
+    // New lines go at the end, so the view keeps its position unless autoscroll is on.
+    if (shownLogChanged && m_Ui.autoScroll->isChecked())
     {
-        // Since the model may be inserting sameline text between updates, we cannot use QTextEdit::append as that forces a new line between calls.
-        // So, we use QTextEdit::insertPlainText which inserts text at the current cursor position. We want to append to the end of the current text, so we must move the cursor to the end.
-        // Since moving the cursor position moves the scrollbar, we must store the original scrollbar value and restore it after (unless autoscroll is on, in which case we want it to scroll to the end anyway).
-        QScrollBar* const scrollBar = m_Ui.debugOutput->verticalScrollBar();
-        const int prevVal = scrollBar->value();
+        m_Ui.debugOutput->scrollToBottom();
+    }
 
-        m_Ui.debugOutput->moveCursor(QTextCursor::End);
-        m_Ui.debugOutput->insertPlainText(logData.c_str());
+    if (m_Ui.profileEnabled->isChecked() && m_Ui.latencyDock->isVisible() && ++m_TicksSinceProfileShown >= PROFILE_REFRESH_TICKS)
+    {
+        ShowProfile();
+    }
 
-        if (!m_Ui.autoScroll->isChecked())
+    if (droppedBytes != m_ShownDroppedBytes)
+    {
+        m_ShownDroppedBytes = droppedBytes;
+        if (droppedBytes)
         {
-            scrollBar->setValue(prevVal);
+            m_Ui.statusBar->showMessage(QString("%1 bytes of output were dropped to stay within the log's memory cap.").arg(droppedBytes));
         }
         else
         {
-            // If a lot of text was inserted, we may not be at the end anymore so go to the end again.
-            m_Ui.debugOutput->moveCursor(QTextCursor::End);
+            m_Ui.statusBar->clearMessage();
+        }
+    }
+}
+
+void WinDebugQtPresenter::AppendTagged(std::string& out, const size_t session, const std::string_view data)
+{
+    const std::string tag = "[" + std::to_string(session + 1) + "] ";
+    size_t lineStart = 0;
+    while (lineStart < data.size())
+    {
+        if (m_SessionAtLineStart[session])
+        {
+            out += tag;
+        }
+
+        const size_t lineEnd = data.find('\n', lineStart);
+        const size_t next = lineEnd == std::string_view::npos ? data.size() : lineEnd + 1;
+        out.append(data.substr(lineStart, next - lineStart));
+
+        // Anything after a partial line, like a prompt, is the same line continuing next time.
+        m_SessionAtLineStart[session] = lineEnd != std::string_view::npos;
+        lineStart = next;
+    }
+}
+
+LogModel* WinDebugQtPresenter::GetSelectedLog()
+{
+    const int view = m_Ui.sessionView->currentIndex();
+    return view <= 0 || (size_t)view > m_SessionLogs.size() ? &m_AggregateLog : m_SessionLogs[view - 1].get();
+}
+
+void WinDebugQtPresenter::ShowSelectedLog()
+{
+    // The view makes a new selection model for each model it is given, but leaves the old one to us.
+    QItemSelectionModel* const oldSelection = m_Ui.debugOutput->selectionModel();
+    m_Ui.debugOutput->setModel(GetSelectedLog());
+    delete oldSelection;
+
+    m_Ui.debugOutput->scrollToBottom();
+
+    // Search results are lines of the log that was shown before.
+    m_Ui.searchResults->clear();
+}
+
+void WinDebugQtPresenter::GatherProfile()
+{
+    const int view = m_Ui.sessionView->currentIndex();
+    m_ShownProfile.Reset();
+    for (size_t session = 0; session < m_Model.GetSessionCount(); ++session)
+    {
+        SessionProfile* const profile = m_Model.GetProfile(session);
+        if (profile && (view <= 0 || (size_t)view == session + 1))
+        {
+            m_ShownProfile.Merge(*profile);
+        }
+    }
+}
+
+void WinDebugQtPresenter::ShowProfile()
+{
+    m_TicksSinceProfileShown = 0;
+    GatherProfile();
+
+    const auto showRow = [this](const int row, const LatencyHistogram& histogram)
+    {
+        const double microseconds[] = { histogram.GetMean() / 1e3, histogram.GetPercentile(50) / 1e3, histogram.GetPercentile(99) / 1e3,
+            histogram.GetPercentile(99.9) / 1e3, histogram.GetMax() / 1e3 };
+
+        m_Ui.latencyTable->item(row, 0)->setText(QString::number(histogram.GetCount()));
+        for (int column = 1; column < m_Ui.latencyTable->columnCount(); ++column)
+        {
+            m_Ui.latencyTable->item(row, column)->setText(histogram.GetCount() ? QString::number(microseconds[column - 1], 'f', 1) : QString());
         }
+    };
+
+    int row = 0;
+    for (size_t opCode = 0; opCode < SessionProfile::DBG_CMD_COUNT; ++opCode)
+    {
+        showRow(row++, m_ShownProfile.GetDbgCmd(opCode));
+    }
+    for (size_t phase = 0; phase < SessionProfile::PHASE_COUNT; ++phase)
+    {
+        showRow(row++, m_ShownProfile.GetPhase((SessionProfile::Phase)phase));
     }
 }
 
+std::filesystem::path WinDebugQtPresenter::GetArchiveDirectory(const QString& name)
+{
+    return std::filesystem::path(QDir::temp().filePath(QString("WinDebugQt.%1.%2").arg(QCoreApplication::applicationPid()).arg(name)).toStdWString());
+}
+
 void WinDebugQtPresenter::on_startTool_clicked()
 {
     m_Ui.startTool->setDisabled(true);
-    m_Ui.debugOutput->clear();
+    m_Ui.sessionCount->setDisabled(true);
+
+    m_Model.StartButtonPressed(m_Ui.sessionCount->value());
+
+    // Start over with a log per session, and an entry in the view for each of them.
+    const size_t sessionCount = m_Model.GetSessionCount();
+    m_Ui.sessionView->blockSignals(true);
+    m_Ui.sessionView->clear();
+    m_Ui.sessionView->addItem("All sessions");
+    for (size_t session = 0; session < sessionCount; ++session)
+    {
+        m_Ui.sessionView->addItem(QString("Session %1").arg(session + 1));
+    }
+    m_Ui.sessionView->blockSignals(false);
+
+    // The view is back on the aggregate log now, so the old session logs can go.
+    m_AggregateLog.Clear();
+    ShowSelectedLog();
+
+    m_SessionLogs.clear();
+    for (size_t session = 0; session < sessionCount; ++session)
+    {
+        m_SessionLogs.push_back(std::make_unique<LogModel>(GetArchiveDirectory(QString("session-%1").arg(session + 1))));
+    }
+    m_SessionAtLineStart.assign(sessionCount, true);
+    ShowProfile();
 
-    m_Model.StartButtonPressed();
     m_Ui.stopTool->setDisabled(false);
 }
 
@@ -57,4 +230,76 @@ void WinDebugQtPresenter::on_stopTool_clicked()
     m_Ui.stopTool->setDisabled(true);
     m_Model.StopButtonPressed();
     m_Ui.startTool->setDisabled(false);
+    m_Ui.sessionCount->setDisabled(false);
+}
+
+void WinDebugQtPresenter::on_sessionView_currentIndexChanged(const int)
+{
+    ShowSelectedLog();
+    ShowProfile();
+}
+
+void WinDebugQtPresenter::on_searchText_returnPressed()
+{
+    LogSearchQuery query;
+    query.Pattern = m_Ui.searchText->text().toStdString();
+    query.Regex = m_Ui.searchRegex->isChecked();
+    query.CaseSensitive = m_Ui.searchCase->isChecked();
+
+    const std::vector<LogSearchHit> hits = GetSelectedLog()->Search(query);
+
+    m_Ui.searchResults->clear();
+    for (const LogSearchHit& hit : hits)
+    {
+        QListWidgetItem* const item = new QListWidgetItem(QString("%1: %2").arg(hit.Line + 1).arg(QString::fromStdString(hit.Text)), m_Ui.searchResults);
+        item->setData(Qt::UserRole, (qulonglong)hit.Line);
+    }
+
+    m_Ui.statusBar->showMessage(QString(hits.size() < query.MaxHits ? "%1 matching lines" : "Showing the first %1 matching lines").arg(hits.size()), 5000);
+}
+
+void WinDebugQtPresenter::on_searchResults_itemActivated(QListWidgetItem* const item)
+{
+    // Stop autoscroll from taking the view away from the line as soon as more output comes in.
+    m_Ui.autoScroll->setChecked(false);
+
+    const QModelIndex line = m_Ui.debugOutput->model()->index((int)item->data(Qt::UserRole).toULongLong(), 0);
+    m_Ui.debugOutput->setCurrentIndex(line);
+    m_Ui.debugOutput->scrollTo(line, QAbstractItemView::PositionAtCenter);
+}
+
+void WinDebugQtPresenter::on_profileEnabled_toggled(const bool checked)
+{
+    m_Model.SetProfiling(checked);
+}
+
+void WinDebugQtPresenter::on_resetProfile_clicked()
+{
+    const int view = m_Ui.sessionView->currentIndex();
+    for (size_t session = 0; session < m_Model.GetSessionCount(); ++session)
+    {
+        SessionProfile* const profile = m_Model.GetProfile(session);
+        if (profile && (view <= 0 || (size_t)view == session + 1))
+        {
+            profile->Reset();
+        }
+    }
+    ShowProfile();
+}
+
+void WinDebugQtPresenter::on_exportProfile_clicked()
+{
+    QString selectedFilter;
+    const QString fileName = QFileDialog::getSaveFileName(this, "Export latency", QString(), "JSON (*.json);;CSV (*.csv)", &selectedFilter);
+    if (fileName.isEmpty())
+    {
+        return;
+    }
+
+    GatherProfile();
+    const bool csv = selectedFilter.startsWith("CSV") || fileName.endsWith(".csv", Qt::CaseInsensitive);
+    std::ofstream file(std::filesystem::path(fileName.toStdWString()), std::ios::binary);
+    file << (csv ? m_ShownProfile.ToCsv() : m_ShownProfile.ToJson());
+
+    m_Ui.statusBar->showMessage(file.good() ? QString("Exported latency to %1").arg(fileName) : QString("Could not write %1").arg(fileName), 5000);
 }
\ No newline at end of file
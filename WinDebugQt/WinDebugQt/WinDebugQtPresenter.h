@@ -3,8 +3,16 @@
 #include "ui_WinDebugQtGUI.h"
 
 #include "IDebugHandler.h"
+#include "LogModel.h"
+#include "SessionProfile.h"
 
 #include <QtWidgets/QMainWindow>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
 
 // Presenter class. Fetches data from the debug handler model and updates the view. Sends input commands to the model.
 class WinDebugQtPresenter : public QMainWindow
@@ -17,11 +25,60 @@ public:
 private:
     void UpdateTick();
 
+    // Appends data from a session to the aggregate log in out, tagging each line with the session it came from.
+    void AppendTagged(std::string& out, const size_t session, const std::string_view data);
+
+    // The log of whichever session is selected in the view, or of all of them.
+    LogModel* GetSelectedLog();
+
+    // Shows the output of whichever session is selected in the view, or of all of them.
+    void ShowSelectedLog();
+
+    // Sums up what the sessions in view have measured into m_ShownProfile.
+    void GatherProfile();
+
+    // Shows what the sessions in view have measured in the latency table.
+    void ShowProfile();
+
+    // Where a log named name is archived. Named after the process, so several instances do not share them.
+    static std::filesystem::path GetArchiveDirectory(const QString& name);
+
     Ui::WinDebugQtGUIClass m_Ui;
     IDebugHandler& m_Model;
 
+    // The number of lines of the aggregate log kept in memory before the oldest are spilled to disk. Each session's log keeps LogModel's default.
+    static constexpr size_t AGGREGATE_RETAINED_LINES = 100000;
+
+    // Everything each session has output since it was started, so the view can switch between them.
+    std::vector<std::unique_ptr<LogModel>> m_SessionLogs;
+
+    // Whether the next output from each session starts a new line in m_AggregateLog.
+    std::vector<bool> m_SessionAtLineStart;
+
+    // The output of every session, interleaved in the order it was fetched.
+    LogModel m_AggregateLog{ GetArchiveDirectory("aggregate"), AGGREGATE_RETAINED_LINES };
+
+    // Session output tagged for the aggregate log. Kept around so its buffer is reused.
+    std::string m_TaggedData;
+
+    // The number of dropped bytes last shown in the status bar, for whichever sessions are in view.
+    uint64_t m_ShownDroppedBytes = 0;
+
+    // The latency table is refreshed every this many ticks, as going through every histogram of every session each tick would be wasted.
+    static constexpr int PROFILE_REFRESH_TICKS = 10;
+    int m_TicksSinceProfileShown = 0;
+
+    // What the sessions in view have measured, summed up.
+    SessionProfile m_ShownProfile;
+
     // Slots are handlers corresponding to buttons in WinDebugQtGUI.ui view.
 private slots:
     void on_startTool_clicked();
     void on_stopTool_clicked();
+    void on_sessionView_currentIndexChanged(const int index);
+    void on_searchText_returnPressed();
+    void on_searchResults_itemActivated(QListWidgetItem* const item);
+    void on_profileEnabled_toggled(const bool checked);
+    void on_resetProfile_clicked();
+    void on_exportProfile_clicked();
 };
@@ -1,13 +1,94 @@
 #include <QtWidgets/QApplication>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <vector>
 
+#ifdef __linux__
+#include "PtraceDebugHandler.h"
+#else
 #include "DebugHandler.h"
+#endif
+#include "TraceReplay.h"
 #include "WinDebugQtPresenter.h"
 
+// Replays a session trace and reports how it went, without CDB or a window. Returns nonzero if the replay did not write what the recording did.
+static int ReplayTrace(const char* const path, const TraceReplay::Speed speed, const bool showLog)
+{
+    TraceReader trace;
+    if (!trace.Open(path))
+    {
+        std::cerr << std::format("Could not open {} as a session trace.\n", path);
+        return 1;
+    }
+
+    const TraceReplay::Result result = TraceReplay::Run(trace, speed, showLog ? &std::cout : nullptr);
+    const double seconds = std::chrono::duration<double>(result.Elapsed).count();
+    std::cout << std::format("{} reads ({} bytes) replayed in {:.3f} s, {:.1f} MB/s{}.\n", result.Reads, result.BytesRead, seconds,
+        seconds > 0 ? result.BytesRead / seconds / (1024 * 1024) : 0.0, result.Stopped ? ", until the debuggee exited" : "");
+    std::cout << std::format("{} writes, {} mismatched, {} recorded writes never made.\n", result.Writes, result.MismatchedWrites, result.MissingWrites);
+    if (!result.FirstMismatch.empty())
+    {
+        std::cout << result.FirstMismatch << "\n";
+    }
+
+    return result.MismatchedWrites || result.MissingWrites ? 2 : 0;
+}
+
 int main(int argc, char *argv[])
 {
+    // WinDebugQt --replay <trace> [--max-speed] [--log] replays a trace recorded with --trace instead of showing the GUI.
+    if (argc >= 3 && std::strcmp(argv[1], "--replay") == 0)
+    {
+        TraceReplay::Speed speed = TraceReplay::Speed::Recorded;
+        bool showLog = false;
+        for (int i = 3; i < argc; ++i)
+        {
+            if (std::strcmp(argv[i], "--max-speed") == 0)
+            {
+                speed = TraceReplay::Speed::Maximum;
+            }
+            else if (std::strcmp(argv[i], "--log") == 0)
+            {
+                showLog = true;
+            }
+        }
+        return ReplayTrace(argv[2], speed, showLog);
+    }
+
     QApplication a(argc, argv);
 
+#ifdef __linux__
+    PtraceDebugHandler dh;
+#else
     DebugHandler dh;
+
+    // WinDebugQt [--trace <directory>] [--event <event>=<log|count|sample:N|stop>]...
+    // --trace records a trace of every session, to replay later. Each --event has CDB deal with an event by policy, rather than the session.
+    std::vector<EventPolicy> eventPolicies;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (std::strcmp(argv[i], "--trace") == 0)
+        {
+            dh.SetTraceDirectory(argv[i + 1]);
+        }
+        else if (std::strcmp(argv[i], "--event") == 0)
+        {
+            EventPolicy policy;
+            if (!EventPolicy::Parse(argv[i + 1], policy))
+            {
+                std::cerr << std::format("Bad event policy {}.\n", argv[i + 1]);
+                return 1;
+            }
+            eventPolicies.push_back(std::move(policy));
+        }
+    }
+    if (!dh.SetEventPolicies(std::move(eventPolicies)))
+    {
+        std::cerr << std::format("At most {} events can be counted.\n", EventFilters::MAX_COUNTERS);
+        return 1;
+    }
+#endif
     WinDebugQtPresenter w(dh);
     w.show();
 
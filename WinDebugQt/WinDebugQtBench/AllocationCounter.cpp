@@ -0,0 +1,125 @@
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+	std::atomic<uint64_t> g_Allocations = 0;
+	std::atomic<uint64_t> g_Bytes = 0;
+
+	void* Allocate(const size_t size)
+	{
+		g_Allocations.fetch_add(1, std::memory_order_relaxed);
+		g_Bytes.fetch_add(size, std::memory_order_relaxed);
+		return std::malloc(size ? size : 1);
+	}
+
+	void* AllocateAligned(const size_t size, const std::align_val_t alignment)
+	{
+		g_Allocations.fetch_add(1, std::memory_order_relaxed);
+		g_Bytes.fetch_add(size, std::memory_order_relaxed);
+#ifdef _WIN32
+		return _aligned_malloc(size ? size : 1, (size_t)alignment);
+#else
+		// aligned_alloc needs the size to be a multiple of the alignment.
+		const size_t align = (size_t)alignment;
+		return std::aligned_alloc(align, (size + align - 1) / align * align);
+#endif
+	}
+
+	void FreeAligned(void* const memory)
+	{
+#ifdef _WIN32
+		_aligned_free(memory);
+#else
+		std::free(memory);
+#endif
+	}
+}
+
+AllocationCounter::Counts AllocationCounter::Get()
+{
+	return { g_Allocations.load(std::memory_order_relaxed), g_Bytes.load(std::memory_order_relaxed) };
+}
+
+void* operator new(const size_t size)
+{
+	void* const memory = Allocate(size);
+	if (!memory)
+	{
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void* operator new[](const size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(const size_t size, const std::nothrow_t&) noexcept
+{
+	return Allocate(size);
+}
+
+void* operator new[](const size_t size, const std::nothrow_t&) noexcept
+{
+	return Allocate(size);
+}
+
+void* operator new(const size_t size, const std::align_val_t alignment)
+{
+	void* const memory = AllocateAligned(size, alignment);
+	if (!memory)
+	{
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void* operator new[](const size_t size, const std::align_val_t alignment)
+{
+	return operator new(size, alignment);
+}
+
+void operator delete(void* const memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* const memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* const memory, size_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* const memory, size_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* const memory, const std::align_val_t) noexcept
+{
+	FreeAligned(memory);
+}
+
+void operator delete[](void* const memory, const std::align_val_t) noexcept
+{
+	FreeAligned(memory);
+}
+
+void operator delete(void* const memory, size_t, const std::align_val_t) noexcept
+{
+	FreeAligned(memory);
+}
+
+void operator delete[](void* const memory, size_t, const std::align_val_t) noexcept
+{
+	FreeAligned(memory);
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+* Counts every allocation made through operator new in this program, so each benchmark can report what it allocates per operation.
+* Linking AllocationCounter.cpp in replaces the global operator new and delete.
+*/
+namespace AllocationCounter
+{
+	struct Counts
+	{
+		uint64_t Allocations = 0;
+		uint64_t Bytes = 0;
+	};
+
+	// Everything allocated so far. Subtract two snapshots to get what was allocated between them.
+	Counts Get();
+}
@@ -0,0 +1,647 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "AllocationCounter.h"
+#include "CallbackRegistry.h"
+#include "CdbCommandBuilder.h"
+#include "CdbCommands.h"
+#include "CdbSession.h"
+#include "DbgCmdSites.h"
+#include "DbgCmds.h"
+#include "FakeCdb.h"
+#include "LogRing.h"
+#include "OutputTokenizer.h"
+#include "RegisterContext.h"
+#include "Soak.h"
+#include "StreamBuffer.h"
+#include "TelemetryChannel.h"
+
+/*
+* Microbenchmarks of the paths every break goes through: framing CDB's output, parsing registers and memory dumps, finding and decoding debug commands,
+* looking up callbacks and formatting the commands that fire them, delivering telemetry, whole debug commands handled by a CdbSession, and draining the session's log.
+* CDB is played by FakeCdb, so the benchmarks run anywhere, without a debuggee.
+* Each one reports ns, allocations and bytes allocated per operation, and can be compared against a baseline file to catch regressions.
+*
+* WinDebugQtBench [--filter <text>] [--time <ms>] [--baseline <file>] [--tolerance <percent>] [--write-baseline <file>]
+* WinDebugQtBench --soak ... runs a soak instead; see Soak.h.
+*/
+
+namespace
+{
+	// Runs the operation being measured the given number of times. Anything set up beforehand is captured, so it is not measured.
+	using BenchmarkRun = std::function<void(const uint64_t iterations)>;
+
+	struct Benchmark
+	{
+		std::string_view Name;
+
+		// What one operation is.
+		std::string_view Operation;
+
+		std::function<BenchmarkRun()> Setup;
+	};
+
+	struct Measurement
+	{
+		double NsPerOp = 0;
+		double AllocationsPerOp = 0;
+		double BytesPerOp = 0;
+	};
+
+	// Measurements are repeated this many times, and the fastest one kept, as anything else running only ever slows them down.
+	constexpr int REPETITIONS = 5;
+
+	// Timings more than the tolerance slower than the baseline count as regressions. Allocations regress on any increase.
+	constexpr double DEFAULT_TOLERANCE_PERCENT = 15;
+
+	double SecondsSince(const std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	Measurement Measure(const BenchmarkRun& run, const double seconds)
+	{
+		// Warm up, doubling the iterations until a run takes a tenth of the time, so every buffer and pool has grown to what the benchmark needs.
+		uint64_t iterations = 1;
+		for (;;)
+		{
+			const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			run(iterations);
+			const double elapsed = SecondsSince(start);
+			if (elapsed >= seconds / 10)
+			{
+				iterations = (uint64_t)(iterations * (seconds / REPETITIONS) / elapsed) + 1;
+				break;
+			}
+			iterations *= 2;
+		}
+
+		Measurement measurement;
+		measurement.NsPerOp = 1e300;
+		const AllocationCounter::Counts before = AllocationCounter::Get();
+		for (int i = 0; i < REPETITIONS; ++i)
+		{
+			const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			run(iterations);
+			const double nsPerOp = SecondsSince(start) * 1e9 / iterations;
+			measurement.NsPerOp = nsPerOp < measurement.NsPerOp ? nsPerOp : measurement.NsPerOp;
+		}
+		const AllocationCounter::Counts after = AllocationCounter::Get();
+
+		const double operations = (double)iterations * REPETITIONS;
+		measurement.AllocationsPerOp = (after.Allocations - before.Allocations) / operations;
+		measurement.BytesPerOp = (after.Bytes - before.Bytes) / operations;
+		return measurement;
+	}
+
+	// Hands cdb's output to session a read at a time, the way DebugSession does, and drains the session's log the way the presenter does.
+	// Stops once there is no more output, or once stop says to.
+	void Pump(FakeCdb& cdb, CdbSession& session, const std::function<bool()>& stop)
+	{
+		while (cdb.HasOutput() && !stop())
+		{
+			if (session.QueueFrames(cdb.Read()))
+			{
+				session.DrainFrames();
+			}
+
+			LogRing& log = session.GetLog();
+			while (const LogRing::Chunk* const chunk = log.Acquire())
+			{
+				log.Release(chunk);
+			}
+		}
+	}
+
+	// Everything CDB prints over a run of a mix of debug commands and breakpoints, as it arrives in reads.
+	std::string RecordCdbOutput(const size_t eventCount)
+	{
+		static constexpr FakeCdb::Event MIX[] = { FakeCdb::Event::SetCallbacks, FakeCdb::Event::Nop, FakeCdb::Event::Breakpoint, FakeCdb::Event::RegisterAltStack };
+		size_t events = 0;
+		FakeCdb cdb([&]() { return events < eventCount ? MIX[events++ % std::size(MIX)] : FakeCdb::Event::Exit; });
+		CdbSession session(cdb, LogRing::DEFAULT_MEMORY_CAP, LogRing::OverflowPolicy::DropOldest);
+		session.Begin();
+
+		std::string output;
+		while (cdb.HasOutput())
+		{
+			const std::string_view read = cdb.Read();
+			output += read;
+			if (session.QueueFrames(read))
+			{
+				session.DrainFrames();
+			}
+		}
+		return output;
+	}
+
+	// The lines CDB prints in answer to a command, as the session would get them.
+	std::vector<std::string> RunCdbCommand(const std::string_view command)
+	{
+		FakeCdb cdb([]() { return FakeCdb::Event::SetCallbacks; });
+		cdb.Write("g\n");
+		while (cdb.HasOutput())
+		{
+			cdb.Read();
+		}
+
+		std::string text(command);
+		text += '\n';
+		cdb.Write(text);
+
+		std::string output;
+		while (cdb.HasOutput())
+		{
+			output += cdb.Read();
+		}
+
+		std::vector<std::string> lines;
+		std::istringstream stream(output);
+		for (std::string line; std::getline(stream, line);)
+		{
+			lines.push_back(line + '\n');
+		}
+		return lines;
+	}
+
+	BenchmarkRun SetupFraming()
+	{
+		struct State
+		{
+			std::string Output = RecordCdbOutput(1000);
+			size_t Position = 0;
+			StreamBuffer Buffer;
+			size_t FrameLength = 0;
+			OutputTokenizer Tokenizer;
+		};
+		const std::shared_ptr<State> state = std::make_shared<State>();
+
+		return [state](const uint64_t iterations)
+		{
+			// The same framing Process::NextFrame does, fed the recorded output a read at a time.
+			State& s = *state;
+			for (uint64_t frames = 0; frames < iterations;)
+			{
+				s.Buffer.Consume(s.FrameLength);
+				s.FrameLength = 0;
+
+				const std::string_view unconsumed = s.Buffer.Unconsumed();
+				size_t frameLength;
+				int frameType;
+				if (s.Tokenizer.Scan(unconsumed, frameLength, frameType))
+				{
+					s.FrameLength = frameLength;
+					++frames;
+					continue;
+				}
+
+				if (s.Position == s.Output.size())
+				{
+					s.Position = 0;
+				}
+				const size_t size = s.Output.size() - s.Position < FakeCdb::READ_SIZE ? s.Output.size() - s.Position : FakeCdb::READ_SIZE;
+				std::memcpy(s.Buffer.PrepareWrite(size), s.Output.data() + s.Position, size);
+				s.Buffer.CommitWrite(size);
+				s.Position += size;
+			}
+		};
+	}
+
+	BenchmarkRun SetupRegisterDump()
+	{
+		const std::shared_ptr<std::vector<std::string>> lines = std::make_shared<std::vector<std::string>>(RunCdbCommand(RegisterContextParser::REGISTER_DUMP_COMMAND));
+		return [lines](const uint64_t iterations)
+		{
+			for (uint64_t i = 0; i < iterations; ++i)
+			{
+				RegisterContextParser parser;
+				RegisterContext context;
+				bool complete = false;
+				for (const std::string& line : *lines)
+				{
+					complete = parser.ParseLine(line, context);
+				}
+				if (!complete)
+				{
+					std::fputs("The register dump did not parse.\n", stderr);
+					std::exit(1);
+				}
+			}
+		};
+	}
+
+	BenchmarkRun SetupFindRegister()
+	{
+		const std::shared_ptr<std::vector<std::string>> lines = std::make_shared<std::vector<std::string>>(RunCdbCommand("r"));
+		return [lines](const uint64_t iterations)
+		{
+			// rdx is on the second line of r's output, so the first is searched and skipped, just as a RegisterQuery would.
+			uint64_t value = 0;
+			for (uint64_t i = 0; i < iterations; ++i)
+			{
+				RegisterContextParser::FindRegister((*lines)[0], "rdx", value);
+				RegisterContextParser::FindRegister((*lines)[1], "rdx", value);
+			}
+		};
+	}
+
+	BenchmarkRun SetupDbgCmdDecode()
+	{
+		struct State
+		{
+			std::vector<std::string> Lines = RunCdbCommand("db @rip L8");
+			CdbCommandQueue Queue{ [](const std::string_view) {}, [](const CdbCommand&) {} };
+		};
+		const std::shared_ptr<State> state = std::make_shared<State>();
+
+		return [state](const uint64_t iterations)
+		{
+			// What HandlePrompt does with each break if the modules could not be scanned: read the bytes at rip and check them for a debug command.
+			for (uint64_t i = 0; i < iterations; ++i)
+			{
+				BytesQuery query(state->Queue, "@rip", DBG_CMD_SIGNATURE_SIZE);
+				state->Queue.Flush();
+				query.OnLine(state->Lines[0]);
+				const MemoryBytes memory = query.await_resume();
+
+				uint8_t opCode;
+				if (memory.Bytes.size() != DBG_CMD_SIGNATURE_SIZE || !ParseDbgCmdSignature(memory.Bytes.begin(), opCode))
+				{
+					std::fputs("The debug command did not decode.\n", stderr);
+					std::exit(1);
+				}
+				state->Queue.Clear();
+			}
+		};
+	}
+
+	BenchmarkRun SetupDbgCmdScan()
+	{
+		// A module's worth of code, mostly int 3 padding and short jmps to make the scan look at every candidate, with a debug command every 16 KB.
+		static constexpr size_t IMAGE_SIZE = 64 * 1024;
+		const std::shared_ptr<std::vector<uint8_t>> image = std::make_shared<std::vector<uint8_t>>(IMAGE_SIZE);
+		for (size_t i = 0; i < IMAGE_SIZE; ++i)
+		{
+			(*image)[i] = i % 7 == 0 ? 0xcc : i % 7 == 1 ? 0xeb : (uint8_t)(i * 31);
+		}
+		static constexpr DbgCmdStub DBG_CMD = MakeDbgCmdStub(debuggerCmdSetCallbacks);
+		for (size_t offset = 0x1000; offset < IMAGE_SIZE; offset += 16 * 1024)
+		{
+			std::memcpy(image->data() + offset, DBG_CMD.data(), DBG_CMD.size());
+		}
+
+		return [image](const uint64_t iterations)
+		{
+			std::vector<DbgCmdSites::Site> sites;
+			sites.reserve(8);
+			for (uint64_t i = 0; i < iterations; ++i)
+			{
+				sites.clear();
+				DbgCmdSites::Scan(image->data(), image->size(), FakeCdb::DBG_CMD_ADDRESS, sites);
+				if (sites.size() != IMAGE_SIZE / (16 * 1024))
+				{
+					std::fputs("The scan did not find every debug command.\n", stderr);
+					std::exit(1);
+				}
+			}
+		};
+	}
+
+	BenchmarkRun SetupCallbackLookup()
+	{
+		// A registry of 256 callbacks, each named like a debuggee function might be, loaded from qwords just as the session reads them.
+		static constexpr size_t CALLBACK_COUNT = 256;
+		struct State
+		{
+			std::vector<std::string> Names;
+			CallbackRegistry Registry;
+		};
+		const std::shared_ptr<State> state = std::make_shared<State>();
+		std::vector<uint64_t> qwords = { CALLBACK_REGISTRY_VERSION | (uint64_t)CALLBACK_COUNT << 32 };
+		for (size_t i = 0; i < CALLBACK_COUNT; ++i)
+		{
+			state->Names.push_back("DebuggeeCallback" + std::to_string(i));
+			qwords.insert(qwords.end(), { HashCallbackName(state->Names.back()), MakeCallbackSignature(i % 4, true), 0x00007ff66ce72200 + i * 0x40 });
+		}
+		if (!state->Registry.Load(qwords))
+		{
+			std::fputs("The callback registry did not load.\n", stderr);
+			std::exit(1);
+		}
+
+		return [state](const uint64_t iterations)
+		{
+			// Finding a callback by name: hashing the name and probing for its entry.
+			for (uint64_t i = 0; i < iterations; ++i)
+			{
+				if (!state->Registry.Find(state->Names[i % CALLBACK_COUNT]))
+				{
+					std::fputs("A registered callback was not found.\n", stderr);
+					std::exit(1);
+				}
+			}
+		};
+	}
+
+	BenchmarkRun SetupCallFormatting()
+	{
+		const std::shared_ptr<RegisterContext> context = std::make_shared<RegisterContext>();
+		RegisterContextParser parser;
+		for (const std::string& line : RunCdbCommand(RegisterContextParser::REGISTER_DUMP_COMMAND))
+		{
+			parser.ParseLine(line, *context);
+		}
+
+		// Built into the same buffers every time, as a session does.
+		const std::shared_ptr<CdbCommandBuilder> call = std::make_shared<CdbCommandBuilder>();
+		const std::shared_ptr<CdbCommandBuilder> restore = std::make_shared<CdbCommandBuilder>();
+		return [context, call, restore](const uint64_t iterations)
+		{
+			// Both of the commands Call sends for each callback.
+			for (uint64_t i = 0; i < iterations; ++i)
+			{
+				CdbSession::FormatCallCommand(*call, FakeCdb::RETURN_DOUBLE_ADDRESS, 0, { 7, 0, 0 });
+				CdbSession::FormatRestoreCommand(*restore, *context);
+			}
+		};
+	}
+
+	BenchmarkRun SetupTrampolineCallFormatting()
+	{
+		const std::shared_ptr<CdbCommandBuilder> command = std::make_shared<CdbCommandBuilder>();
+		return [command](const uint64_t iterations)
+		{
+			// The only command Call sends for each callback once the debuggee has a call trampoline, as it saves and restores the registers itself.
+			const CdbSession::CallbackCall call[] = { { FakeCdb::RETURN_DOUBLE_ADDRESS, { 7, 0, 0 } } };
+			for (uint64_t i = 0; i < iterations; ++i)
+			{
+				CdbSession::FormatTrampolineCallCommand(*command, FakeCdb::CALL_TRAMPOLINE_ADDRESS, 0, call);
+			}
+		};
+	}
+
+	// Handing a full telemetry flush to the consumers, with an operation being one flush delivered.
+	BenchmarkRun SetupTelemetryDeliver()
+	{
+		// A full buffer of the samples FakeCdb flushes, handed to a consumer that reads each one, as the session does with every flush.
+		struct State
+		{
+			TelemetryBuffer<FakeCdb::TELEMETRY_BUFFER_SIZE> Flush;
+			TelemetryChannel Channel;
+			uint64_t Sum = 0;
+		};
+		const std::shared_ptr<State> state = std::make_shared<State>();
+		for (uint64_t i = 0; i < FakeCdb::TELEMETRY_RECORD_COUNT; ++i)
+		{
+			const uint64_t sample[FakeCdb::TELEMETRY_PAYLOAD_SIZE / 8] = { i, i * 2, i * 3 };
+			state->Flush.Append(FakeCdb::TELEMETRY_RECORD_TYPE, sample, sizeof(sample));
+		}
+		state->Channel.AddConsumer([state = state.get()](const uint32_t, const std::span<const uint8_t> payload)
+		{
+			uint64_t first;
+			std::memcpy(&first, payload.data(), sizeof(first));
+			state->Sum += first;
+		});
+
+		return [state](const uint64_t iterations)
+		{
+			for (uint64_t i = 0; i < iterations; ++i)
+			{
+				if (!state->Channel.Deliver({ state->Flush.GetData(), state->Flush.GetSize() }))
+				{
+					std::fputs("The telemetry flush was rejected.\n", stderr);
+					std::exit(1);
+				}
+			}
+		};
+	}
+
+	// A session against a FakeCdb that fires event every time it is resumed, with an operation being one event handled.
+	// With callTrampoline, the debuggee registers its call trampoline first. With eventPolicy, the session sets that event filter up in CDB when it attaches.
+	BenchmarkRun SetupDbgCmd(const FakeCdb::Event event, const bool callTrampoline = false, const std::string_view eventPolicy = {})
+	{
+		struct State
+		{
+			uint64_t Events = 0;
+			std::unique_ptr<FakeCdb> Cdb;
+			std::unique_ptr<CdbSession> Session;
+		};
+		const std::shared_ptr<State> state = std::make_shared<State>();
+		state->Cdb = std::make_unique<FakeCdb>([state = state.get(), event, callTrampoline]()
+		{
+			return state->Events++ == 0 && callTrampoline ? FakeCdb::Event::RegisterCallTrampoline : event;
+		});
+		state->Session = std::make_unique<CdbSession>(*state->Cdb, LogRing::DEFAULT_MEMORY_CAP, LogRing::OverflowPolicy::DropOldest);
+		if (EventPolicy policy; !eventPolicy.empty() && (!EventPolicy::Parse(eventPolicy, policy) || !state->Session->SetEventPolicies({ policy })))
+		{
+			std::fputs("The event policy was not accepted.\n", stderr);
+			std::exit(1);
+		}
+		state->Session->Begin();
+
+		return [state](const uint64_t iterations)
+		{
+			const uint64_t target = state->Events + iterations;
+			Pump(*state->Cdb, *state->Session, [&]() { return state->Events >= target; });
+			if (state->Events < target)
+			{
+				std::fputs("The session stopped handling debug commands.\n", stderr);
+				std::exit(1);
+			}
+			if (state->Session->GetTelemetryStats().Rejected != 0)
+			{
+				std::fputs("The session could not read the telemetry flushed.\n", stderr);
+				std::exit(1);
+			}
+		};
+	}
+
+	BenchmarkRun SetupLogDrain()
+	{
+		const std::shared_ptr<LogRing> log = std::make_shared<LogRing>(LogRing::DEFAULT_MEMORY_CAP, LogRing::OverflowPolicy::DropOldest);
+		return [log](const uint64_t iterations)
+		{
+			// Lines are written as the session handles them, and drained in batches, as the presenter only looks every so often.
+			static constexpr std::string_view LINE = "rax=0000000000000000 rbx=0000000000000000 rcx=00007ff66ce7d170\n";
+			static constexpr uint64_t LINES_PER_DRAIN = 64;
+			for (uint64_t i = 0; i < iterations; ++i)
+			{
+				log->Write(LINE);
+				if (i % LINES_PER_DRAIN == LINES_PER_DRAIN - 1)
+				{
+					while (const LogRing::Chunk* const chunk = log->Acquire())
+					{
+						log->Release(chunk);
+					}
+				}
+			}
+		};
+	}
+
+	const Benchmark BENCHMARKS[] =
+	{
+		{ "Framing", "frame", SetupFraming },
+		{ "RegisterDump", "dump", SetupRegisterDump },
+		{ "FindRegister", "query", SetupFindRegister },
+		{ "DbgCmdDecode", "break", SetupDbgCmdDecode },
+		{ "DbgCmdScan", "64 KB", SetupDbgCmdScan },
+		{ "CallbackLookup", "lookup", SetupCallbackLookup },
+		{ "CallFormatting", "call", SetupCallFormatting },
+		{ "TrampolineCallFormatting", "call", SetupTrampolineCallFormatting },
+		{ "TelemetryDeliver", "64 KB", SetupTelemetryDeliver },
+		{ "DbgCmdNop", "command", []() { return SetupDbgCmd(FakeCdb::Event::Nop); } },
+		{ "DbgCmdSetCallbacks", "command", []() { return SetupDbgCmd(FakeCdb::Event::SetCallbacks); } },
+		{ "DbgCmdSetCallbacksTrampoline", "command", []() { return SetupDbgCmd(FakeCdb::Event::SetCallbacks, true); } },
+		// Logging access violations must still leave the callbacks' returns to rip 0 to the session, or FakeCdb's debuggee crashes.
+		{ "DbgCmdSetCallbacksLoggingAv", "command", []() { return SetupDbgCmd(FakeCdb::Event::SetCallbacks, false, "av=log"); } },
+		{ "DbgCmdFlushTelemetry", "64 KB", []() { return SetupDbgCmd(FakeCdb::Event::FlushTelemetry); } },
+		{ "LogDrain", "line", SetupLogDrain },
+	};
+
+	using Baseline = std::map<std::string, Measurement, std::less<>>;
+
+	// Each line of a baseline is a benchmark's name, ns/op, allocations/op and bytes/op. Lines starting with # are comments.
+	bool ReadBaseline(const char* const path, Baseline& baseline)
+	{
+		std::ifstream file(path);
+		if (!file)
+		{
+			return false;
+		}
+
+		for (std::string line; std::getline(file, line);)
+		{
+			if (line.empty() || line[0] == '#')
+			{
+				continue;
+			}
+
+			std::istringstream fields(line);
+			std::string name;
+			Measurement measurement;
+			if (fields >> name >> measurement.NsPerOp >> measurement.AllocationsPerOp >> measurement.BytesPerOp)
+			{
+				baseline[name] = measurement;
+			}
+		}
+		return true;
+	}
+
+	bool WriteBaseline(const char* const path, const Baseline& results)
+	{
+		std::ofstream file(path);
+		file << "# WinDebugQtBench baseline: name, ns/op, allocations/op, bytes/op.\n"
+			"# Regenerate with WinDebugQtBench --write-baseline <file> on the machine the numbers are compared on.\n";
+		char line[256];
+		for (const auto& [name, measurement] : results)
+		{
+			std::snprintf(line, sizeof(line), "%s %.2f %.3f %.1f\n", name.c_str(), measurement.NsPerOp, measurement.AllocationsPerOp, measurement.BytesPerOp);
+			file << line;
+		}
+		return file.good();
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "--soak") == 0)
+		{
+			return RunSoak(argc, argv);
+		}
+	}
+
+	const char* filter = "";
+	const char* baselinePath = nullptr;
+	const char* writeBaselinePath = nullptr;
+	double seconds = 0.5;
+	double tolerance = DEFAULT_TOLERANCE_PERCENT;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (std::strcmp(argv[i], "--filter") == 0)
+		{
+			filter = argv[i + 1];
+		}
+		else if (std::strcmp(argv[i], "--time") == 0)
+		{
+			seconds = std::atof(argv[i + 1]) / 1000;
+		}
+		else if (std::strcmp(argv[i], "--baseline") == 0)
+		{
+			baselinePath = argv[i + 1];
+		}
+		else if (std::strcmp(argv[i], "--tolerance") == 0)
+		{
+			tolerance = std::atof(argv[i + 1]);
+		}
+		else if (std::strcmp(argv[i], "--write-baseline") == 0)
+		{
+			writeBaselinePath = argv[i + 1];
+		}
+		else
+		{
+			std::fprintf(stderr, "Unknown option %s.\n", argv[i]);
+			return 2;
+		}
+	}
+
+	Baseline baseline;
+	if (baselinePath && !ReadBaseline(baselinePath, baseline))
+	{
+		std::fprintf(stderr, "Could not read the baseline %s.\n", baselinePath);
+		return 2;
+	}
+
+	std::printf("%-28s %-8s %12s %12s %12s  %s\n", "Benchmark", "Op", "ns/op", "allocs/op", "bytes/op", baselinePath ? "vs baseline" : "");
+
+	Baseline results;
+	bool regressed = false;
+	for (const Benchmark& benchmark : BENCHMARKS)
+	{
+		if (benchmark.Name.find(filter) == std::string_view::npos)
+		{
+			continue;
+		}
+
+		const BenchmarkRun run = benchmark.Setup();
+		const Measurement measurement = Measure(run, seconds);
+		results[std::string(benchmark.Name)] = measurement;
+
+		std::printf("%-28.*s %-8.*s %12.2f %12.3f %12.1f", (int)benchmark.Name.size(), benchmark.Name.data(), (int)benchmark.Operation.size(), benchmark.Operation.data(),
+			measurement.NsPerOp, measurement.AllocationsPerOp, measurement.BytesPerOp);
+
+		const auto base = baseline.find(benchmark.Name);
+		if (base != baseline.end())
+		{
+			// Allocation counts are exact, so only rounding in the baseline is allowed for.
+			const bool slower = measurement.NsPerOp > base->second.NsPerOp * (1 + tolerance / 100);
+			const bool allocates = measurement.AllocationsPerOp > base->second.AllocationsPerOp + 0.001 || measurement.BytesPerOp > base->second.BytesPerOp + 0.1;
+			std::printf("  %+6.1f%%%s%s", (measurement.NsPerOp / base->second.NsPerOp - 1) * 100, slower ? " SLOWER" : "", allocates ? " ALLOCATES MORE" : "");
+			regressed |= slower || allocates;
+		}
+		else if (baselinePath)
+		{
+			std::printf("  (not in baseline)");
+		}
+		std::printf("\n");
+	}
+
+	if (writeBaselinePath && !WriteBaseline(writeBaselinePath, results))
+	{
+		std::fprintf(stderr, "Could not write the baseline %s.\n", writeBaselinePath);
+		return 2;
+	}
+
+	return regressed ? 1 : 0;
+}
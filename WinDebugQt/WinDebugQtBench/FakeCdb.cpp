@@ -0,0 +1,796 @@
+#include "FakeCdb.h"
+
+#include <charconv>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace
+{
+	// What CDB prints when it attaches, up to the first prompt.
+	constexpr std::string_view BANNER =
+		"\n"
+		"Microsoft (R) Windows Debugger Version 10.0.19041.685 AMD64\n"
+		"Copyright (c) Microsoft Corporation. All rights reserved.\n"
+		"\n"
+		"*** wait with pending attach\n"
+		"Symbol search path is: srv*\n"
+		"Executable search path is: \n"
+		"ModLoad: 00007ff6`6ce70000 00007ff6`6ce95000   C:\\WinDebugQt\\DummyProgram.exe\n"
+		"ModLoad: 00007ffb`1d850000 00007ffb`1da45000   C:\\Windows\\SYSTEM32\\ntdll.dll\n"
+		"ModLoad: 00007ffb`1c6d0000 00007ffb`1c78d000   C:\\Windows\\System32\\KERNEL32.DLL\n"
+		"(1a2c.3b4c): Break instruction exception - code 80000003 (first chance)\n"
+		"ntdll!DbgBreakPoint:\n"
+		"00007ffb`1d8f0860 cc              int     3\n";
+
+	constexpr std::string_view PROMPT = "0:000> ";
+
+	constexpr std::string_view STACK =
+		" # Child-SP          RetAddr               Call Site\n"
+		"00 000000d5`e2cff8f8 00007ff6`6ce71123     DummyProgram!main+0x53\n"
+		"01 000000d5`e2cff900 00007ff6`6ce7185c     DummyProgram!invoke_main+0x39\n"
+		"02 000000d5`e2cff950 00007ffb`1c6e7034     DummyProgram!__scrt_common_main_seh+0x12c\n"
+		"03 000000d5`e2cff9c0 00007ffb`1d8a2651     KERNEL32!BaseThreadInitThunk+0x14\n"
+		"04 000000d5`e2cff9f0 00000000`00000000     ntdll!RtlUserThreadStart+0x21\n";
+
+	constexpr char HEX_DIGITS[] = "0123456789abcdef";
+
+	// The general purpose registers in the order r prints them, six lines of three and then efl.
+	struct GprName
+	{
+		std::string_view Name;
+		uint64_t RegisterContext::* Field;
+	};
+
+	constexpr GprName GPR_NAMES[] =
+	{
+		{ "rax", &RegisterContext::Rax }, { "rbx", &RegisterContext::Rbx }, { "rcx", &RegisterContext::Rcx },
+		{ "rdx", &RegisterContext::Rdx }, { "rsi", &RegisterContext::Rsi }, { "rdi", &RegisterContext::Rdi },
+		{ "rip", &RegisterContext::Rip }, { "rsp", &RegisterContext::Rsp }, { "rbp", &RegisterContext::Rbp },
+		{ "r8", &RegisterContext::R8 }, { "r9", &RegisterContext::R9 }, { "r10", &RegisterContext::R10 },
+		{ "r11", &RegisterContext::R11 }, { "r12", &RegisterContext::R12 }, { "r13", &RegisterContext::R13 },
+		{ "r14", &RegisterContext::R14 }, { "r15", &RegisterContext::R15 }, { "efl", &RegisterContext::ContextFlags },
+	};
+
+	void AppendHex(std::string& out, const uint64_t value, const int digits)
+	{
+		for (int shift = (digits - 1) * 4; shift >= 0; shift -= 4)
+		{
+			out += HEX_DIGITS[(value >> shift) & 0xf];
+		}
+	}
+
+	std::string_view Trim(std::string_view text)
+	{
+		while (!text.empty() && text.front() == ' ')
+		{
+			text.remove_prefix(1);
+		}
+		while (!text.empty() && (text.back() == ' ' || text.back() == '\r'))
+		{
+			text.remove_suffix(1);
+		}
+		return text;
+	}
+
+	// Finds the semicolon that ends the command starting at start, skipping any in quotes, as in sx -c "...".
+	size_t FindCommandEnd(const std::string_view line, const size_t start)
+	{
+		bool quoted = false;
+		for (size_t i = start; i < line.size(); ++i)
+		{
+			if (line[i] == '"')
+			{
+				quoted = !quoted;
+			}
+			else if (line[i] == ';' && !quoted)
+			{
+				return i;
+			}
+		}
+		return std::string_view::npos;
+	}
+
+	// Splits off the first word of text, up to a space.
+	std::string_view NextWord(std::string_view& text)
+	{
+		text = Trim(text);
+		const size_t end = text.find(' ');
+		const std::string_view word = text.substr(0, end);
+		text.remove_prefix(end == std::string_view::npos ? text.size() : end);
+		return word;
+	}
+}
+
+FakeCdb::FakeCdb(std::function<Event()> nextEvent)
+	: m_NextEvent(std::move(nextEvent))
+{
+	m_Registers.Rip = 0x00007ffb1d8f0860;
+	m_Registers.Rsp = STACK_ADDRESS;
+	m_Registers.ContextFlags = 0x246;
+
+	m_Output = BANNER;
+	m_Output += PROMPT;
+
+	for (uint64_t i = 0; i < TELEMETRY_RECORD_COUNT; ++i)
+	{
+		const uint64_t sample[TELEMETRY_PAYLOAD_SIZE / 8] = { i, i * 2, i * 3 };
+		m_Telemetry.Append(TELEMETRY_RECORD_TYPE, sample, sizeof(sample));
+	}
+}
+
+std::string_view FakeCdb::Read(const size_t limit)
+{
+	const size_t maxSize = limit < READ_SIZE ? limit : READ_SIZE;
+	const size_t size = m_Output.size() - m_OutputRead < maxSize ? m_Output.size() - m_OutputRead : maxSize;
+	char* const destination = m_Buffer.PrepareWrite(size);
+	std::memcpy(destination, m_Output.data() + m_OutputRead, size);
+	m_Buffer.CommitWrite(size);
+
+	m_OutputRead += size;
+	if (m_OutputRead == m_Output.size())
+	{
+		m_Output.clear();
+		m_OutputRead = 0;
+		m_RunOffset = 0;
+	}
+
+	return std::string_view(destination, size);
+}
+
+bool FakeCdb::Write(const std::string_view text)
+{
+	if (m_Exited)
+	{
+		return false;
+	}
+
+	// CDB runs each line of input as a series of commands separated by semicolons. A command that fails or resumes the debuggee ends its line.
+	size_t lineStart = 0;
+	while (lineStart < text.size() && !m_Exited)
+	{
+		const size_t lineEnd = text.find('\n', lineStart);
+		const std::string_view line = text.substr(lineStart, lineEnd == std::string_view::npos ? std::string_view::npos : lineEnd - lineStart);
+		lineStart = lineEnd == std::string_view::npos ? text.size() : lineEnd + 1;
+
+		CommandResult result = CommandResult::Done;
+		size_t commandStart = 0;
+		while (commandStart <= line.size() && result == CommandResult::Done)
+		{
+			const size_t commandEnd = FindCommandEnd(line, commandStart);
+			const std::string_view command = Trim(line.substr(commandStart, commandEnd == std::string_view::npos ? std::string_view::npos : commandEnd - commandStart));
+			commandStart = commandEnd == std::string_view::npos ? line.size() + 1 : commandEnd + 1;
+
+			if (!command.empty())
+			{
+				result = RunCommand(command);
+			}
+		}
+
+		// A line that left the debuggee stopped ends in a prompt. Resuming prints the prompt of the next break instead.
+		if (result != CommandResult::Resumed && !m_Exited)
+		{
+			m_Output += PROMPT;
+		}
+	}
+
+	return true;
+}
+
+bool FakeCdb::NextFrame(std::string_view& outFrame, OutputTokenizer& tokenizer, int& frameType)
+{
+	// Release the frame handed out by the last call.
+	m_Buffer.Consume(m_FrameLength);
+	m_FrameLength = 0;
+
+	const std::string_view unconsumed = m_Buffer.Unconsumed();
+	size_t frameLength;
+	if (tokenizer.Scan(unconsumed, frameLength, frameType))
+	{
+		outFrame = unconsumed.substr(0, frameLength);
+		m_FrameLength = frameLength;
+		return true;
+	}
+
+	return false;
+}
+
+FakeCdb::CommandResult FakeCdb::RunCommand(const std::string_view command)
+{
+	++m_CommandCount;
+
+	std::string_view arguments = command;
+	const std::string_view name = NextWord(arguments);
+	arguments = Trim(arguments);
+
+	if (name == "g" || name == "gh" || name == "gn")
+	{
+		Resume();
+		return CommandResult::Resumed;
+	}
+
+	if (name == "r")
+	{
+		if (arguments.empty())
+		{
+			PrintRegisters();
+			return CommandResult::Done;
+		}
+
+		const size_t equals = arguments.find('=');
+		const std::string_view registerName = Trim(arguments.substr(0, equals == std::string_view::npos ? arguments.find(':') : equals));
+		if (registerName.size() > 3 && registerName.substr(0, 3) == "xmm")
+		{
+			size_t index = 0;
+			for (const char c : registerName.substr(3))
+			{
+				index = index * 10 + (size_t)(c - '0');
+			}
+			if (index >= std::size(m_Registers.Xmms))
+			{
+				m_Output += "Bad register error in 'r'\n";
+				return CommandResult::Failed;
+			}
+
+			RegisterContext::Xmm& xmm = m_Registers.Xmms[index];
+			if (equals != std::string_view::npos)
+			{
+				// Assigned low to high, as decimal 64-bit integers.
+				std::string_view values = Trim(arguments.substr(equals + 1));
+				const std::from_chars_result low = std::from_chars(values.data(), values.data() + values.size(), xmm.Low);
+				values = Trim(values.substr(low.ptr - values.data()));
+				std::from_chars(values.data(), values.data() + values.size(), xmm.High);
+			}
+			else
+			{
+				// Printed high to low, as unsigned quadwords.
+				m_Output += registerName;
+				m_Output += '=';
+				AppendHex(m_Output, xmm.High, 16);
+				m_Output += ' ';
+				AppendHex(m_Output, xmm.Low, 16);
+				m_Output += '\n';
+			}
+			return CommandResult::Done;
+		}
+
+		uint64_t* const value = FindRegister(registerName);
+		if (!value)
+		{
+			m_Output += "Bad register error in 'r'\n";
+			return CommandResult::Failed;
+		}
+
+		if (equals != std::string_view::npos)
+		{
+			std::string_view expression = arguments.substr(equals + 1);
+			*value = Evaluate(expression);
+		}
+		else
+		{
+			m_Output += registerName;
+			m_Output += '=';
+			AppendHex(m_Output, *value, 16);
+			m_Output += '\n';
+		}
+		return CommandResult::Done;
+	}
+
+	if (name == "db" || name == "dq")
+	{
+		uint64_t address = Evaluate(arguments);
+		arguments = Trim(arguments);
+		uint64_t count = name == "db" ? 0x80 : 0x20;
+		if (!arguments.empty() && (arguments[0] == 'L' || arguments[0] == 'l'))
+		{
+			// L? only lifts CDB's cap on how much is dumped, which there is none of here.
+			arguments.remove_prefix(arguments.substr(1, 1) == "?" ? 2 : 1);
+			count = Evaluate(arguments);
+		}
+
+		// db prints 16 bytes to a line, with a dash between the halves and the characters after them. dq prints two qwords to a line.
+		const uint64_t perLine = name == "db" ? 16 : 2;
+		for (uint64_t lineStart = 0; lineStart < count; lineStart += perLine)
+		{
+			AppendSplitHex(address);
+			m_Output += ' ';
+			if (name == "db")
+			{
+				std::string_view characters;
+				char text[16];
+				for (uint64_t i = 0; i < perLine; ++i)
+				{
+					if (lineStart + i < count)
+					{
+						const uint8_t byte = ReadByte(address + i);
+						m_Output += i == 8 ? '-' : ' ';
+						AppendHex(m_Output, byte, 2);
+						text[i] = byte >= 0x20 && byte < 0x7f ? (char)byte : '.';
+						characters = std::string_view(text, i + 1);
+					}
+					else
+					{
+						m_Output += "   ";
+					}
+				}
+				m_Output += "  ";
+				m_Output += characters;
+			}
+			else
+			{
+				for (uint64_t i = 0; i < perLine && lineStart + i < count; ++i)
+				{
+					m_Output += ' ';
+					AppendSplitHex(ReadQword(address + i * 8));
+				}
+			}
+			m_Output += '\n';
+			address += name == "db" ? perLine : perLine * 8;
+		}
+		return CommandResult::Done;
+	}
+
+	if (name == "eq")
+	{
+		// Kept so the batch trampoline can find its calls, and the return values it writes can be read back.
+		uint64_t address = Evaluate(arguments);
+		for (arguments = Trim(arguments); !arguments.empty(); arguments = Trim(arguments))
+		{
+			m_WrittenQwords[address] = Evaluate(arguments);
+			address += 8;
+		}
+		return CommandResult::Done;
+	}
+
+	if (name == "eb")
+	{
+		// Code written by the session is not kept, as the only code it writes is the batch trampoline, which Resume runs itself.
+		return CommandResult::Done;
+	}
+
+	if (name == ".dvalloc")
+	{
+		const uint64_t size = Evaluate(arguments);
+		char sizeText[16];
+		m_Output += "Allocated ";
+		m_Output.append(sizeText, std::to_chars(sizeText, sizeText + sizeof(sizeText), (size + 0xfff) & ~0xfffull, 16).ptr);
+		m_Output += " bytes starting at ";
+		AppendSplitHex(ALLOC_ADDRESS);
+		m_Output += '\n';
+		return CommandResult::Done;
+	}
+
+	if (name == ".writemem")
+	{
+		// .writemem "file" address L?size dumps memory to a file, which is how the session scans the debuggee's modules.
+		std::string_view path;
+		if (!arguments.empty() && arguments[0] == '"')
+		{
+			const size_t end = arguments.find('"', 1);
+			path = arguments.substr(1, end == std::string_view::npos ? std::string_view::npos : end - 1);
+			arguments.remove_prefix(end == std::string_view::npos ? arguments.size() : end + 1);
+		}
+		else
+		{
+			path = NextWord(arguments);
+		}
+
+		const uint64_t address = Evaluate(arguments);
+		arguments = Trim(arguments);
+		uint64_t count = 0;
+		if (arguments.substr(0, 2) == "L?")
+		{
+			arguments.remove_prefix(2);
+			count = Evaluate(arguments);
+		}
+
+		std::ofstream file{ std::string(path), std::ios::binary };
+		if (!file)
+		{
+			m_Output += "Unable to create file\n";
+			return CommandResult::Failed;
+		}
+
+		std::string image(count, '\0');
+		for (uint64_t i = 0; i < count; ++i)
+		{
+			image[i] = (char)ReadByte(address + i);
+		}
+		file.write(image.data(), (std::streamsize)image.size());
+
+		char size[16];
+		m_Output += "Writing ";
+		m_Output.append(size, std::to_chars(size, size + sizeof(size), count, 16).ptr);
+		m_Output += " bytes\n";
+		return CommandResult::Done;
+	}
+
+	if (name.substr(0, 2) == "sx")
+	{
+		// The only exceptions the simulated debuggee raises are the access violations of callbacks returning to rip 0, so only the av filter is acted on.
+		// Any filter that does not break on them, or that carries on from them without checking rip, loses the callback's return.
+		std::string_view filterCommand;
+		if (arguments.substr(0, 2) == "-c")
+		{
+			arguments.remove_prefix(2);
+			arguments = Trim(arguments);
+			const size_t end = arguments.find('"', 1);
+			filterCommand = arguments.substr(1, end == std::string_view::npos ? std::string_view::npos : end - 1);
+			arguments.remove_prefix(end == std::string_view::npos ? arguments.size() : end + 1);
+		}
+
+		const std::string_view event = NextWord(arguments);
+		if (event == "av" || event == "c0000005")
+		{
+			m_BreaksOnCallbackReturn = name == "sxe" && (filterCommand.empty() || filterCommand.substr(0, RIP_GUARD.size()) == RIP_GUARD);
+		}
+		return CommandResult::Done;
+	}
+
+	if (name == "kn")
+	{
+		m_Output += STACK;
+		return CommandResult::Done;
+	}
+
+	if (name == ".echo")
+	{
+		m_Output += arguments;
+		m_Output += '\n';
+		return CommandResult::Done;
+	}
+
+	m_Output += "       ^ Syntax error in '";
+	m_Output += command;
+	m_Output += "'\n";
+	return CommandResult::Failed;
+}
+
+void FakeCdb::Resume()
+{
+	// A callback the session sent the debuggee into runs and returns to the 0 it was given as a return address, which faults.
+	// The batch trampoline fires each call in turn, writing its return value to where rcx points, and then returns the same way.
+	if (m_Registers.Rip == PRINT_AAA_ADDRESS || m_Registers.Rip == RETURN_DOUBLE_ADDRESS || m_Registers.Rip == ALLOC_ADDRESS)
+	{
+		if (m_Registers.Rip == ALLOC_ADDRESS)
+		{
+			for (uint64_t i = 0; i < m_Registers.R8; ++i)
+			{
+				const uint64_t call = m_Registers.Rdx + i * 32;
+				m_Registers.Rax = CallCallback(ReadQword(call), ReadQword(call + 8));
+				m_WrittenQwords[m_Registers.Rcx + i * 8] = m_Registers.Rax;
+			}
+		}
+		else
+		{
+			m_Registers.Rax = CallCallback(m_Registers.Rip, m_Registers.Rcx);
+		}
+		m_Registers.Rsp += 8;
+		m_Registers.Rip = 0;
+		if (!m_BreaksOnCallbackReturn)
+		{
+			// The debuggee's own exception handling runs on the callback's stack, which it does not survive.
+			m_Exited = true;
+			m_Output += "Access violation - code c0000005 (!!! second chance !!!)\n";
+			return;
+		}
+		PrintBreak("Access violation - code c0000005 (first chance)\n"
+			"First chance exceptions are reported before any exception handling.\n"
+			"This exception may be expected and handled.");
+		return;
+	}
+
+	// The call trampoline makes each call in the block at rsp, fills in their return values, and breaks.
+	if (m_Registers.Rip == CALL_TRAMPOLINE_ADDRESS)
+	{
+		const uint64_t block = m_Registers.Rsp;
+		const uint64_t count = ReadQword(block + offsetof(CallBlockHeader, Count));
+		for (uint64_t i = 0; i < count; ++i)
+		{
+			const uint64_t call = block + sizeof(CallBlockHeader) + count * sizeof(uint64_t) + i * sizeof(CallBlockCall);
+			m_Registers.Rax = CallCallback(ReadQword(call), ReadQword(call + offsetof(CallBlockCall, Args)));
+			m_WrittenQwords[block + sizeof(CallBlockHeader) + i * sizeof(uint64_t)] = m_Registers.Rax;
+		}
+		m_Registers.Rsp = block - CALL_TRAMPOLINE_FRAME_SIZE;
+		m_Registers.Rip = CALL_TRAMPOLINE_BREAK_ADDRESS;
+		PrintBreak("Break instruction exception - code 80000003 (first chance)");
+		return;
+	}
+
+	// Resumed from its break, it returns to where the debuggee was sent in from, which is just past its break if the session made another call from there.
+	while (m_Registers.Rip == CALL_TRAMPOLINE_BREAK_ADDRESS || m_Registers.Rip == CALL_TRAMPOLINE_BREAK_ADDRESS + 1)
+	{
+		const uint64_t block = m_Registers.Rsp + CALL_TRAMPOLINE_FRAME_SIZE;
+		m_Registers.Rip = ReadQword(block + offsetof(CallBlockHeader, ReturnRip));
+		m_Registers.Rsp = ReadQword(block + offsetof(CallBlockHeader, ReturnRsp));
+	}
+
+	m_RunOffset = m_Output.size();
+	const Event event = m_NextEvent();
+	m_Registers.Rsp = STACK_ADDRESS;
+	switch (event)
+	{
+		case Event::Nop:
+		{
+			m_Registers.Rip = DBG_CMD_ADDRESS + debuggerCmdNop * 16;
+			break;
+		}
+		case Event::SetCallbacks:
+		{
+			m_Registers.Rip = DBG_CMD_ADDRESS + debuggerCmdSetCallbacks * 16;
+			m_Registers.Rcx = CALLBACKS_ADDRESS;
+			m_Registers.Rdx = CALLBACK_REGISTRY[0] >> 32;
+			break;
+		}
+		case Event::RegisterAltStack:
+		{
+			m_Registers.Rip = DBG_CMD_ADDRESS + debuggerCmdRegisterAltStack * 16;
+			m_Registers.Rcx = ALT_STACK_ADDRESS;
+			break;
+		}
+		case Event::RegisterCallTrampoline:
+		{
+			m_Registers.Rip = DBG_CMD_ADDRESS + debuggerCmdRegisterCallTrampoline * 16;
+			m_Registers.Rcx = CALL_TRAMPOLINE_ADDRESS;
+			break;
+		}
+		case Event::FlushTelemetry:
+		{
+			m_Registers.Rip = DBG_CMD_ADDRESS + debuggerCmdFlushTelemetry * 16;
+			m_Registers.Rcx = TELEMETRY_ADDRESS;
+			m_Registers.Rdx = m_Telemetry.GetSize();
+			break;
+		}
+		case Event::Breakpoint:
+		{
+			m_Registers.Rip = BREAKPOINT_ADDRESS;
+			break;
+		}
+		case Event::Exit:
+		{
+			m_Exited = true;
+			m_Output += "       ^ No runnable debuggees error in 'gh'\n";
+			return;
+		}
+	}
+
+	PrintBreak("Break instruction exception - code 80000003 (first chance)");
+}
+
+uint64_t FakeCdb::CallCallback(const uint64_t address, const uint64_t firstArg)
+{
+	// PrintAAA returns nothing, which leaves whatever it last put in rax.
+	return address == RETURN_DOUBLE_ADDRESS ? firstArg * 2 : address == PRINT_AAA_ADDRESS ? 3 : 0;
+}
+
+void FakeCdb::PrintBreak(const std::string_view exception)
+{
+	++m_BreakCount;
+
+	m_Output += "(1a2c.3b4c): ";
+	m_Output += exception;
+	m_Output += '\n';
+	PrintCurrentInstruction();
+	m_Output += PROMPT;
+}
+
+void FakeCdb::PrintRegisters()
+{
+	// Three to a line, with names right aligned, so r8 and r9 have a space before them.
+	for (size_t i = 0; i + 1 < std::size(GPR_NAMES); ++i)
+	{
+		if (i % 3)
+		{
+			m_Output += ' ';
+		}
+		if (GPR_NAMES[i].Name.size() < 3)
+		{
+			m_Output += ' ';
+		}
+		m_Output += GPR_NAMES[i].Name;
+		m_Output += '=';
+		AppendHex(m_Output, m_Registers.*GPR_NAMES[i].Field, 16);
+		if (i % 3 == 2 || i + 2 == std::size(GPR_NAMES))
+		{
+			m_Output += '\n';
+		}
+	}
+
+	m_Output += "iopl=0         nv up ei pl zr na po nc\n"
+		"cs=0033  ss=002b  ds=002b  es=002b  fs=0053  gs=002b             efl=";
+	AppendHex(m_Output, m_Registers.ContextFlags, 8);
+	m_Output += '\n';
+	PrintCurrentInstruction();
+}
+
+void FakeCdb::PrintCurrentInstruction()
+{
+#define DBG_CMD_SYMBOL(name, opCode, parameters) "DummyProgram!s_debuggerCmd" #name "Stub:\n",
+	static constexpr std::string_view DBG_CMD_SYMBOLS[] = { DBG_CMD_LIST(DBG_CMD_SYMBOL) };
+#undef DBG_CMD_SYMBOL
+
+	const uint64_t rip = m_Registers.Rip;
+	if (rip == 0)
+	{
+		m_Output += "00000000`00000000 ??              ???\n";
+		return;
+	}
+
+	if (rip >= DBG_CMD_ADDRESS && rip < DBG_CMD_ADDRESS + std::size(DBG_CMD_SYMBOLS) * 16)
+	{
+		m_Output += DBG_CMD_SYMBOLS[(rip - DBG_CMD_ADDRESS) / 16];
+	}
+	else if (rip == BREAKPOINT_ADDRESS)
+	{
+		m_Output += "DummyProgram!main+0x40:\n";
+	}
+	else if (rip == CALL_TRAMPOLINE_BREAK_ADDRESS)
+	{
+		m_Output += "DummyProgram!debuggerCallTrampoline+0x72:\n";
+	}
+	else
+	{
+		m_Output += "ntdll!DbgBreakPoint:\n";
+	}
+
+	AppendSplitHex(rip);
+	m_Output += " cc              int     3\n";
+}
+
+uint64_t FakeCdb::Evaluate(std::string_view& text)
+{
+	uint64_t value = EvaluateTerm(text);
+	for (;;)
+	{
+		text = Trim(text);
+		if (text.substr(0, 2) == "==")
+		{
+			text.remove_prefix(2);
+			value = value == EvaluateTerm(text);
+			continue;
+		}
+		if (text.substr(0, 1) == "<")
+		{
+			text.remove_prefix(1);
+			value = value < EvaluateTerm(text);
+			continue;
+		}
+		if (text.empty() || (text[0] != '&' && text[0] != '+' && text[0] != '-' && text[0] != '*'))
+		{
+			return value;
+		}
+
+		const char op = text[0];
+		text.remove_prefix(1);
+		const uint64_t operand = EvaluateTerm(text);
+		value = op == '&' ? value & operand : op == '+' ? value + operand : op == '-' ? value - operand : value * operand;
+	}
+}
+
+uint64_t FakeCdb::EvaluateTerm(std::string_view& text)
+{
+	text = Trim(text);
+	if (text.empty())
+	{
+		return 0;
+	}
+
+	const bool byteAt = text.substr(0, 3) == "by(";
+	if (byteAt)
+	{
+		text.remove_prefix(2);
+	}
+
+	if (text[0] == '(')
+	{
+		text.remove_prefix(1);
+		const uint64_t value = Evaluate(text);
+		if (!text.empty() && text[0] == ')')
+		{
+			text.remove_prefix(1);
+		}
+		return byteAt ? ReadByte(value) : value;
+	}
+
+	if (text[0] == '@')
+	{
+		size_t end = 1;
+		while (end < text.size() && ((text[end] >= 'a' && text[end] <= 'z') || (text[end] >= '0' && text[end] <= '9') || text[end] == '$'))
+		{
+			++end;
+		}
+		const std::string_view name = text.substr(1, end - 1);
+		text.remove_prefix(end);
+		if (const uint64_t* const value = FindRegister(name))
+		{
+			return *value;
+		}
+
+		// The low halves of the general purpose registers, like edx, are read from the whole register.
+		const char wideName[] = { 'r', name.size() == 3 ? name[1] : '\0', name.size() == 3 ? name[2] : '\0' };
+		const uint64_t* const wide = name.size() == 3 && name[0] == 'e' ? FindRegister(std::string_view(wideName, sizeof(wideName))) : nullptr;
+		return wide ? (uint32_t)*wide : 0;
+	}
+
+	if (text.substr(0, 2) == "0x")
+	{
+		text.remove_prefix(2);
+	}
+
+	uint64_t value = 0;
+	text.remove_prefix(RegisterContextParser::ParseHex(text, value));
+	return value;
+}
+
+uint64_t* FakeCdb::FindRegister(const std::string_view name)
+{
+	if (name.substr(0, 2) == "$t")
+	{
+		size_t index = 0;
+		const std::from_chars_result result = std::from_chars(name.data() + 2, name.data() + name.size(), index);
+		return result.ec == std::errc() && result.ptr == name.data() + name.size() && index < std::size(m_PseudoRegisters) ? &m_PseudoRegisters[index] : nullptr;
+	}
+
+	for (const GprName& gpr : GPR_NAMES)
+	{
+		if (gpr.Name == name)
+		{
+			return &(m_Registers.*gpr.Field);
+		}
+	}
+	return nullptr;
+}
+
+uint8_t FakeCdb::ReadByte(const uint64_t address) const
+{
+	if (const auto written = m_WrittenQwords.find(address & ~7ull); written != m_WrittenQwords.end())
+	{
+		return (uint8_t)(written->second >> (address % 8 * 8));
+	}
+
+	// Each debug command is the stub DummyProgram generates for it, padded out to 16 bytes with int 3s.
+	if (address >= DBG_CMD_ADDRESS && address < DBG_CMD_ADDRESS + DBG_CMD_COUNT * 16)
+	{
+		const DbgCmdStub stub = MakeDbgCmdStub((uint8_t)((address - DBG_CMD_ADDRESS) / 16));
+		const uint64_t offset = (address - DBG_CMD_ADDRESS) % 16;
+		return offset < stub.size() ? stub[offset] : 0xcc;
+	}
+
+	if (address >= BREAKPOINT_ADDRESS && address < BREAKPOINT_ADDRESS + 16)
+	{
+		return address == BREAKPOINT_ADDRESS ? 0xcc : 0x90;
+	}
+
+	if (address >= CALL_TRAMPOLINE_ADDRESS && address <= CALL_TRAMPOLINE_BREAK_ADDRESS)
+	{
+		return address == CALL_TRAMPOLINE_BREAK_ADDRESS ? 0xcc : 0x90;
+	}
+
+	if (address >= TELEMETRY_ADDRESS && address < TELEMETRY_ADDRESS + m_Telemetry.GetSize())
+	{
+		return m_Telemetry.GetData()[address - TELEMETRY_ADDRESS];
+	}
+
+	return 0;
+}
+
+uint64_t FakeCdb::ReadQword(const uint64_t address) const
+{
+	if (const auto written = m_WrittenQwords.find(address); written != m_WrittenQwords.end())
+	{
+		return written->second;
+	}
+	if (address >= CALLBACKS_ADDRESS && address < CALLBACKS_ADDRESS + sizeof(CALLBACK_REGISTRY) && (address - CALLBACKS_ADDRESS) % 8 == 0)
+	{
+		return CALLBACK_REGISTRY[(address - CALLBACKS_ADDRESS) / 8];
+	}
+	return 0;
+}
+
+void FakeCdb::AppendSplitHex(const uint64_t value)
+{
+	AppendHex(m_Output, value >> 32, 8);
+	m_Output += '`';
+	AppendHex(m_Output, value & 0xffffffff, 8);
+}
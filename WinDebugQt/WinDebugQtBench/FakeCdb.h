@@ -0,0 +1,169 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "DbgCmds.h"
+#include "ICdbTransport.h"
+#include "RegisterContext.h"
+#include "StreamBuffer.h"
+
+/*
+* A scripted stand-in for CDB attached to DummyProgram, which a CdbSession can be run against without Windows, CDB, or a debuggee.
+* It answers the commands the session sends (r, db, dq, eb, eq, kn, sx*, .echo, .dvalloc, .writemem, and the g family) with output laid out the way CDB lays it out,
+* from a simulated register file and memory. Each time the debuggee is resumed, the script decides what it breaks on next.
+* Memory written with eb is not kept, so whatever is sent to run at ALLOC_ADDRESS is taken to be the session's batch trampoline.
+* Output is handed over in reads of at most READ_SIZE bytes, just like CDB's output pipe.
+*/
+class FakeCdb
+	final : public ICdbTransport
+{
+public:
+	// What the debuggee does when it is resumed.
+	enum class Event
+	{
+		Nop, // Fires debuggerCmdNop.
+		SetCallbacks, // Fires debuggerCmdSetCallbacks, which makes the session fire both callbacks.
+		RegisterAltStack, // Fires debuggerCmdRegisterAltStack.
+		RegisterCallTrampoline, // Fires debuggerCmdRegisterCallTrampoline, after which the session fires callbacks through the call trampoline.
+		FlushTelemetry, // Fires debuggerCmdFlushTelemetry with a full buffer of TELEMETRY_RECORD_COUNT records.
+		Breakpoint, // Breaks on an int 3 that is not a debug command.
+		Exit, // Exits, which ends the session.
+	};
+
+	// The most output handed over by one Read.
+	static constexpr size_t READ_SIZE = 4096;
+
+	// Where the simulated debuggee's code and data are.
+	static constexpr uint64_t DBG_CMD_ADDRESS = 0x00007ff66ce72580; // Debug command n starts 16 * n bytes on from here.
+	static constexpr uint64_t BREAKPOINT_ADDRESS = 0x00007ff66ce71100;
+	static constexpr uint64_t CALLBACKS_ADDRESS = 0x00007ff66ce7d170;
+	static constexpr uint64_t PRINT_AAA_ADDRESS = 0x00007ff66ce72200;
+	static constexpr uint64_t RETURN_DOUBLE_ADDRESS = 0x00007ff66ce72260;
+	static constexpr uint64_t ALT_STACK_ADDRESS = 0x00007ff66ce80000;
+	static constexpr uint64_t CALL_TRAMPOLINE_ADDRESS = 0x00007ff66ce72600;
+	static constexpr uint64_t CALL_TRAMPOLINE_BREAK_ADDRESS = CALL_TRAMPOLINE_ADDRESS + 0x72; // Its int 3, just like in DebuggerCmds.asm.
+	static constexpr uint64_t STACK_ADDRESS = 0x000000d5e2cff8f8;
+	static constexpr uint64_t ALLOC_ADDRESS = 0x000001f23a5b0000; // Where .dvalloc allocates.
+	static constexpr uint64_t TELEMETRY_ADDRESS = 0x00007ff66ce90000;
+
+	// The size of the debuggee's telemetry buffer, which every flush fills, and the records it is filled with, each a TELEMETRY_PAYLOAD_SIZE byte sample.
+	static constexpr size_t TELEMETRY_BUFFER_SIZE = 64 * 1024;
+	static constexpr uint32_t TELEMETRY_RECORD_TYPE = 1;
+	static constexpr size_t TELEMETRY_PAYLOAD_SIZE = 24;
+	static constexpr size_t TELEMETRY_RECORD_COUNT = (TELEMETRY_BUFFER_SIZE - sizeof(TelemetryFlushHeader)) / GetTelemetryRecordSize(TELEMETRY_PAYLOAD_SIZE);
+
+	// The callback registry at CALLBACKS_ADDRESS, as qwords, laid out like DummyProgram's.
+	static constexpr uint64_t CALLBACK_REGISTRY[] =
+	{
+		CALLBACK_REGISTRY_VERSION | 2ull << 32,
+		DbgCallbacks::PrintAAA.NameHash, DbgCallbacks::PrintAAA.Signature, PRINT_AAA_ADDRESS,
+		DbgCallbacks::ReturnDoubleTheInput.NameHash, DbgCallbacks::ReturnDoubleTheInput.Signature, RETURN_DOUBLE_ADDRESS,
+	};
+
+	// nextEvent is asked what to do every time the debuggee is resumed. CDB's banner and first prompt are ready to be read straight away.
+	explicit FakeCdb(std::function<Event()> nextEvent);
+
+	// Whether there is output waiting to be read.
+	bool HasOutput() const { return m_OutputRead < m_Output.size(); }
+
+	// Hands over the next read's worth of output, up to limit bytes, to be framed by NextFrame. Returns it, valid until the next call.
+	std::string_view Read(const size_t limit = READ_SIZE);
+
+	// How much of the output waiting to be read was printed before the debuggee was last let run to its next event.
+	// The rest is what it broke on, which a caller pacing the debuggee can hold back until it is due.
+	size_t GetOutputBeforeRun() const { return m_RunOffset > m_OutputRead ? m_RunOffset - m_OutputRead : 0; }
+
+	// Answers every command in text. Returns false once the debuggee has exited.
+	virtual bool Write(const std::string_view text) override;
+
+	virtual bool NextFrame(std::string_view& outFrame, OutputTokenizer& tokenizer, int& frameType) override;
+
+	// The number of events the debuggee has broken on, counting callbacks returning.
+	uint64_t GetBreakCount() const { return m_BreakCount; }
+
+	// The number of commands answered, counting resumes.
+	uint64_t GetCommandCount() const { return m_CommandCount; }
+
+	bool HasExited() const { return m_Exited; }
+
+private:
+	enum class CommandResult
+	{
+		Done,
+		Failed, // CDB drops the rest of the line.
+		Resumed, // The debuggee ran, and the break it stopped at has been printed along with its prompt.
+	};
+
+	CommandResult RunCommand(const std::string_view command);
+
+	// Lets the debuggee run until it breaks on the next event, or until a callback it was sent into returns.
+	void Resume();
+
+	// What a callback the debuggee is sent into returns.
+	static uint64_t CallCallback(const uint64_t address, const uint64_t firstArg);
+
+	// Prints the break CDB reports when the debuggee stops at the current rip, followed by a prompt.
+	void PrintBreak(const std::string_view exception);
+
+	// Prints what the r command prints.
+	void PrintRegisters();
+
+	// Prints the disassembly line of the instruction at the current rip, along with the symbol it is in.
+	void PrintCurrentInstruction();
+
+	// Evaluates the CDB expressions the session uses: hex numbers, @registers, parentheses, by(), and the &, +, -, *, == and < operators, left to right.
+	// There is no precedence, so the session has to order its expressions to give the same answer either way.
+	// Consumes the expression from the start of text, leaving whatever follows it.
+	uint64_t Evaluate(std::string_view& text);
+
+	// Evaluates a number, register, by() or bracketed expression from the start of text. Registers may be named by their low 32 bits, like edx.
+	uint64_t EvaluateTerm(std::string_view& text);
+
+	// A general purpose or $t pseudo-register by name, or null if there is no such register.
+	uint64_t* FindRegister(const std::string_view name);
+
+	uint8_t ReadByte(const uint64_t address) const;
+	uint64_t ReadQword(const uint64_t address) const;
+
+	// Appends an address or qword the way CDB prints them, with a ` between the halves.
+	void AppendSplitHex(const uint64_t value);
+
+	std::function<Event()> m_NextEvent;
+
+	RegisterContext m_Registers;
+
+	// $t0 to $t19, which the session's event filters count in.
+	uint64_t m_PseudoRegisters[20] = {};
+
+	// What an sx -c command has to start with to leave a fault at rip 0 to the session.
+	static constexpr std::string_view RIP_GUARD = ".if (@rip != 0)";
+
+	// Whether the av event filter breaks when a callback returns to rip 0, as it does unless the session sets a filter that does not.
+	bool m_BreaksOnCallbackReturn = true;
+
+	// The telemetry at TELEMETRY_ADDRESS, which is the same every flush.
+	TelemetryBuffer<TELEMETRY_BUFFER_SIZE> m_Telemetry;
+
+	// Qwords written with eq, by address. The session only ever writes to a few places on the stacks, so this stays small.
+	std::unordered_map<uint64_t, uint64_t> m_WrittenQwords;
+
+	bool m_Exited = false;
+
+	// Output not yet read. m_Output is only compacted once it has all been read, so it stops allocating once it is large enough.
+	std::string m_Output;
+	size_t m_OutputRead = 0;
+
+	// Where in m_Output the debuggee was last let run to its next event.
+	size_t m_RunOffset = 0;
+
+	// Output that has been read, waiting to be framed.
+	StreamBuffer m_Buffer;
+	size_t m_FrameLength = 0; // Length of the frame last handed out by NextFrame, which is released on the next call.
+
+	uint64_t m_BreakCount = 0;
+	uint64_t m_CommandCount = 0;
+};
@@ -0,0 +1,787 @@
+#include "Soak.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <condition_variable>
+#include <format>
+#include <mutex>
+#include <windows.h>
+#include <psapi.h>
+
+#include "DebugSession.h"
+#else
+#include <cerrno>
+#include <csignal>
+#include <memory>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "PosixProcess.h"
+#endif
+
+#include "CdbSession.h"
+#include "DbgCmds.h"
+#include "FakeCdb.h"
+#include "LatencyHistogram.h"
+#include "LogRing.h"
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	constexpr size_t OPCODE_COUNT = 3;
+	constexpr const char* OPCODE_NAMES[OPCODE_COUNT] = { "nop", "callbacks", "altstack" };
+
+	// Falling this far short of the target rate means the session cannot keep up with it.
+	constexpr double SATURATED_FRACTION = 0.95;
+
+	struct SoakOptions
+	{
+		bool Real = false;
+		bool Piped = false;
+		bool ServeFakeCdb = false; // Plays FakeCdb over stdin and stdout for a soak with --piped, rather than soaking.
+		size_t Sessions = 1;
+		double Rate = 1000; // 0 fires commands back to back.
+		std::string Mix = "nop=1,callbacks=1,altstack=1";
+		std::array<double, OPCODE_COUNT> Weights = { 1, 1, 1 };
+		double Seconds = 60;
+		double ReportSeconds = 5;
+		std::filesystem::path ProfilePath;
+		std::vector<EventPolicy> EventPolicies;
+		uint64_t Exceptions = 0; // Thrown by DummyProgram before the soak starts.
+	};
+
+	// Parses a mix the way DummyProgram does, so the same one can be handed to it.
+	bool ParseMix(std::string_view text, std::array<double, OPCODE_COUNT>& weights)
+	{
+		while (!text.empty())
+		{
+			const size_t end = std::min(text.find(','), text.size());
+			const std::string_view entry = text.substr(0, end);
+			text.remove_prefix(std::min(end + 1, text.size()));
+
+			const size_t equals = entry.find('=');
+			const size_t opCode = equals == std::string_view::npos ? OPCODE_COUNT
+				: std::find(std::begin(OPCODE_NAMES), std::end(OPCODE_NAMES), entry.substr(0, equals)) - std::begin(OPCODE_NAMES);
+			if (opCode == OPCODE_COUNT)
+			{
+				return false;
+			}
+
+			weights[opCode] = std::atof(std::string(entry.substr(equals + 1)).c_str());
+			if (weights[opCode] < 0)
+			{
+				return false;
+			}
+		}
+		return weights[0] + weights[1] + weights[2] > 0;
+	}
+
+	struct ProcessUsage
+	{
+		double CpuSeconds = 0; // User and kernel time.
+		uint64_t ResidentBytes = 0;
+	};
+
+	// What this process has used so far. The debugger and debuggee are not counted.
+	ProcessUsage GetProcessUsage()
+	{
+		ProcessUsage usage;
+#ifdef _WIN32
+		FILETIME creation, exit, kernel, user;
+		if (GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+		{
+			const auto toSeconds = [](const FILETIME& time) { return (((uint64_t)time.dwHighDateTime << 32) | time.dwLowDateTime) / 1e7; };
+			usage.CpuSeconds = toSeconds(kernel) + toSeconds(user);
+		}
+
+		PROCESS_MEMORY_COUNTERS memory;
+		if (GetProcessMemoryInfo(GetCurrentProcess(), &memory, sizeof(memory)))
+		{
+			usage.ResidentBytes = memory.WorkingSetSize;
+		}
+#else
+		rusage resources;
+		if (getrusage(RUSAGE_SELF, &resources) == 0)
+		{
+			const auto toSeconds = [](const timeval& time) { return time.tv_sec + time.tv_usec / 1e6; };
+			usage.CpuSeconds = toSeconds(resources.ru_utime) + toSeconds(resources.ru_stime);
+		}
+
+		// The second field is the resident set, in pages.
+		std::ifstream statm("/proc/self/statm");
+		uint64_t size, resident;
+		if (statm >> size >> resident)
+		{
+			usage.ResidentBytes = resident * sysconf(_SC_PAGESIZE);
+		}
+#endif
+		return usage;
+	}
+
+	double ToMicroseconds(const uint64_t nanoseconds)
+	{
+		return nanoseconds / 1e3;
+	}
+
+	/*
+	* Collects the latency of every debug command handled, and reports on them every ReportSeconds and at the end.
+	* Only used on the thread that drains the session.
+	*/
+	class SoakReporter
+		final
+	{
+	public:
+		explicit SoakReporter(const SoakOptions& options)
+			: m_Options(options)
+			, m_Start(Clock::now())
+			, m_LastReport(m_Start)
+			, m_StartUsage(GetProcessUsage())
+			, m_LastUsage(m_StartUsage)
+		{
+		}
+
+		void Record(const uint8_t opCode, const std::chrono::nanoseconds latency)
+		{
+			if (opCode < OPCODE_COUNT)
+			{
+				m_Interval[opCode].Record(latency.count());
+			}
+		}
+
+		// Reports on the commands handled since the last report, if it is time to.
+		void Poll()
+		{
+			const Clock::time_point now = Clock::now();
+			if (now - m_LastReport < std::chrono::duration<double>(m_Options.ReportSeconds))
+			{
+				return;
+			}
+
+			const double elapsed = std::chrono::duration<double>(now - m_LastReport).count();
+			const ProcessUsage usage = GetProcessUsage();
+			m_PeakResidentBytes = std::max(m_PeakResidentBytes, usage.ResidentBytes);
+
+			uint64_t commands = 0;
+			for (const LatencyHistogram& histogram : m_Interval)
+			{
+				commands += histogram.GetCount();
+			}
+
+			std::printf("%7.1f s %10.1f cmd/s  cpu %5.1f%%  rss %7.1f MB", std::chrono::duration<double>(now - m_Start).count(), commands / elapsed,
+				(usage.CpuSeconds - m_LastUsage.CpuSeconds) / elapsed * 100, usage.ResidentBytes / 1048576.0);
+			for (size_t i = 0; i < OPCODE_COUNT; ++i)
+			{
+				if (m_Interval[i].GetCount())
+				{
+					std::printf("  | %s p50 %.1f p99 %.1f p99.9 %.1f us", OPCODE_NAMES[i],
+						ToMicroseconds(m_Interval[i].GetPercentile(50)), ToMicroseconds(m_Interval[i].GetPercentile(99)), ToMicroseconds(m_Interval[i].GetPercentile(99.9)));
+				}
+				m_Total[i].Merge(m_Interval[i]);
+				m_Interval[i].Reset();
+			}
+			std::printf("\n");
+			std::fflush(stdout);
+
+			m_LastReport = now;
+			m_LastUsage = usage;
+		}
+
+		// Sums up the whole soak. Returns false if no commands were handled.
+		bool PrintSummary()
+		{
+			const Clock::time_point now = Clock::now();
+			const double elapsed = std::chrono::duration<double>(now - m_Start).count();
+			const ProcessUsage usage = GetProcessUsage();
+			m_PeakResidentBytes = std::max(m_PeakResidentBytes, usage.ResidentBytes);
+
+			uint64_t commands = 0;
+			for (size_t i = 0; i < OPCODE_COUNT; ++i)
+			{
+				m_Total[i].Merge(m_Interval[i]);
+				m_Interval[i].Reset();
+				commands += m_Total[i].GetCount();
+			}
+
+			// Each session is paced on its own, so together they target the rate that many times over.
+			const double rate = commands / elapsed;
+			const double targetRate = m_Options.Rate * m_Options.Sessions;
+			std::printf("\n%llu debug commands in %.1f s: %.1f cmd/s sustained", (unsigned long long)commands, elapsed, rate);
+			if (targetRate > 0)
+			{
+				std::printf(" against %.1f cmd/s targeted%s", targetRate, rate < targetRate * SATURATED_FRACTION ? " (SATURATED)" : "");
+			}
+			std::printf("\ncpu %.1f%% on average, rss %.1f MB at peak\n\n", (usage.CpuSeconds - m_StartUsage.CpuSeconds) / elapsed * 100, m_PeakResidentBytes / 1048576.0);
+
+			std::printf("%-10s %10s %10s %10s %10s %10s %10s\n", "Opcode", "Count", "Mean us", "p50 us", "p99 us", "p99.9 us", "Max us");
+			for (size_t i = 0; i < OPCODE_COUNT; ++i)
+			{
+				const LatencyHistogram& histogram = m_Total[i];
+				std::printf("%-10s %10llu %10.1f %10.1f %10.1f %10.1f %10.1f\n", OPCODE_NAMES[i], (unsigned long long)histogram.GetCount(), histogram.GetMean() / 1e3,
+					ToMicroseconds(histogram.GetPercentile(50)), ToMicroseconds(histogram.GetPercentile(99)), ToMicroseconds(histogram.GetPercentile(99.9)), ToMicroseconds(histogram.GetMax()));
+			}
+			return commands > 0;
+		}
+
+	private:
+		const SoakOptions& m_Options;
+
+		Clock::time_point m_Start;
+		Clock::time_point m_LastReport;
+
+		ProcessUsage m_StartUsage;
+		ProcessUsage m_LastUsage;
+		uint64_t m_PeakResidentBytes = 0;
+
+		// Latencies since the last report, and before it.
+		std::array<LatencyHistogram, OPCODE_COUNT> m_Interval;
+		std::array<LatencyHistogram, OPCODE_COUNT> m_Total;
+	};
+
+	// Exports what session measured to the file given with --profile, if one was.
+	bool ExportProfile(const SoakOptions& options, CdbSession& session)
+	{
+		if (options.ProfilePath.empty())
+		{
+			return true;
+		}
+
+		std::ofstream file(options.ProfilePath, std::ios::binary);
+		const SessionProfile& profile = session.GetProfile();
+		file << (options.ProfilePath.extension() == ".csv" ? profile.ToCsv() : profile.ToJson());
+		if (!file.good())
+		{
+			std::fprintf(stderr, "Could not write the profile to %s.\n", options.ProfilePath.string().c_str());
+			return false;
+		}
+		return true;
+	}
+
+	// Prints what the session's event filters have counted, if they count anything.
+	void PrintEventCounts(const CdbSession& session)
+	{
+		const std::string counts = session.GetEventFilters().FormatCounts();
+		if (!counts.empty())
+		{
+			std::printf("Events counted by CDB: %s\n", counts.c_str());
+		}
+	}
+
+	// Drops everything logged, the way the presenter would once it had shown it.
+	void DrainLog(CdbSession& session)
+	{
+		LogRing& log = session.GetLog();
+		while (const LogRing::Chunk* const chunk = log.Acquire())
+		{
+			log.Release(chunk);
+		}
+	}
+
+	// Plays DummyProgram's load mode for FakeCdb: it sets up like DummyProgram does, then fires the mix at the target rate until the soak is over.
+	class SoakScript
+		final
+	{
+	public:
+		explicit SoakScript(const SoakOptions& options)
+			: m_Pick(options.Weights.begin(), options.Weights.end())
+			, m_Next(Clock::now())
+			, m_End(m_Next + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.Seconds)))
+			, m_Interval(options.Rate > 0 ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1 / options.Rate)) : Clock::duration::zero())
+		{
+		}
+
+		// What the debuggee does next, for FakeCdb to ask for each time it is resumed.
+		FakeCdb::Event Next()
+		{
+			if (m_Setup < std::size(SETUP))
+			{
+				return SETUP[m_Setup++];
+			}
+
+			// Unpaced, the next command is fired straight away.
+			m_Next = m_Interval != Clock::duration::zero() ? m_Next + m_Interval : Clock::now();
+			return m_Next < m_End ? EVENTS[m_Pick(m_Random)] : FakeCdb::Event::Exit;
+		}
+
+		/*
+		* When the debuggee fires the command it has last been resumed into. The break is held back until then, rather than sleeping
+		* in the resume, so the time waiting is not counted as the latency of the command that resumed it. Anything CDB printed
+		* before the resume is handed over straight away, as it would be by CDB.
+		*/
+		Clock::time_point GetDue() const { return m_Next; }
+
+	private:
+		static constexpr FakeCdb::Event SETUP[] = { FakeCdb::Event::RegisterAltStack, FakeCdb::Event::RegisterCallTrampoline, FakeCdb::Event::SetCallbacks, FakeCdb::Event::Nop };
+		static constexpr FakeCdb::Event EVENTS[OPCODE_COUNT] = { FakeCdb::Event::Nop, FakeCdb::Event::SetCallbacks, FakeCdb::Event::RegisterAltStack };
+
+		std::mt19937 m_Random{ 0 };
+		std::discrete_distribution<int> m_Pick;
+		size_t m_Setup = 0;
+
+		Clock::time_point m_Next;
+		Clock::time_point m_End;
+		Clock::duration m_Interval;
+	};
+
+	// Soaks a session against FakeCdb, which plays DummyProgram's load mode.
+	bool SoakFake(const SoakOptions& options, SoakReporter& reporter)
+	{
+		SoakScript script(options);
+		FakeCdb cdb([&]() { return script.Next(); });
+
+		CdbSession session(cdb, LogRing::DEFAULT_MEMORY_CAP, LogRing::OverflowPolicy::DropOldest);
+		session.SetDbgCmdObserver([&](const uint8_t opCode, const std::chrono::nanoseconds latency) { reporter.Record(opCode, latency); });
+		session.SetProfiling(!options.ProfilePath.empty());
+		session.SetEventPolicies(options.EventPolicies);
+		session.Begin();
+
+		while (cdb.HasOutput())
+		{
+			size_t readLimit = cdb.GetOutputBeforeRun();
+			if (readLimit == 0)
+			{
+				std::this_thread::sleep_until(script.GetDue());
+				readLimit = FakeCdb::READ_SIZE;
+			}
+
+			if (session.QueueFrames(cdb.Read(readLimit)))
+			{
+				session.DrainFrames();
+			}
+			DrainLog(session);
+			reporter.Poll();
+		}
+		PrintEventCounts(session);
+		return ExportProfile(options, session) && cdb.HasExited();
+	}
+
+#ifdef __linux__
+	bool WriteAll(const int fd, std::string_view text)
+	{
+		while (!text.empty())
+		{
+			const ssize_t written = write(fd, text.data(), text.size());
+			if (written < 0 && errno != EINTR)
+			{
+				return false;
+			}
+			text.remove_prefix(written < 0 ? 0 : written);
+		}
+		return true;
+	}
+
+	// Plays FakeCdb over stdin and stdout for a soak with --piped, paced the same way as SoakFake. Returns the exit code.
+	int ServeFakeCdb(const SoakOptions& options)
+	{
+		SoakScript script(options);
+		FakeCdb cdb([&]() { return script.Next(); });
+
+		OutputTokenizer tokenizer;
+		std::string input;
+		char buffer[FakeCdb::READ_SIZE];
+		while (true)
+		{
+			while (cdb.HasOutput())
+			{
+				size_t readLimit = cdb.GetOutputBeforeRun();
+				if (readLimit == 0)
+				{
+					std::this_thread::sleep_until(script.GetDue());
+					readLimit = FakeCdb::READ_SIZE;
+				}
+				if (!WriteAll(STDOUT_FILENO, cdb.Read(readLimit)))
+				{
+					return 1;
+				}
+
+				// FakeCdb keeps what it has handed over until it is framed, and the session frames it on its own end of the pipe, so just drop it.
+				std::string_view frame;
+				int frameType;
+				while (cdb.NextFrame(frame, tokenizer, frameType))
+				{
+				}
+			}
+			if (cdb.HasExited())
+			{
+				return 0;
+			}
+
+			// The session has gone if its end of the pipe is closed.
+			const ssize_t bytesRead = read(STDIN_FILENO, buffer, sizeof(buffer));
+			if (bytesRead <= 0)
+			{
+				if (bytesRead < 0 && errno == EINTR)
+				{
+					continue;
+				}
+				return bytesRead == 0 ? 0 : 1;
+			}
+
+			// FakeCdb answers whole lines, so a partial one is held on to until the rest of it arrives.
+			input.append(buffer, bytesRead);
+			const size_t linesEnd = input.rfind('\n');
+			if (linesEnd != std::string::npos)
+			{
+				cdb.Write(std::string_view(input).substr(0, linesEnd + 1));
+				input.erase(0, linesEnd + 1);
+			}
+		}
+	}
+
+	/*
+	* Soaks sessions against FakeCdb stand-ins running as child processes of this one, talking to them through pipes the way DebugHandler talks to CDB.
+	* A single thread services every session, waiting on all of their pipes at once with a ProcessPoller.
+	*/
+	bool SoakPiped(const SoakOptions& options, SoakReporter& reporter)
+	{
+		struct PipedSession
+		{
+			PosixProcess Cdb;
+			std::unique_ptr<CdbSession> Session;
+		};
+
+		// Writing to a stand-in that has exited would otherwise kill the soak, rather than fail the write.
+		std::signal(SIGPIPE, SIG_IGN);
+
+		const std::string rate = std::to_string(options.Rate);
+		const std::string seconds = std::to_string(options.Seconds);
+		const char* const standInArgv[] = { "/proc/self/exe", "--soak", "--fake-cdb", "--rate", rate.c_str(), "--mix", options.Mix.c_str(), "--seconds", seconds.c_str(), nullptr };
+
+		ProcessPoller poller;
+		std::vector<std::unique_ptr<PipedSession>> sessions;
+		for (size_t i = 0; i < options.Sessions; ++i)
+		{
+			std::unique_ptr<PipedSession>& piped = sessions.emplace_back(std::make_unique<PipedSession>());
+			if (!piped->Cdb.Start(standInArgv))
+			{
+				std::fprintf(stderr, "Could not start a FakeCdb stand-in.\n");
+				return false;
+			}
+
+			piped->Session = std::make_unique<CdbSession>(piped->Cdb, LogRing::DEFAULT_MEMORY_CAP, LogRing::OverflowPolicy::DropOldest);
+			piped->Session->SetDbgCmdObserver([&](const uint8_t opCode, const std::chrono::nanoseconds latency) { reporter.Record(opCode, latency); });
+			piped->Session->SetProfiling(!options.ProfilePath.empty());
+			piped->Session->SetEventPolicies(options.EventPolicies);
+			piped->Session->Begin();
+			poller.Add(piped->Cdb, piped.get());
+		}
+
+		const Clock::time_point start = Clock::now();
+		uint64_t bytesRead = 0;
+		uint64_t reads = 0;
+		uint64_t wakeups = 0;
+
+		// Each ready session is read from once per wakeup, so a busy one cannot starve the rest.
+		const int reportMs = (int)std::min(options.ReportSeconds * 1000, 100.0);
+		size_t open = sessions.size();
+		bool completed = true;
+		void* ready[16];
+		while (open)
+		{
+			const int readyCount = poller.Wait(ready, (int)std::size(ready), reportMs);
+			if (readyCount < 0)
+			{
+				return false;
+			}
+			wakeups += readyCount > 0;
+
+			for (int i = 0; i < readyCount; ++i)
+			{
+				PipedSession& piped = *(PipedSession*)ready[i];
+				std::string_view received;
+				const PosixProcess::ReadStatus status = piped.Cdb.Read(received);
+				if (status == PosixProcess::ReadStatus::Read)
+				{
+					bytesRead += received.size();
+					++reads;
+					if (piped.Session->QueueFrames(received))
+					{
+						piped.Session->DrainFrames();
+					}
+					DrainLog(*piped.Session);
+				}
+				else if (status != PosixProcess::ReadStatus::WouldBlock)
+				{
+					// The stand-in exits once the soak is over, having handed over everything it printed.
+					poller.Remove(piped.Cdb);
+					completed &= status == PosixProcess::ReadStatus::Closed && piped.Cdb.Wait() == 0;
+					--open;
+				}
+			}
+			reporter.Poll();
+		}
+
+		const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+		std::printf("%.1f MB read from %zu stand-ins in %.1f s: %.1f MB/s, %.1f KB per read, %.2f reads per wakeup\n", bytesRead / 1048576.0, sessions.size(), elapsed,
+			bytesRead / 1048576.0 / elapsed, reads ? bytesRead / 1024.0 / reads : 0.0, wakeups ? (double)reads / wakeups : 0.0);
+
+		// Every session soaks the same way, so the first stands for them all.
+		PrintEventCounts(*sessions.front()->Session);
+		return ExportProfile(options, *sessions.front()->Session) && completed;
+	}
+#endif
+
+#ifdef _WIN32
+	// Soaks a real session, with DummyProgram's load mode under CDB, reading CDB's output on a worker thread the way DebugHandler does.
+	bool SoakReal(const SoakOptions& options, SoakReporter& reporter)
+	{
+		const HANDLE completionPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+		if (!completionPort)
+		{
+			std::fprintf(stderr, "Could not create a completion port.\n");
+			return false;
+		}
+
+		DebugSession session(LogRing::DEFAULT_MEMORY_CAP, LogRing::OverflowPolicy::DropOldest);
+		session.SetDbgCmdObserver([&](const uint8_t opCode, const std::chrono::nanoseconds latency) { reporter.Record(opCode, latency); });
+		session.SetProfiling(!options.ProfilePath.empty());
+		session.SetEventPolicies(options.EventPolicies);
+
+		std::mutex readyLock;
+		std::condition_variable readyCondition;
+		bool ready = false;
+		std::thread worker([&]()
+		{
+			while (true)
+			{
+				DWORD bytesRead;
+				ULONG_PTR key;
+				OVERLAPPED* overlapped;
+				const BOOL ok = GetQueuedCompletionStatus(completionPort, &bytesRead, &key, &overlapped, INFINITE);
+				if (!overlapped)
+				{
+					return;
+				}
+
+				if (!ok)
+				{
+					session.OnReadFailed();
+					continue;
+				}
+
+				if (session.OnReadComplete(bytesRead))
+				{
+					{
+						std::scoped_lock lock(readyLock);
+						ready = true;
+					}
+					readyCondition.notify_one();
+				}
+				session.ReadCdbOutput();
+			}
+		});
+
+		// The debuggee stops firing commands and exits after the soak, which ends the session.
+		const bool started = session.Start(completionPort, std::format("DummyProgram.exe --load {} --mix {} --seconds {} --exceptions {}",
+			options.Rate, options.Mix, options.Seconds, options.Exceptions));
+		if (started)
+		{
+			const std::chrono::duration<double> wait(std::min(options.ReportSeconds, 0.1));
+			while (session.IsRunning())
+			{
+				{
+					std::unique_lock lock(readyLock);
+					readyCondition.wait_for(lock, wait, [&]() { return ready; });
+					ready = false;
+				}
+
+				session.DrainFrames();
+				DrainLog(session);
+				reporter.Poll();
+			}
+		}
+		else
+		{
+			std::fprintf(stderr, "Could not start DummyProgram.exe under CDB.\n");
+		}
+
+		PrintEventCounts(session);
+		session.Stop();
+		PostQueuedCompletionStatus(completionPort, 0, 0, nullptr);
+		worker.join();
+		CloseHandle(completionPort);
+		return ExportProfile(options, session) && started;
+	}
+#endif
+}
+
+int RunSoak(int argc, char* argv[])
+{
+	SoakOptions options;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "--soak") == 0)
+		{
+			continue;
+		}
+		else if (std::strcmp(argv[i], "--real") == 0)
+		{
+			options.Real = true;
+			continue;
+		}
+		else if (std::strcmp(argv[i], "--piped") == 0)
+		{
+			options.Piped = true;
+			continue;
+		}
+		else if (std::strcmp(argv[i], "--fake-cdb") == 0)
+		{
+			options.ServeFakeCdb = true;
+			continue;
+		}
+		else if (i + 1 == argc)
+		{
+			std::fprintf(stderr, "%s needs a value.\n", argv[i]);
+			return 2;
+		}
+
+		const char* const value = argv[++i];
+		if (std::strcmp(argv[i - 1], "--rate") == 0)
+		{
+			options.Rate = std::atof(value);
+		}
+		else if (std::strcmp(argv[i - 1], "--mix") == 0)
+		{
+			options.Mix = value;
+			if (!ParseMix(options.Mix, options.Weights))
+			{
+				std::fprintf(stderr, "Bad mix %s.\n", value);
+				return 2;
+			}
+		}
+		else if (std::strcmp(argv[i - 1], "--seconds") == 0)
+		{
+			options.Seconds = std::atof(value);
+		}
+		else if (std::strcmp(argv[i - 1], "--report") == 0)
+		{
+			options.ReportSeconds = std::atof(value);
+		}
+		else if (std::strcmp(argv[i - 1], "--profile") == 0)
+		{
+			options.ProfilePath = value;
+		}
+		else if (std::strcmp(argv[i - 1], "--event") == 0)
+		{
+			EventPolicy policy;
+			if (!EventPolicy::Parse(value, policy))
+			{
+				std::fprintf(stderr, "Bad event policy %s.\n", value);
+				return 2;
+			}
+			options.EventPolicies.push_back(std::move(policy));
+		}
+		else if (std::strcmp(argv[i - 1], "--exceptions") == 0)
+		{
+			options.Exceptions = std::strtoull(value, nullptr, 10);
+		}
+		else if (std::strcmp(argv[i - 1], "--sessions") == 0)
+		{
+			options.Sessions = std::strtoull(value, nullptr, 10);
+		}
+		else
+		{
+			std::fprintf(stderr, "Unknown option %s.\n", argv[i - 1]);
+			return 2;
+		}
+	}
+
+	if (options.Seconds <= 0 || options.ReportSeconds <= 0)
+	{
+		std::fprintf(stderr, "--seconds and --report must be positive.\n");
+		return 2;
+	}
+
+	if (EventFilters filters; !filters.SetPolicies(options.EventPolicies))
+	{
+		std::fprintf(stderr, "At most %zu events can be counted.\n", EventFilters::MAX_COUNTERS);
+		return 2;
+	}
+
+	if (options.Exceptions && !options.Real)
+	{
+		std::fprintf(stderr, "--exceptions needs DummyProgram, so only works with --real.\n");
+		return 2;
+	}
+
+	if (options.Real && options.Piped)
+	{
+		std::fprintf(stderr, "--real and --piped cannot be used together.\n");
+		return 2;
+	}
+
+	if (options.Sessions == 0 || (options.Sessions > 1 && !options.Piped))
+	{
+		std::fprintf(stderr, "--sessions must be positive, and more than one only works with --piped.\n");
+		return 2;
+	}
+
+#ifdef __linux__
+	if (options.ServeFakeCdb)
+	{
+		return ServeFakeCdb(options);
+	}
+#else
+	if (options.ServeFakeCdb || options.Piped)
+	{
+		std::fprintf(stderr, "--fake-cdb and --piped need POSIX pipes and epoll, which are only on Linux.\n");
+		return 2;
+	}
+#endif
+
+	if (options.Piped)
+	{
+		std::printf("Soaking %zu FakeCdb stand-ins through pipes for %.0f s, mix %s, ", options.Sessions, options.Seconds, options.Mix.c_str());
+	}
+	else
+	{
+		std::printf("Soaking %s for %.0f s, mix %s, ", options.Real ? "DummyProgram under CDB" : "FakeCdb", options.Seconds, options.Mix.c_str());
+	}
+	if (options.Rate > 0)
+	{
+		std::printf("at %.1f cmd/s%s\n\n", options.Rate, options.Piped ? " each" : "");
+	}
+	else
+	{
+		std::printf("as fast as it goes\n\n");
+	}
+
+	SoakReporter reporter(options);
+	bool completed = false;
+	if (options.Real)
+	{
+#ifdef _WIN32
+		completed = SoakReal(options, reporter);
+#else
+		std::fprintf(stderr, "--real needs CDB, which is only on Windows.\n");
+		return 2;
+#endif
+	}
+	else if (options.Piped)
+	{
+#ifdef __linux__
+		completed = SoakPiped(options, reporter);
+#endif
+	}
+	else
+	{
+		completed = SoakFake(options, reporter);
+	}
+
+	const bool handled = reporter.PrintSummary();
+	return completed && handled ? 0 : 1;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+/*
+* Runs debug commands through a session for a long time, to find the rate it can sustain and how its latency holds up.
+* Either DummyProgram under CDB (--real, Windows only) or FakeCdb standing in for both fires a mix of debug commands at a target rate.
+* Commands per second, latency percentiles per opcode, CPU and RSS are reported as the soak goes, and summed up at the end.
+* With --profile, the session also measures each phase of handling the commands, and exports its SessionProfile to the file at the end.
+* Each --event has CDB deal with an event by policy (see EventPolicy), and with --exceptions DummyProgram throws that many C++ exceptions first,
+* to measure how an exception storm fares under those policies.
+* With --piped (Linux only), each of --sessions FakeCdbs runs as a child process, which this one talks to through pipes with PosixProcess,
+* servicing all of them from one thread with a ProcessPoller. Pipe throughput is reported at the end, and the children can be watched with perf or strace.
+* --fake-cdb is how those children are started: rather than soaking, it plays FakeCdb over stdin and stdout, paced by --rate, --mix and --seconds.
+*
+* WinDebugQtBench --soak [--real | --piped [--sessions <count>]] [--rate <commands per second>] [--mix nop=<weight>,callbacks=<weight>,altstack=<weight>]
+*                        [--seconds <seconds>] [--report <seconds>] [--profile <file.json or file.csv>]
+*                        [--event <event>=<log|count|sample:N|stop>]... [--exceptions <count>]
+* WinDebugQtBench --soak --fake-cdb [--rate <commands per second>] [--mix ...] [--seconds <seconds>]
+*/
+int RunSoak(int argc, char* argv[]);